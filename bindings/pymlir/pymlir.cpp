@@ -149,14 +149,134 @@ public:
     return getPythonArray(tensor.get(), shape);
   }
   void invoke() { interpreter_->invoke(); }
+  void enable_profile(bool enable = true) {
+    interpreter_->enable_profile(enable);
+  }
+
+  // per op statistics, sorted by total time
+  py::list get_profile() {
+    py::list profile;
+    for (auto &prof : interpreter_->get_profile()) {
+      py::dict d;
+      d["name"] = prof.name;
+      d["type"] = prof.type;
+      d["count"] = prof.count;
+      d["time_us"] = prof.time_us;
+      d["flops"] = prof.flops;
+      d["read_bytes"] = prof.read_bytes;
+      d["write_bytes"] = prof.write_bytes;
+      profile.append(d);
+    }
+    return profile;
+  }
+
+  void print_profile() {
+    interpreter_->print_profile(llvm::outs());
+    llvm::outs().flush();
+  }
+
+  void dump_profile(std::string filename) {
+    interpreter_->dump_profile_trace(filename);
+  }
+
   void fake_quant_weight() { interpreter_->fake_quant_weight(); }
 
+  void clear_references() { interpreter_->clear_references(); }
+
+  void collect_statistics(ActivationStatistics &stats) {
+    interpreter_->collect_statistics(stats);
+  }
+
+  // cache activations of the last invoke of ref as fp32 reference for tuning
+  void add_reference(py_module &ref) {
+    interpreter_->add_reference(*ref.interpreter_);
+  }
+
+  py::dict eval_fake_quant(std::map<std::string, double> fake_quant,
+                           std::string target) {
+    TuneDistance dist;
+    {
+      py::gil_scoped_release release;
+      dist = interpreter_->eval_fake_quant(fake_quant, target);
+    }
+    py::dict ret;
+    ret["distance"] = dist.distance;
+    ret["cosine"] = dist.cosine;
+    ret["sqnr"] = dist.sqnr;
+    return ret;
+  }
+
   py::array invoke_at(const std::string name) {
     auto tensor = interpreter_->invoke_at(name);
     std::vector<int64_t> shape = interpreter_->getTensorShape(name);
     return getPythonArray(tensor.get(), shape);
   }
 
+  // inputs: iterable of {input_name: array}, iterated in a worker thread so
+  // that preprocessing overlaps inference; callback(idx) is called after
+  // each sample is invoked, returning False stops the run
+  void run_dataset(py::iterable inputs, py::function callback,
+                   int prefetch = 2) {
+    auto iter = py::iter(inputs);
+    std::unique_ptr<py::error_already_set> error;
+    auto producer = [&](InputSample &sample) {
+      py::gil_scoped_acquire acquire;
+      if (error) {
+        return false;
+      }
+      try {
+        auto item =
+            py::reinterpret_steal<py::object>(PyIter_Next(iter.ptr()));
+        if (!item) {
+          if (PyErr_Occurred()) {
+            throw py::error_already_set();
+          }
+          return false;
+        }
+        if (!py::isinstance<py::dict>(item)) {
+          PyErr_SetString(PyExc_TypeError, "run_dataset: inputs is not dict");
+          throw py::error_already_set();
+        }
+        sample.clear();
+        for (auto it : py::reinterpret_borrow<py::dict>(item)) {
+          auto data = py::array_t<float, py::array::c_style |
+                                             py::array::forcecast>::ensure(
+              it.second);
+          if (!data) {
+            throw py::error_already_set();
+          }
+          sample[std::string(py::str(it.first))].assign(
+              data.data(), data.data() + data.size());
+        }
+        return true;
+      } catch (py::error_already_set &e) {
+        error = std::make_unique<py::error_already_set>(std::move(e));
+        return false;
+      }
+    };
+    auto consumer = [&](int64_t idx) {
+      py::gil_scoped_acquire acquire;
+      if (error) {
+        return false;
+      }
+      try {
+        auto ret = callback(idx);
+        return ret.is_none() || py::bool_(ret);
+      } catch (py::error_already_set &e) {
+        error = std::make_unique<py::error_already_set>(std::move(e));
+        return false;
+      }
+    };
+    {
+      py::gil_scoped_release release;
+      interpreter_->invoke_dataset(producer, consumer, prefetch);
+    }
+    if (error) {
+      error->restore();
+      throw py::error_already_set();
+    }
+  }
+
 public:
   py::list all_tensor_names;
   py::list input_names;
@@ -176,10 +296,71 @@ private:
 
 std::string py_module::version = MLIR_VERSION;
 
+static std::string serialize_statistics(const ActivationStatistics &stats) {
+  return stats.serialize();
+}
+
+static void deserialize_statistics(ActivationStatistics &stats,
+                                   const std::string &data) {
+  if (!stats.deserialize(data)) {
+    throw py::value_error("not serialized statistics");
+  }
+}
+
 // wrap as Python module
 PYBIND11_MODULE(pymlir, m) {
   m.doc() = "pybind11 for mlir";
 
+  py::class_<ActivationStatistics>(m, "statistics",
+                                   "mergeable activation statistics")
+      .def(py::init<>())
+      .def("init_histogram", &ActivationStatistics::init_histogram,
+           py::arg("name"), py::arg("abs_max"), py::arg("bin_num"))
+      .def("merge", &ActivationStatistics::merge)
+      .def("serialize",
+           [](const ActivationStatistics &s) {
+             return py::bytes(serialize_statistics(s));
+           })
+      .def("deserialize", &deserialize_statistics)
+      .def(
+          "min_max",
+          [](const ActivationStatistics &s) {
+            py::dict ret;
+            for (auto &it : s.tensors) {
+              auto &t = it.second;
+              ret[py::str(it.first)] =
+                  py::make_tuple(t.min, t.max, t.abs_max());
+            }
+            return ret;
+          },
+          "{name: (min, max, abs_max)}")
+      .def(
+          "histograms",
+          [](const ActivationStatistics &s) {
+            py::dict ret;
+            for (auto &it : s.tensors) {
+              auto &t = it.second;
+              if (t.histogram.empty()) {
+                continue;
+              }
+              ret[py::str(it.first)] = py::make_tuple(
+                  py::array_t<int64_t>(t.histogram.size(),
+                                       t.histogram.data()),
+                  t.width);
+            }
+            return ret;
+          },
+          "{name: (histogram, width)}")
+      .def(py::pickle(
+          [](const ActivationStatistics &s) {
+            return py::bytes(serialize_statistics(s));
+          },
+          [](py::bytes data) {
+            ActivationStatistics s;
+            deserialize_statistics(s, data);
+            return s;
+          }));
+
   py::class_<py_module>(m, "module", "MLIR Module")
       .def(py::init<>())
       .def("load", &py_module::load, "load module from IR")
@@ -187,8 +368,26 @@ PYBIND11_MODULE(pymlir, m) {
       .def("get_tensor", &py_module::get_tensor, "get one tensor data")
       .def("get_all_tensor", &py_module::getAllTensor, "dump all tensor data")
       .def("invoke", &py_module::invoke)
+      .def("enable_profile", &py_module::enable_profile,
+           py::arg("enable") = true, "time each op in invoke")
+      .def("get_profile", &py_module::get_profile, "per op time/flops/bytes")
+      .def("print_profile", &py_module::print_profile)
+      .def("dump_profile", &py_module::dump_profile,
+           "save profile as chrome trace json")
       .def("fake_quant_weight", &py_module::fake_quant_weight)
+      .def("add_reference", &py_module::add_reference,
+           "cache activations of last invoke of a fp32 module")
+      .def("clear_references", &py_module::clear_references)
+      .def("eval_fake_quant", &py_module::eval_fake_quant,
+           py::arg("fake_quant"), py::arg("target"),
+           "distance of target to references, with {tensor: threshold} "
+           "fake quantized and only their forward cone to target executed")
+      .def("collect_statistics", &py_module::collect_statistics,
+           "update statistics with the activations of last invoke")
       .def("invoke_at", &py_module::invoke_at, "invote at specified layer")
+      .def("run_dataset", &py_module::run_dataset, py::arg("inputs"),
+           py::arg("callback"), py::arg("prefetch") = 2,
+           "invoke each inputs dict, prefetched in a worker thread")
       .def_readonly("input_names", &py_module::input_names)
       .def_readonly("output_names", &py_module::output_names)
       .def_readonly("all_tensor_names", &py_module::all_tensor_names)
@@ -14,7 +14,10 @@
 #include <cstring>
 #include <assert.h>
 #include <cmath>
+#include <memory>
+#include <string>
 #include "mlir/IR/Builders.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/Support/DynamicLibrary.h"
 
 #define MAX_CONV_IC (4095 - 32)
@@ -1258,6 +1261,42 @@ protected:
   llvm::sys::DynamicLibrary DL;
 };
 
+// -------------------- CviCmdBuf --------------------
+// Finished commands of a routine. It grows by chunks without reallocating
+// or copying what is already stored, and can be spilled to a temporary
+// file, so that memory held by completed routines stays small.
+class CviCmdBuf {
+public:
+  CviCmdBuf() = default;
+  CviCmdBuf(const CviCmdBuf &) = delete;
+  CviCmdBuf &operator=(const CviCmdBuf &) = delete;
+  ~CviCmdBuf();
+
+  void append(const uint8_t *data, size_t size);
+  // move all chunks in memory to the temporary file
+  void spill();
+  size_t size() const { return size_; }
+  // call fn on consecutive pieces of the buffer, in order
+  void for_each(llvm::function_ref<void(const uint8_t *, size_t)> fn) const;
+  void read(std::vector<uint8_t> &out) const;
+
+  static const size_t CHUNK_SIZE = 16 << 20;
+  // completed routines larger than this are spilled
+  static const size_t SPILL_SIZE = 64 << 20;
+
+private:
+  struct Chunk {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size;
+    size_t capacity;
+  };
+  std::vector<Chunk> chunks_; // in memory, after spilled data
+  size_t size_ = 0;
+  size_t spilled_ = 0; // bytes in file
+  int fd_ = -1;
+  std::string path_;
+};
+
 // -------------------- CviBackendContext --------------------
 class CviBackendContext {
 public:
@@ -1266,6 +1305,10 @@ public:
 
   void write_cmdbuf(const void *cmdbuf, uint32_t size);
   void read_cmdbuf(std::vector<uint8_t> &out_cmdbuf);
+  // move the commands out of the context, without copy
+  std::unique_ptr<CviCmdBuf> take_cmdbuf();
+  // max bytes of commands used by cvikernel, for one submit
+  size_t peak_cmdbuf_size() const { return peak_cmdbuf_size_; }
   void dmabuf_convert(std::vector<uint8_t> &dmabuf);
   void submit();
 
@@ -1708,9 +1751,15 @@ private:
   // Allowed to assign unique tdma base selection for each global memory region.
   uint8_t tdmaBaseSelects[MAX_GLOBAL_MEMORY_REGION];
 
-  std::vector<uint8_t> cmdbuf_;
+  std::unique_ptr<CviCmdBuf> cmdbuf_;
 
-  std::vector<uint8_t> cvk_cmd_buf_;
+  // Commands are generated by cvikernel in this buffer. It is reserved
+  // as address space only, pages are committed when cvikernel writes them,
+  // and those beyond CMDBUF_RESIDENT_SIZE are returned after each submit.
+  static const size_t CMDBUF_RESIDENT_SIZE = 1 << 20;
+  uint8_t *cvk_cmd_buf_;
+  size_t cvk_cmd_buf_size_;
+  size_t peak_cmdbuf_size_ = 0;
   cvk_context_t *cvk_ctx_;
 };
 
@@ -1724,6 +1773,8 @@ void cvi_backend_submit(
 void cvi_backend_get_cmdbuf(
     CviBackendContext *ctx, std::vector<uint8_t> &cmdbuf);
 
+std::unique_ptr<CviCmdBuf> cvi_backend_take_cmdbuf(CviBackendContext *ctx);
+
 void cvi_backend_dmabuf_convert(
     CviBackendContext *ctx, std::vector<uint8_t> &dmabuf);
 
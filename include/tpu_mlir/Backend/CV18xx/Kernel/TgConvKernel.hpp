@@ -798,6 +798,7 @@ public:
   void initializeFusedActivation();
   void initializeTile();
   void determineTilePolicy();
+  void determineTilePolicyByPriority();
   void doConvByTilePolicy();
 
   uint32_t getElementTypeSize(cvk_fmt_t fmt);
@@ -1041,12 +1042,30 @@ public:
     uint32_t wgtReadSize;
     uint32_t actReadSize;
     uint32_t actWriteSize;
+    // Estimated cycles
+    uint64_t tdmaCycles;
+    uint64_t tiuCycles;
+    uint64_t totalCycles; // tdma and tiu overlapped in parallel regions
+  };
+  struct TileDecision {
+    TilePolicy policy;
+    TileInfo tile_info;
+    bool use_double_buffer;
+    CostModel cost;
   };
 
+  static std::string getTilePolicyStr(TilePolicy policy);
   void showCost(CostModel &cost);
+  uint64_t getTdmaCycles(std::vector<uint32_t> shapes, uint32_t gmWidth,
+                         cvk_fmt_t fmt);
+  uint64_t getTiuCycles(std::vector<uint32_t> outputShapes, uint32_t macs);
   void getCost(CostModel &cost);
   bool isBetterCost(CostModel &from, CostModel &to);
+  void enqueueCmdsByTilePolicy();
   TilePolicy getReuseWgtOrActByCost();
+  void evaluateTilePolicy(TilePolicy policy, TileDecision &best);
+  void determineTilePolicyByCost(TileDecision &best);
+  std::vector<int64_t> getTileDecisionKey();
 
   // Arguments from dialect
   Conv_ARGS args;
@@ -62,6 +62,10 @@ class ModelGen {
   virtual ~ModelGen();
   flatbuffers::FlatBufferBuilder &Builder();
   Binary WriteBinary(size_t size, uint8_t *data);
+  // like WriteBinary, but data is only referenced and must stay valid until
+  // Save; all referenced data is gathered into the output in parallel there.
+  // WriteBinary can't be called after ReserveBinary.
+  Binary ReserveBinary(size_t size, const uint8_t *data);
 
   // add model elements
   void AddChip(const std::string &arch_name);
@@ -82,6 +86,9 @@ class ModelGen {
   bool IsTensorConflict(const flatbuffers::Vector<flatbuffers::Offset<Tensor>> *,
                         const flatbuffers::Vector<flatbuffers::Offset<Tensor>> *);
   bool IsShapeSame(const Shape *, const Shape *);
+  const uint8_t *BinaryData(uint32_t idx);
+  void GatherBinary(uint8_t *dst);
+  void SaveReserved(const std::string &filename);
 
   typedef struct {
     std::string name;
@@ -92,6 +99,8 @@ class ModelGen {
   flatbuffers::FlatBufferBuilder builder_;
   std::vector<uint8_t> binary_;
   std::vector<Binary> binary_vector_;
+  std::vector<const uint8_t *> binary_src_;  // referenced data, or NULL
+  uint64_t reserved_size_;                   // size of referenced data
   std::vector<NET_INFO_T> net_vector_;
   std::vector<flatbuffers::Offset<bmodel::Net>> nets_;
   uint64_t max_neuron_size_;
@@ -109,6 +118,8 @@ class ModelCtx {
   void read_binary(const bmodel::Binary *binary, uint8_t *buffer);
   // read binary from offset
   void read_binary(const bmodel::Binary *binary, uint32_t offset, uint8_t *buffer, uint32_t size);
+  // binary data in place, without copy
+  const uint8_t *binary_data(const bmodel::Binary *binary) const;
 
   // model buffer data for parse
   const void *data() const;
@@ -129,8 +140,9 @@ class ModelCtx {
   const Model *model_;
   void *model_buffer_;
   uint32_t binary_offset_;
-  std::ifstream file_;          // bmodel in file
-  const void *bmodel_pointer_;  // bmodel in buffer
+  void *mmap_addr_;             // bmodel file mapped by mmap
+  size_t mmap_size_;
+  const void *bmodel_pointer_;  // bmodel in buffer or mapped file
 };
 
 }  // namespace bmodel
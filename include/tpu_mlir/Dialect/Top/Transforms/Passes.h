@@ -20,6 +20,8 @@ namespace top {
 
 std::unique_ptr<OperationPass<ModuleOp>> createImportCalibrationTablePass();
 std::unique_ptr<OperationPass<ModuleOp>> createMarkFLOPsPass();
+std::unique_ptr<OperationPass<ModuleOp>> createFoldConstantPass();
+std::unique_ptr<OperationPass<ModuleOp>> createMergeWeightPass();
 std::unique_ptr<OperationPass<ModuleOp>> createSaveWeightPass();
 #define GEN_PASS_REGISTRATION
 #define GEN_PASS_CLASSES
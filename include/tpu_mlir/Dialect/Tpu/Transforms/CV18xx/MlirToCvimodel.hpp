@@ -22,6 +22,7 @@
 #include <fstream>
 #include "tpu_mlir/Builder/CV18xx/cvimodel_generated.h"
 #include "tpu_mlir/Builder/CV18xx/parameter_generated.h"
+#include "tpu_mlir/Backend/CV18xx/CV18xx.h"
 #include "tpu_mlir/Support/Helper/Module.h"
 #include "tpu_mlir/Dialect/Top/IR/TopOps.h"
 
@@ -72,13 +73,15 @@ public:
                 std::string chip);
   flatbuffers::Offset<Routine> build();
 
-  std::vector<uint8_t> cmdbuf;
+  std::unique_ptr<tpu_mlir::backend::CviCmdBuf> cmdbuf;
 
 private:
   int* layer_id;
   void codeGen();
 };
 
+class CviModelWriter;
+
 class CviModelBuilder {
 public:
   CviModelBuilder(ModuleOp &module);
@@ -99,7 +102,13 @@ private:
   std::vector<CviRoutine *> routines_;
   std::vector<Operation *> ops_;
   flatbuffers::FlatBufferBuilder fbb_;
-  std::vector<uint8_t> binBuffer_;
+  // binary sections after the flatbuffer, streamed to file in storeModel
+  struct BinSection {
+    const tpu_mlir::backend::CviCmdBuf *cmdbuf; // nullptr for weight section
+    uint32_t size;
+  };
+  std::vector<BinSection> binSections_;
+  uint32_t binSize_ = 0;
   int64_t privateGmemSize_ = 0;
   int64_t sharedGmemSize_ = 0;
   int batchNum_ = 0;
@@ -122,7 +131,8 @@ private:
   FBSectionVector buildSections();
   FBSection buildSection(std::string name, cvi::model::SectionType type);
   FBSection buildSection(std::string name, cvi::model::SectionType type,
-                         std::vector<uint8_t>& data);
+                         const tpu_mlir::backend::CviCmdBuf &cmdbuf);
+  void writeBody(CviModelWriter &writer);
   void parseOpInfo(Operation *op, std::string& name, std::vector<int64_t>& shape,
                    size_t& size, int64_t& offset, DType& dtype);
   flatbuffers::Offset<Tensor> buildNeuron(Operation *op);
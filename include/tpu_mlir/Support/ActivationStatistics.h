@@ -0,0 +1,51 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tpu_mlir {
+
+// Statistics of activations for calibration. They are exact under merge:
+// merging the statistics of dataset shards, collected by different
+// interpreters, equals collecting the whole dataset in one interpreter.
+class ActivationStatistics {
+public:
+  struct Tensor {
+    float min = std::numeric_limits<float>::max();
+    float max = std::numeric_limits<float>::lowest();
+    int64_t count = 0; // samples
+    // histogram of nonzero |x|, binned as BaseKldCalibrator.histogram
+    double width = 0;
+    std::vector<int64_t> histogram;
+    float abs_max() const { return std::max(std::abs(min), std::abs(max)); }
+  };
+
+  // histogram with bin_num bins of width abs_max / (bin_num - 1); abs_max
+  // should be merged from all shards first, so that bins are the same
+  void init_histogram(const std::string &name, double abs_max,
+                      int64_t bin_num);
+  void update(const std::string &name, const float *data, int64_t num);
+  void merge(const ActivationStatistics &other);
+  std::string serialize() const;
+  // return false if data is not serialized statistics
+  bool deserialize(llvm::StringRef data);
+
+public:
+  std::map<std::string, Tensor> tensors;
+};
+
+} // namespace tpu_mlir
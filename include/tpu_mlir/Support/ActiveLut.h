@@ -0,0 +1,29 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <stdint.h>
+
+namespace tpu_mlir {
+
+typedef float (*active_f32_f)(float);
+
+// Table of 65536 entries, from f16/bf16 input bits to func output rounded to
+// f16/bf16, in float. It is built once for each func and type, and shared by
+// all ops with the same func.
+const float *get_active_lut(active_f32_f func, bool is_bf16);
+
+// dst = round_to_f16/bf16(func(src)), as computing func then f32_to_f16 or
+// f32_to_bf16, but looked up in table of get_active_lut for src exact in
+// f16/bf16.
+void active_by_lut(const float *src, float *dst, int64_t num,
+                   const float *table, active_f32_f func, bool is_bf16);
+
+} // namespace tpu_mlir
@@ -15,25 +15,28 @@ using namespace dnnl;
 namespace tpu_mlir {
 
 typedef struct {
-  uint64_t axis;
-  memory::dims src_shape;
-  memory::dims dst_shape;
+  int64_t outer_dim;                // product of dims before axis
+  int64_t inner_dim;                // product of dims after axis
+  std::vector<int64_t> axis_dims;   // dim at axis of each input
 } concat_attr_t;
 
-class Concat{
+class Concat {
 public:
   Concat();
-  void setup(std::vector<float*> input, float *output, concat_attr_t &attr);
-  void run();
   ~Concat() = default;
+  // build everything for the given buffers once, run can be called many times
+  void setup(std::vector<float *> input, float *output, concat_attr_t &attr);
+  void run();
+
 private:
   engine eng;
   stream eng_stream;
   primitive concat_prim;
   std::unordered_map<int, memory> concat_args;
-  std::vector<float*> p_input;
+  std::vector<float *> p_input;
   float *p_output{nullptr};
   concat_attr_t attr_;
+  bool use_memcpy{true};
 };
 
-}
+} // namespace tpu_mlir
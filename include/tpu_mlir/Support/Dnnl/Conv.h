@@ -44,9 +44,18 @@ public:
   void filter_init(float *weight, conv_attr_t &attr);
   void setup(float *input, float *weight, float *bias, float *output,
              conv_attr_t attr);
+  // int8 inference with s8/u8 input and s8 weight, the output is s32
+  // accumulators without bias and relu, see int8_output. oneDNN converts s32
+  // to f32 in its epilogue, so it returns false if accumulators may reach
+  // 2^24, then setup should be used instead.
+  bool setup_int8(float *input, float *weight, conv_attr_t attr,
+                  bool input_unsigned);
+  // accumulators of int8 inference in ncdhw, nullptr if not int8
+  const int32_t *int8_output() const;
   void run();
 private:
   void pad_init(float *input, conv_attr_t &attr);
+  void int8_input_refresh();
 private:
   engine eng;
   stream eng_stream;
@@ -61,5 +70,8 @@ private:
   float *origin_input, *origin_weight;
   std::shared_ptr<std::vector<float>> input_after_pad, weight_after_zp;
   conv_attr_t _attr;
+  bool int8_mode;
+  std::vector<int8_t> input_i8, weight_i8;
+  std::vector<int32_t> output_i32;
 };
 } // namespace tpu_mlir
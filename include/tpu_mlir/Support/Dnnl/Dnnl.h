@@ -20,5 +20,9 @@
 namespace tpu_mlir {
 
 dnnl::memory::data_type getDnnlType(mlir::Value v);
+// bias and relu on s32 accumulators of int8 inference, the same as f32
+// primitives with post_relu give, but in integer
+int64_t int8_epilogue(int32_t acc, float bias, bool do_relu,
+                      double relu_limit);
 
 }
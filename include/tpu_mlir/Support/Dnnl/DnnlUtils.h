@@ -14,4 +14,16 @@ using namespace dnnl;
 namespace tpu_mlir {
 
 void post_relu(primitive_attr &attr, bool &do_relu, double &relu_limit);
+// cpu engine shared by all ops, primitives can be reused among them
+const engine &dnnl_cpu_engine();
+// int8 values kept in float, to s8 or u8 bits
+void float_to_int8(int8_t *dst, const float *src, int64_t num);
+// int8 kernels before vnni are not exact: s8 inputs take weights scaled by
+// 0.5, and u8 x s8 pairs are summed in s16 with saturation. Only avx512 vnni
+// and later ones are used for int8.
+bool int8_isa_exact();
+// int8 primitives convert s32 accumulators to f32 in their epilogue, so they
+// are exact only if |acc| < 2^24. max_abs_sum is the max sum of |weight|
+// over the reduced axes of one output.
+bool int8_acc_exact(int64_t max_abs_sum, bool input_unsigned);
 } // namespace tpu_mlir
@@ -19,6 +19,15 @@ public:
   void setup(float *left, float *right, float *bias, float *output,
              int64_t batch, int64_t M, int64_t K, int64_t N, bool do_relu,
              double relu_limit, int64_t right_zp);
+  // int8 inference with s8/u8 left and s8 right, the output is s32
+  // accumulators without bias and relu, see int8_output. A constant right is
+  // converted once here. Returns false if accumulators may reach 2^24, as
+  // Conv::setup_int8.
+  bool setup_int8(float *left, float *right, bool right_is_const,
+                  int64_t batch, int64_t M, int64_t K, int64_t N,
+                  int64_t right_zp, bool left_unsigned);
+  // accumulators of int8 inference, nullptr if not int8
+  const int32_t *int8_output() const;
 
   void run();
 
@@ -30,5 +39,10 @@ private:
   std::shared_ptr<std::vector<float>> bias0;
   float *p_right;
   std::shared_ptr<std::vector<float>> right_after_zp;
+  bool int8_mode = false;
+  bool right_is_const;
+  float *p_left;
+  std::vector<int8_t> left_i8, right_i8;
+  std::vector<int32_t> output_i32;
 };
 } // namespace tpu_mlir
@@ -50,7 +50,8 @@ public:
              int izp = 0);
   void run();
 private:
-  void pad_init(float *input, pool_attr_t &attr, int izp);
+  void pad_init(float *input, pool_attr_t &attr, int izp, bool is_avg);
+  void pad_outputs_init(pool_attr_t &attr);
 public:
   int kd, kh, kw;
 
@@ -63,8 +64,14 @@ private:
   memory::dims src_shape;
   memory::dims dst_shape;
   float *p_input;
+  float *p_output;
   float *origin_input;
+  // avg pooling counts izp padding, only the interior is copied for each run
   std::shared_ptr<std::vector<float>> input_after_pad;
+  // max pooling pads implicitly, offsets in output plane whose window has
+  // izp padding, or only has padding
+  std::vector<int64_t> pad_outputs;
+  std::vector<int64_t> pad_only_outputs;
   pool_attr_t _attrs;
   int _izp;
 };
@@ -48,12 +48,16 @@ void f32_to_f16(float *p_src, float *p_dst, int num);
 void f32_to_bf16(float *p_src, float *p_dst, int num);
 uint16_t f32_to_f16(float src);
 uint16_t f32_to_bf16(float src);
+void f32_to_f16(const float *p_src, uint16_t *p_dst, int64_t num);
+void f32_to_bf16(const float *p_src, uint16_t *p_dst, int64_t num);
 
 /*
 convert to f16/bf16 float to f32 float
 */
 float f16_to_f32(uint16_t src);
 float bf16_to_f32(uint16_t src);
+void f16_to_f32(const uint16_t *p_src, float *p_dst, int64_t num);
+void bf16_to_f32(const uint16_t *p_src, float *p_dst, int64_t num);
 
 /*
 for cv18xx
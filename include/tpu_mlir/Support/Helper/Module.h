@@ -31,6 +31,8 @@ struct Module {
     static constexpr llvm::StringRef GMEM_PRIVATE_SIZE = "module.private_size";
     static constexpr llvm::StringRef ASYMMETRIC = "module.asymmetric";
     static constexpr llvm::StringRef MODE = "module.mode";
+    // of WeightOp, hash of type and data, set by merge-weight
+    static constexpr llvm::StringRef MERGED_HASH = "merged_hash";
   };
 
   struct State {
@@ -80,6 +82,9 @@ struct Module {
   getF64Array(llvm::Optional<ArrayAttr> arrayAttr, int64_t num_elem,
               double default_value);
   static bool isOpInGroup(Operation *Op);
+  // weights sharing one name and one storage, merged by merge-weight
+  static bool isMergedWeight(top::WeightOp op);
+  static bool isMergedWeight(top::WeightOp a, top::WeightOp b);
   static FuncOp getFuncOp(ModuleOp module, StringRef func_name);
   static func::CallOp getCallOp(ModuleOp module, FuncOp func);
   static inline llvm::StringRef getName(ModuleOp module) {
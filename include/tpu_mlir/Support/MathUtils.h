@@ -120,8 +120,23 @@ void pad_tensor_for_deconv(float *p_after_pad, float *src, int n, int c, int d,
                            int h, int w, int kd, int kh, int kw, int dd, int dh,
                            int dw, int sd, int sh, int sw, int pdf, int pdb,
                            int pht, int phb, int pwl, int pwr, float pad_value);
+// Copy src (n, c, d, h, w) into p_after_pad (n, c, od, oh, ow), and keep the
+// padding as it is. For each of d/h/w, src[i] goes to dst[start + i * stride]
+// if it is in [0, end).
+void pad_tensor_interior(float *p_after_pad, float *src, int n, int c, int d,
+                         int h, int w, int od, int oh, int ow,
+                         const int start[3], const int stride[3],
+                         const int end[3]);
 void tensor_sub_zp(float *tensor_after_zp, float *src, int64_t length,
                    float zero_point);
+// nearest upsample of planes (h, w) to (h * scale_h, w * scale_w)
+void upsample_nearest(float *dst, const float *src, int64_t planes, int64_t h,
+                      int64_t w, int64_t scale_h, int64_t scale_w);
+// src (outer, axis_dim, inner) to dst (outer, num_indices, inner),
+// negative indices count from the end of axis
+void gather_inner(float *dst, const float *src, const float *indices,
+                  int64_t num_indices, int64_t outer, int64_t axis_dim,
+                  int64_t inner);
 
 int dnnl_mm(float *input, float *weight, float *bias, float *output, int m,
             int k, int n, bool transpose);
@@ -15,20 +15,49 @@
 #define MLIR_MODULEINTERPRETER_H_
 
 #include "tpu_mlir/Interfaces/InferenceInterface.h"
+#include "tpu_mlir/Support/ActivationStatistics.h"
 
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/MLIRContext.h"
 
 #include "llvm/Support/Debug.h"
 
+#include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <set>
 
 #define DEBUG_TYPE "interpreter"
 
 using namespace mlir;
 namespace tpu_mlir {
+// Statistics of one op, aggregated over invocations
+struct OpProfile {
+  std::string name;
+  std::string type;
+  int64_t count = 0;       // invocations
+  double time_us = 0;      // total wall time
+  int64_t flops = 0;       // per invocation, 0 if not FlopsInterface
+  int64_t read_bytes = 0;  // per invocation, all inputs
+  int64_t write_bytes = 0; // per invocation, all outputs
+};
+
+// Distance of a tensor to its fp32 reference, averaged over references
+struct TuneDistance {
+  double distance = 0; // |ref - x|_2 / |ref|_1
+  double cosine = 0;
+  double sqnr = 0; // dB
+};
+
+// Input tensors of one sample, by input name
+typedef std::map<std::string, std::vector<float>> InputSample;
+// Fill the next sample, return false at the end of the dataset
+typedef std::function<bool(InputSample &)> InputProducer;
+// Called after the sample idx is invoked, return false to stop
+typedef std::function<bool(int64_t idx)> OutputConsumer;
+
 // Implementation class for module interpreter.
 class ModuleInterpreter {
 
@@ -40,9 +69,33 @@ public:
   void invoke(bool express_type = true);
   void fake_quant_weight();
   std::shared_ptr<std::vector<float>> invoke_at(std::string name);
+  // Invoke every sample of producer in order. producer runs in a worker
+  // thread and prepares up to prefetch samples ahead of the inference.
+  void invoke_dataset(const InputProducer &producer,
+                      const OutputConsumer &consumer, int prefetch = 2);
+  // update stats with all activation tensors of the last invoke
+  void collect_statistics(ActivationStatistics &stats);
+  // cache all activations of the last invoke of fp32 as one reference sample
+  void add_reference(ModuleInterpreter &fp32);
+  void clear_references() { references.clear(); }
+  // Fake quantize the references of tensors in fake_quant with their
+  // thresholds, execute only their forward cone that reaches target, with
+  // the other inputs from the references, and compare target with its
+  // reference. Tensors in fake_quant are never computed again, so if they are
+  // the inputs of target, only the op of target runs. Tensors of the cone are
+  // left modified, set the inputs again before invoke.
+  TuneDistance eval_fake_quant(const std::map<std::string, double> &fake_quant,
+                               const std::string &target);
   void setTensor(const std::string &name, const void *data, size_t size, bool is_integer=false);
   std::shared_ptr<std::vector<float>> getTensor(const std::string &name);
   llvm::ArrayRef<int64_t> getTensorShape(const std::string &name);
+  // time every op in invoke; enabling again clears the records
+  void enable_profile(bool enable = true);
+  // sorted by total time, the most expensive first
+  std::vector<OpProfile> get_profile();
+  void print_profile(llvm::raw_ostream &os);
+  // chrome trace json, view with chrome://tracing or perfetto
+  void dump_profile_trace(const std::string &filename);
 
 public:
   std::vector<std::string> input_names;
@@ -50,12 +103,52 @@ public:
   std::vector<std::string> all_tensor_names; // activation tensor, without weight
   std::vector<std::string> all_weight_names; // weight tensor
 
+private:
+  void plan_alias(Operation *func);
+  float *tensor_data(const std::string &name);
+  // activations of one sample, without alias tensors
+  typedef std::map<std::string, std::vector<float>> Reference;
+  const float *reference_data(const Reference &ref, const std::string &name);
+  // forward cone from fake_quant to target, looked up once per
+  // (fake_quant, target)
+  struct TunePlan {
+    std::vector<Operation *> ops; // in topological order
+    std::vector<std::string> inputs; // read by ops, from the references
+  };
+  const TunePlan &tune_plan(const std::map<std::string, double> &fake_quant,
+                            const std::string &target);
+  void record_profile(const std::string &name,
+                      std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::time_point end);
+
 private:
   ModuleOp module;
   llvm::StringRef state;
   std::map<std::string, mlir::Value> value_map;
   std::map<std::string, std::shared_ptr<InferenceParameter>> inference_map;
   std::map<std::string, std::shared_ptr<std::vector<float>>> mem_map;
+  // tensors stored in the buffer of another tensor, so no copy is needed
+  struct TensorAlias {
+    std::string base;
+    int64_t offset; // in elements
+  };
+  std::map<std::string, TensorAlias> alias_map;
+  std::set<std::string> alias_ops; // ops done by aliasing, skipped in invoke
+  // fp32 activations of samples for tuning
+  std::vector<Reference> references;
+  std::map<std::pair<std::set<std::string>, std::string>, TunePlan> tune_plans;
+
+  struct TraceEvent {
+    uint32_t op_idx;
+    double start_us;
+    double dur_us;
+  };
+  static const size_t MAX_TRACE_EVENTS = 1 << 20;
+  bool profile_enabled = false;
+  std::vector<OpProfile> profiles;
+  std::map<std::string, uint32_t> profile_idx;
+  std::vector<TraceEvent> trace_events;
+  std::chrono::steady_clock::time_point profile_start;
 };
 
 } // namespace mlir
@@ -0,0 +1,32 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace tpu_mlir {
+
+// Permute src of shape to dst of shape (shape[order[0]], ...,
+// shape[order[n-1]]), for any number of dims. word_size is the element size
+// in bytes: 1, 2, 4 or 8.
+void permute(void *dst, const void *src, const std::vector<int64_t> &shape,
+             const std::vector<int64_t> &order, int word_size);
+
+template <typename T>
+void permute(T *dst, const T *src, const std::vector<int64_t> &shape,
+             const std::vector<int64_t> &order) {
+  static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 ||
+                    sizeof(T) == 8,
+                "unsupported element size");
+  permute((void *)dst, (const void *)src, shape, order, sizeof(T));
+}
+
+} // namespace tpu_mlir
@@ -47,8 +47,15 @@ void compressBf16Data(
     const uint8_t *ibuf, int isz, uint8_t *obuf, int *osz,
     CompressCommandInfo *cmd_info);
 
-// unit test
-void testCompress(void);
+// decompress data of compressInt8Data/compressBf16Data, osz is the size
+// of uncompressed data; cmd_info is read from the header
+void decompressInt8Data(
+    const uint8_t *ibuf, int isz, uint8_t *obuf, int osz,
+    CompressCommandInfo *cmd_info);
+
+void decompressBf16Data(
+    const uint8_t *ibuf, int isz, uint8_t *obuf, int osz,
+    CompressCommandInfo *cmd_info);
 
 class WeightCompresser {
 public:
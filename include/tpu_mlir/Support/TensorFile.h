@@ -15,6 +15,7 @@
 #define MLIR_SUPPORT_TENSORFILE_H_
 
 #include "cnpy.h"
+#include "tpu_mlir/Support/Permute.h"
 #include "mlir/Support/LogicalResult.h"
 #include "mlir/IR/OpDefinition.h"
 #include "mlir/Dialect/Quant/QuantTypes.h"
@@ -245,27 +246,24 @@ public:
 
   bool changed() { return cnt_add + cnt_del > 0; }
 
+  /// fortran order (d0, ..., dn-1) is c order of shape (dn-1, ..., d0), so
+  /// reverse all axes to get c order of shape (d0, ..., dn-1)
   template <typename T>
   void colMajorToRowMajor(T &des, const cnpy::NpyArray &src) {
     static_assert(std::is_same<typename T::value_type, char>::value,
                   "container value should be char");
     assert(des.size() == src.num_bytes());
-    size_t word_size = src.word_size;
-    for (size_t src_offset = 0, src_size = src.num_vals; src_offset < src_size;
-         ++src_offset) {
-      size_t des_offset = 0;
-      size_t ind_n /*ind(0)*/ = src_offset, sub_n /*sub(0)*/ = 0;
-      for (auto n : src.shape) {
-        sub_n = ind_n % n; //  sub(n) = ind(n) % n
-        des_offset = des_offset * n + sub_n;
-        ind_n = (ind_n - sub_n) / n; // ind(n+1) = (ind(n) - sub(n)) / n
-      }
-      memcpy(des.data() + des_offset * word_size,
-             src.data_holder->data() + src_offset * word_size, word_size);
+    std::vector<int64_t> shape(src.shape.rbegin(), src.shape.rend());
+    std::vector<int64_t> order;
+    for (int i = shape.size() - 1; i >= 0; i--) {
+      order.push_back(i);
     }
+    tpu_mlir::permute(des.data(), src.data_holder->data(), shape, order,
+                      src.word_size);
   }
 
-  void save(const std::string &file = "") {
+  /// compress_level: 0 for store only, 1~9 for zlib deflate
+  void save(const std::string &file = "", int compress_level = 0) {
     assert(!readOnly);
     if (cnt_add + cnt_del == 0) {
       return;
@@ -273,6 +271,15 @@ public:
     if (!file.empty()) {
       filename = file;
     }
+    toRowMajor();
+    cnpy::npz_save_all(filename, map, compress_level);
+    cnt_add = 0;
+    cnt_del = 0;
+    return;
+  }
+
+private:
+  void toRowMajor() {
     for (auto &it : map) {
       cnpy::NpyArray &array = it.second;
       if (array.fortran_order == true) {
@@ -283,17 +290,13 @@ public:
         array.fortran_order = false;
       }
     }
-
-    cnpy::npz_save_all(filename, map);
-    cnt_add = 0;
-    cnt_del = 0;
-    return;
   }
 
-private:
   /// load the file
   LogicalResult load(void) {
     map = cnpy::npz_load(filename);
+    // convert once here, then reading tensors is just memcpy
+    toRowMajor();
     if (map.size() > 0) {
       return success();
     } else {
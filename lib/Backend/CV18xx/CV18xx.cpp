@@ -15,7 +15,11 @@
 
 
 #include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <llvm/ADT/SmallString.h>
 #include <llvm/Support/Debug.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/Format.h>
 #include <llvm/Support/MathExtras.h>
 #include <llvm/Support/raw_ostream.h>
@@ -38,12 +42,112 @@ namespace backend {
 #define LOCAL_MEM_SIZE cvi_chip_info_context(CVI_CHIP_LMEM_SIZE)
 #define LOCAL_MEM_BANKS cvi_chip_info_context(CVI_CHIP_LMEM_BANK)
 
-CviBackendContext::CviBackendContext(const char *runchip) {
-  cvk_cmd_buf_.reserve(0x20000000);
+CviCmdBuf::~CviCmdBuf() {
+  if (fd_ >= 0) {
+    close(fd_);
+    llvm::sys::fs::remove(path_);
+  }
+}
+
+void CviCmdBuf::append(const uint8_t *data, size_t size) {
+  while (size > 0) {
+    if (chunks_.empty() || chunks_.back().size == chunks_.back().capacity) {
+      // small routines get one chunk of their size
+      size_t capacity = std::min(std::max(size, size_), CHUNK_SIZE);
+      chunks_.push_back(
+          {std::unique_ptr<uint8_t[]>(new uint8_t[capacity]), 0, capacity});
+    }
+    auto &chunk = chunks_.back();
+    auto n = std::min(size, chunk.capacity - chunk.size);
+    memcpy(chunk.data.get() + chunk.size, data, n);
+    chunk.size += n;
+    data += n;
+    size -= n;
+    size_ += n;
+  }
+}
+
+void CviCmdBuf::spill() {
+  if (chunks_.empty()) {
+    return;
+  }
+  if (fd_ < 0) {
+    llvm::SmallString<128> path;
+    auto ec = llvm::sys::fs::createTemporaryFile("cvi_cmdbuf", "bin", fd_, path);
+    if (ec) {
+      llvm::errs() << "create cmdbuf file failed: " << ec.message() << "\n";
+      llvm_unreachable("spill cmdbuf failed");
+    }
+    path_ = path.str().str();
+  }
+  for (auto &chunk : chunks_) {
+    size_t done = 0;
+    while (done < chunk.size) {
+      auto n = pwrite(fd_, chunk.data.get() + done, chunk.size - done,
+                      spilled_ + done);
+      if (n <= 0) {
+        llvm_unreachable("spill cmdbuf failed");
+      }
+      done += n;
+    }
+    spilled_ += chunk.size;
+  }
+  chunks_.clear();
+  LLVM_DEBUG(llvm::errs() << "spill cmdbuf " << spilled_ << " bytes to "
+                          << path_ << "\n";);
+}
+
+void CviCmdBuf::for_each(
+    llvm::function_ref<void(const uint8_t *, size_t)> fn) const {
+  if (spilled_ > 0) {
+    std::vector<uint8_t> buf(std::min(spilled_, CHUNK_SIZE));
+    size_t offset = 0;
+    while (offset < spilled_) {
+      auto n = pread(fd_, buf.data(), std::min(buf.size(), spilled_ - offset),
+                     offset);
+      if (n <= 0) {
+        llvm_unreachable("read spilled cmdbuf failed");
+      }
+      fn(buf.data(), n);
+      offset += n;
+    }
+  }
+  for (auto &chunk : chunks_) {
+    fn(chunk.data.get(), chunk.size);
+  }
+}
+
+void CviCmdBuf::read(std::vector<uint8_t> &out) const {
+  out.resize(size_);
+  size_t offset = 0;
+  for_each([&](const uint8_t *data, size_t size) {
+    memcpy(out.data() + offset, data, size);
+    offset += size;
+  });
+}
+
+CviBackendContext::CviBackendContext(const char *runchip)
+    : cmdbuf_(std::make_unique<CviCmdBuf>()) {
+  // Address space only, so large models don't overflow it and small ones
+  // don't commit memory for it. Fall back to the old size if the system
+  // refuses the reservation.
+  for (size_t size : {(size_t)0xF0000000, (size_t)0x20000000}) {
+    auto buf = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (buf != MAP_FAILED) {
+      cvk_cmd_buf_ = (uint8_t *)buf;
+      cvk_cmd_buf_size_ = size;
+      break;
+    }
+    cvk_cmd_buf_ = nullptr;
+  }
+  if (cvk_cmd_buf_ == nullptr) {
+    llvm_unreachable("reserve cmdbuf failed");
+  }
   cvk_reg_info_t req_info;
   strncpy(req_info.chip_ver_str, runchip, sizeof(req_info.chip_ver_str) - 1);
-  req_info.cmdbuf_size = cvk_cmd_buf_.capacity();
-  req_info.cmdbuf = cvk_cmd_buf_.data();
+  req_info.cmdbuf_size = cvk_cmd_buf_size_;
+  req_info.cmdbuf = cvk_cmd_buf_;
 
   cvk_ctx_ = CV18xx::instance().dl_cvikernel_register(&req_info);
 
@@ -63,27 +167,39 @@ CviBackendContext::CviBackendContext(const char *runchip) {
 
 CviBackendContext::~CviBackendContext() {
   cvk_ctx_->ops->cleanup(cvk_ctx_);
-  cvk_cmd_buf_.clear();
-  cvk_cmd_buf_.shrink_to_fit();
+  LLVM_DEBUG(llvm::errs() << "cmdbuf peak size " << peak_cmdbuf_size_
+                          << "\n";);
+  munmap(cvk_cmd_buf_, cvk_cmd_buf_size_);
   free(cvk_ctx_);
 }
 
 void CviBackendContext::write_cmdbuf(const void *cmdbuf, uint32_t size) {
-  cmdbuf_.resize(size);
-  memcpy(&cmdbuf_[0], cmdbuf, size);
+  cmdbuf_ = std::make_unique<CviCmdBuf>();
+  cmdbuf_->append((const uint8_t *)cmdbuf, size);
+  if (size >= CviCmdBuf::SPILL_SIZE) {
+    cmdbuf_->spill();
+  }
 }
 
 void CviBackendContext::read_cmdbuf(std::vector<uint8_t> &out_cmdbuf) {
-  out_cmdbuf.assign(cmdbuf_.begin(), cmdbuf_.end());
+  cmdbuf_->read(out_cmdbuf);
+}
+
+std::unique_ptr<CviCmdBuf> CviBackendContext::take_cmdbuf() {
+  auto cmdbuf = std::move(cmdbuf_);
+  cmdbuf_ = std::make_unique<CviCmdBuf>();
+  return cmdbuf;
 }
 
 void CviBackendContext::dmabuf_convert(std::vector<uint8_t> &dmabuf) {
   uint32_t dmabuf_sz = 0;
   uint32_t pmu_sz = 0;
-  cvk_ctx_->ops->dmabuf_size(cmdbuf_.data(), cmdbuf_.size(),
+  std::vector<uint8_t> cmdbuf;
+  cmdbuf_->read(cmdbuf);
+  cvk_ctx_->ops->dmabuf_size(cmdbuf.data(), cmdbuf.size(),
                              &dmabuf_sz, &pmu_sz);
   dmabuf.resize(dmabuf_sz);
-  cvk_ctx_->ops->dmabuf_convert(cmdbuf_.data(), cmdbuf_.size(),
+  cvk_ctx_->ops->dmabuf_convert(cmdbuf.data(), cmdbuf.size(),
                                 dmabuf.data());
 }
 
@@ -91,7 +207,17 @@ void CviBackendContext::submit() {
   uint32_t size;
   uint8_t *cmdbuf = cvk_ctx_->ops->acquire_cmdbuf(cvk_ctx_, &size);
   write_cmdbuf(cmdbuf, size);
+  peak_cmdbuf_size_ = std::max(peak_cmdbuf_size_, (size_t)size);
   cvk_ctx_->ops->reset(cvk_ctx_);
+  // Commands are copied out, return the used pages beyond the first
+  // CMDBUF_RESIDENT_SIZE, which small submits keep reusing.
+  size_t page = sysconf(_SC_PAGESIZE);
+  auto begin = (uintptr_t)cvk_cmd_buf_ + CMDBUF_RESIDENT_SIZE;
+  auto end = llvm::alignTo((uintptr_t)cmdbuf + size, page);
+  end = std::min(end, (uintptr_t)cvk_cmd_buf_ + cvk_cmd_buf_size_);
+  if (end > begin) {
+    madvise((void *)begin, end - begin, MADV_DONTNEED);
+  }
 }
 
 int CviBackendContext::cvi_chip_info_context(
@@ -144,6 +270,10 @@ void cvi_backend_get_cmdbuf(CviBackendContext *ctx,
   ctx->read_cmdbuf(cmdbuf);
 }
 
+std::unique_ptr<CviCmdBuf> cvi_backend_take_cmdbuf(CviBackendContext *ctx) {
+  return ctx->take_cmdbuf();
+}
+
 void cvi_backend_dmabuf_convert(CviBackendContext *ctx,
                                 std::vector<uint8_t> &dmabuf) {
   ctx->dmabuf_convert(dmabuf);
@@ -11,10 +11,25 @@
 #include "tpu_mlir/Backend/CV18xx/Kernel/TgConvKernel.hpp"
 #include "tpu_mlir/Support/TPUCompressUtil.h"
 #include "tpu_mlir/Backend/CV18xx/CV18xx_local_api.h"
+#include "llvm/Support/CommandLine.h"
+#include <cinttypes>
+#include <map>
+#include <mutex>
 #include <numeric>
 
 #define DEBUG_TYPE "cvi_backend_conv_kernel"
 
+static llvm::cl::opt<bool> clConvTilePolicyReport(
+    "cv18xx-conv-tile-report",
+    llvm::cl::desc("report tile policy and predicted cycles of cv18xx conv"),
+    llvm::cl::init(false));
+
+static llvm::cl::opt<bool> clConvTileByCost(
+    "cv18xx-conv-tile-by-cost",
+    llvm::cl::desc("choose tiled policy of cv18xx conv by predicted cycles, "
+                   "instead of the fixed priority"),
+    llvm::cl::init(false));
+
 using namespace mlir;
 using namespace tpu_mlir;
 
@@ -3404,14 +3419,88 @@ void Conv::convNaive() {
   LLVM_DEBUG(llvm::errs() << "<= convNaive\n");
 }
 
+std::string Conv::getTilePolicyStr(TilePolicy policy) {
+  switch (policy) {
+  case NoTilePolicyType:
+    return "NoTile";
+  case SingleBufferPolicyType:
+    return "SingleBuffer";
+  case SingleBufferPs32PolicyType:
+    return "SingleBufferPs32";
+  case ReuseWeightPolicyType:
+    return "ReuseWeight";
+  case ReuseActivationPolicyType:
+    return "ReuseActivation";
+  default:
+    return "Unknown";
+  }
+}
+
 void Conv::showCost(CostModel &cost) {
   LLVM_DEBUG(llvm::dbgs() << "total " << cost.totalRWSize << ", weight read "
                           << cost.wgtReadSize << ", act read "
                           << cost.actReadSize << ", act write "
-                          << cost.actWriteSize << "\n");
+                          << cost.actWriteSize << ", tdma cycles "
+                          << cost.tdmaCycles << ", tiu cycles "
+                          << cost.tiuCycles << ", total cycles "
+                          << cost.totalCycles << "\n");
 }
 
+// Rough timing of cv18xx, only used to compare tile policies.
+// E.g. Resnet50 scale2b_branch2c in DDR3 platform (see checkDmaPolicy)
+//   (1, 96, 56, 56) tiu 19471, store 31056
+//   => ~10 bytes per cycle for tdma, 2 int8 macs per eu per cycle for tiu.
+static const uint64_t TDMA_CMD_CYCLES = 64;
+static const uint64_t TDMA_BURST_BYTES = 16;
+static const uint64_t TDMA_BYTES_PER_CYCLE = 10;
+static const uint64_t TIU_CMD_CYCLES = 32;
+
+// Global memory is accessed in bursts, so short rows waste bandwidth.
+// The rows are merged if the tile uses the whole width of global memory.
+uint64_t Conv::getTdmaCycles(std::vector<uint32_t> shapes, uint32_t gmWidth,
+                             cvk_fmt_t fmt) {
+  uint64_t count = std::accumulate(std::begin(shapes), std::end(shapes),
+                                   (uint64_t)1, std::multiplies<>());
+  if (!count)
+    return 0;
+  uint64_t row = shapes.back();
+  if (row == gmWidth && shapes.size() > 1)
+    row *= shapes[shapes.size() - 2];
+  uint64_t rowBytes = row * getElementTypeSize(fmt);
+  uint64_t burstBytes =
+      (rowBytes + TDMA_BURST_BYTES - 1) / TDMA_BURST_BYTES * TDMA_BURST_BYTES;
+  return TDMA_CMD_CYCLES +
+         (count / row * burstBytes + TDMA_BYTES_PER_CYCLE - 1) /
+             TDMA_BYTES_PER_CYCLE;
+}
+
+// Output channels are distributed to lanes, output height*width to eus.
+// Each output takes macs cycles.
+uint64_t Conv::getTiuCycles(std::vector<uint32_t> outputShapes,
+                            uint32_t macs) {
+  uint64_t euNum = ctx.tiu_eu_num(args.tiu_fmt);
+  if (args.tiu_fmt != CVK_FMT_BF16)
+    euNum *= 2;
+  uint64_t lanes = ceiling_func(outputShapes[NGCHW::C], NPU_NUM);
+  uint64_t planes =
+      ((uint64_t)outputShapes[NGCHW::H] * outputShapes[NGCHW::W] + euNum - 1) /
+      euNum;
+  return TIU_CMD_CYCLES + lanes * outputShapes[NGCHW::N] * planes * macs;
+}
+
+// The tdma and tiu commands between enqueueEnParallelCmd and
+// enqueueDisParallelCmd are executed in parallel, others in sequence.
 void Conv::getCost(CostModel &cost) {
+  bool parallel = false;
+  uint64_t tdmaCycles = 0, tiuCycles = 0;
+  auto flush = [&]() {
+    cost.tdmaCycles += tdmaCycles;
+    cost.tiuCycles += tiuCycles;
+    cost.totalCycles += parallel ? std::max(tdmaCycles, tiuCycles)
+                                 : tdmaCycles + tiuCycles;
+    tdmaCycles = tiuCycles = 0;
+  };
+
   for (uint32_t i = 0; i < cmdQueue.size(); ++i) {
     CmdDescriptor::CmdTypeEnum cmdType = cmdQueue[i]->getCmdType();
     std::vector<uint32_t> gmOutputPoss = cmdQueue[i]->getGmOutputPoss();
@@ -3419,7 +3508,17 @@ void Conv::getCost(CostModel &cost) {
     uint32_t icPos = cmdQueue[i]->getIcPos();
 
     if (cmdType == CmdDescriptor::LoadBiasCmdType) {
+      // loadBias(gmOutputPoss, lmIndexes[0], i);
+      if (args.do_chl_quan || args.do_bias)
+        tdmaCycles +=
+            getTdmaCycles(getTiledGmShapesOfBiasForTdmaLoad(gmOutputPoss),
+                          /*gmWidth=*/0, CVK_FMT_I8);
     } else if (cmdType == CmdDescriptor::LoadQuantCmdType) {
+      // loadQuant(gmOutputPoss, lmIndexes[0], i);
+      if (args.do_quant)
+        tdmaCycles +=
+            2 * getTdmaCycles(getTiledGmShapesOfQuantForTdmaLoad(gmOutputPoss),
+                              /*gmWidth=*/0, args.tiu_fmt);
     } else if (cmdType == CmdDescriptor::LoadInputCmdType) {
       // loadInput(gmOutputPoss, lmIndexes[0], i, icPos);
       std::vector<uint32_t> gmOutputPossShapes =
@@ -3436,6 +3535,7 @@ void Conv::getCost(CostModel &cost) {
                                    std::multiplies<>());
       cost.totalRWSize += count;
       cost.actReadSize += count;
+      tdmaCycles += getTdmaCycles(shapes, input_width(), args.input_fmt);
     } else if (cmdType == CmdDescriptor::LoadWeightCmdType) {
       // loadWeight(gmOutputPoss, lmIndexes[0], i, icPos);
       std::vector<uint32_t> shapes =
@@ -3444,14 +3544,44 @@ void Conv::getCost(CostModel &cost) {
                                    std::multiplies<>());
       cost.totalRWSize += count;
       cost.wgtReadSize += count;
+      tdmaCycles += getTdmaCycles(shapes, group_input_channels(), args.tiu_fmt);
     } else if (cmdType == CmdDescriptor::LoadScaleLutTblCmdType) {
-
+      tdmaCycles += TDMA_CMD_CYCLES;
     } else if (cmdType == CmdDescriptor::ComputCmdType) {
       // compute(gmOutputPoss, lmIndexes, i, icPos);
+      std::vector<uint32_t> shapes =
+          getTiledGmShapesOfOutputForTiu(gmOutputPoss);
+      uint32_t cur_ic =
+          std::min(group_input_channels() - icPos, tile_info.ic_step);
+      tiuCycles +=
+          getTiuCycles(shapes, cur_ic * kernel_height() * kernel_width());
+
+      // Partial sum is read/written in 32bit, 4 bytes per output.
+      uint32_t ps32Mode = getPs32Mode(icPos);
+      if (ps32Mode == 1 || ps32Mode == 2)
+        tiuCycles += getTiuCycles(shapes, 4);
+      else if (ps32Mode == 3)
+        tiuCycles += getTiuCycles(shapes, 8);
+
+      // tl_relu, tl_neg, and merge
+      if (args.do_leaky_relu && (ps32Mode == 0 || ps32Mode == 1))
+        tiuCycles += 3 * getTiuCycles(shapes, 1);
     } else if (cmdType == CmdDescriptor::ComputeScaleLutCmdType) {
-
+      // computeScaleLut(gmOutputPoss, lmIndexes[0], i, icPos);
+      std::vector<uint32_t> shapes =
+          getTiledGmShapesOfOutputForTiu(gmOutputPoss);
+      shapes[NGCHW::C] = std::min(group_input_channels() - icPos,
+                                  tile_info.ic_step);
+      shapes[NGCHW::H] = tile_info.ih_step;
+      shapes[NGCHW::W] = tile_info.iw_step;
+      tiuCycles += getTiuCycles(shapes, 1);
     } else if (cmdType == CmdDescriptor::ComputeQuantCmdType) {
-
+      // computeQuant(gmOutputPoss, lmIndexes[0], i, icPos);
+      std::vector<uint32_t> shapes =
+          getTiledGmShapesOfWeightForTdmaLoad(gmOutputPoss, icPos);
+      tiuCycles += getTiuCycles({1, 1, shapes[NGCHW::C], shapes[NGCHW::H],
+                                 shapes[NGCHW::W]},
+                                2);
     } else if (cmdType == CmdDescriptor::StoreOutputCmdType) {
       // storeOutput(gmOutputPoss, lmIndexes[0], i);
 
@@ -3461,23 +3591,96 @@ void Conv::getCost(CostModel &cost) {
                                    std::multiplies<>());
       cost.totalRWSize += count;
       cost.actWriteSize += count;
+      tdmaCycles += getTdmaCycles(shapes, output_width(), args.output_fmt);
     } else if (cmdType == CmdDescriptor::ParallelCmdType) {
       // genParallCmd(i);
+      flush();
+      parallel = cmdQueue[i]->isParallelEnabled();
     } else {
       assert(0 && "Expect valid command");
     }
   }
+  flush();
 }
 
 bool Conv::isBetterCost(CostModel &from, CostModel &to) {
-  // Since both reuse weight and reuse activation use double buffer,
-  // use total read/write size as cost factor.
+  // Estimated latency first, then total read/write size.
+  if (to.totalCycles != from.totalCycles)
+    return to.totalCycles < from.totalCycles;
+
   if (to.totalRWSize < from.totalRWSize)
     return true;
 
   return false;
 }
 
+void Conv::enqueueCmdsByTilePolicy() {
+  switch (tilePolicy) {
+  case NoTilePolicyType:
+    convNoTile();
+    break;
+
+  case SingleBufferPolicyType:
+    convNaive();
+    break;
+
+  case SingleBufferPs32PolicyType:
+    convNaive();
+    break;
+
+  case ReuseWeightPolicyType:
+    convReuseWeight();
+    break;
+
+  case ReuseActivationPolicyType:
+    convReuseActivation();
+    break;
+
+  default:
+    return;
+  }
+}
+
+// Generate the commands of the policy with current tile size, and keep it
+// if it is better than the best one so far.
+void Conv::evaluateTilePolicy(TilePolicy policy, TileDecision &best) {
+  CostModel cost = {0};
+
+  tilePolicy = policy;
+  enqueueCmdsByTilePolicy();
+  getCost(cost);
+  cmdQueue.clear();
+
+  LLVM_DEBUG(llvm::dbgs() << "  " << getTilePolicyStr(policy) << ": ");
+  showCost(cost);
+
+  if (best.policy == MaxTilePolicyType || isBetterCost(best.cost, cost))
+    best = {policy, tile_info, use_double_buffer, cost};
+}
+
+// Everything that tile size and commands depend on.
+std::vector<int64_t> Conv::getTileDecisionKey() {
+  bool leaky = args.do_activation && args.activation_arg &&
+               args.activation_arg[0] != 0.0f;
+  return {NPU_NUM,          EU_NUM,
+          LOCAL_MEM_SIZE,   args.input_n,
+          args.input_c,     args.input_h,
+          args.input_w,     args.groups,
+          args.output_c,    args.kh,
+          args.kw,          args.dilation_h,
+          args.dilation_w,  args.pad_top,
+          args.pad_bottom,  args.pad_left,
+          args.pad_right,   args.insert_h,
+          args.insert_w,    args.stride_h,
+          args.stride_w,    args.do_bias,
+          args.do_activation, leaky,
+          args.do_quant,    args.do_chl_quan,
+          args.do_ic_alignment, args.do_load_cmpr_wgt,
+          args.input_fmt,   args.output_fmt,
+          args.tiu_fmt,     args.ps32_output,
+          args.do_scale_lut};
+}
+
 Conv::TilePolicy Conv::getReuseWgtOrActByCost() {
   CostModel wgtCost = {0}, actCost = {0};
 
@@ -3488,7 +3691,9 @@ Conv::TilePolicy Conv::getReuseWgtOrActByCost() {
   cmdQueue.clear();
   convReuseWeight();
   getCost(wgtCost);
-  if (isBetterCost(wgtCost, actCost))
+  // Since both reuse weight and reuse activation use double buffer,
+  // use total read/write size as cost factor.
+  if (actCost.totalRWSize < wgtCost.totalRWSize)
     policy = ReuseActivationPolicyType;
 
   cmdQueue.clear();
@@ -3496,21 +3701,14 @@ Conv::TilePolicy Conv::getReuseWgtOrActByCost() {
   return policy;
 }
 
-// Priority:
-//   1. No tiling
-//   2. Reuse weight w/ double buffer
-//   3. Reuse activation w/ double buffer
-//   4. Tile w/ single buffer
-//   5. Tile+ps32 w/ single buffer
+// Priority of tiled policies:
+//   1. Reuse weight w/ double buffer
+//   2. Reuse activation w/ double buffer
+//   3. Tile w/ single buffer
+//   4. Tile+ps32 w/ single buffer
 //
-void Conv::determineTilePolicy() {
-  if (canNoTile()) {
-    // No tiling should be the best condition
-    tilePolicy = NoTilePolicyType;
-
-    // Update tiling again for ic alignment.
-    initializeTile();
-  } else if (determineTileSize(true, true)) {
+void Conv::determineTilePolicyByPriority() {
+  if (determineTileSize(true, true)) {
     // Use single buffer to increase eu efficiency if output height*width is
     // too small.
     if (tile_info.ow_step < output_width() &&
@@ -3548,6 +3746,91 @@ void Conv::determineTilePolicy() {
   }
 }
 
+// Try all feasible tiled policies and choose the one of minimal estimated
+// cycles. The former one is preferred if the same.
+void Conv::determineTilePolicyByCost(TileDecision &best) {
+  best.policy = MaxTilePolicyType;
+  if (determineTileSize(true, true)) {
+    use_double_buffer = true;
+    evaluateTilePolicy(ReuseWeightPolicyType, best);
+    evaluateTilePolicy(ReuseActivationPolicyType, best);
+  }
+  if (determineTileSize(false, true)) {
+    use_double_buffer = false;
+    evaluateTilePolicy(SingleBufferPolicyType, best);
+  }
+  if (determinePs32TileSize(false)) {
+    use_double_buffer = false;
+    evaluateTilePolicy(SingleBufferPs32PolicyType, best);
+  }
+  assert(best.policy != MaxTilePolicyType && "Expect valid tile policy");
+
+  tilePolicy = best.policy;
+  tile_info = best.tile_info;
+  use_double_buffer = best.use_double_buffer;
+}
+
+// Convolutions with the same signature get the same decision.
+static std::mutex tileDecisionMutex;
+static std::map<std::vector<int64_t>, Conv::TileDecision> tileDecisionCache;
+
+// No tiling is always the best if it fits. Otherwise tiled policies are
+// chosen by fixed priority, or by estimated cycles with
+// --cv18xx-conv-tile-by-cost.
+void Conv::determineTilePolicy() {
+  auto key = getTileDecisionKey();
+  TileDecision best;
+  bool cached = false;
+  {
+    std::lock_guard<std::mutex> lock(tileDecisionMutex);
+    auto it = tileDecisionCache.find(key);
+    if (it != tileDecisionCache.end()) {
+      best = it->second;
+      cached = true;
+    }
+  }
+
+  if (!cached) {
+    best.policy = MaxTilePolicyType;
+    if (canNoTile()) {
+      // No tiling should be the best condition
+      tilePolicy = NoTilePolicyType;
+
+      // Update tiling again for ic alignment.
+      initializeTile();
+    } else if (clConvTileByCost) {
+      determineTilePolicyByCost(best);
+    } else {
+      determineTilePolicyByPriority();
+    }
+
+    if (best.policy == MaxTilePolicyType) {
+      // Cost is only for the report.
+      if (clConvTilePolicyReport)
+        evaluateTilePolicy(tilePolicy, best);
+      else
+        best = {tilePolicy, tile_info, use_double_buffer, {0}};
+    }
+
+    std::lock_guard<std::mutex> lock(tileDecisionMutex);
+    tileDecisionCache[key] = best;
+  }
+
+  tilePolicy = best.policy;
+  tile_info = best.tile_info;
+  use_double_buffer = best.use_double_buffer;
+
+  if (clConvTilePolicyReport)
+    llvm::errs() << llvm::format(
+        "conv tile policy: layer_id %d, %s, step (n=%d, oc=%d, oh=%d, ow=%d, "
+        "ic=%d), tdma %" PRIu64 ", tiu %" PRIu64 ", predicted %" PRIu64
+        " cycles%s\n",
+        args.layer_id, getTilePolicyStr(tilePolicy).c_str(), tile_info.n_step,
+        tile_info.oc_step, tile_info.oh_step, tile_info.ow_step,
+        tile_info.ic_step, best.cost.tdmaCycles, best.cost.tiuCycles,
+        best.cost.totalCycles, cached ? ", cached" : "");
+}
+
 bool Conv::compressWeight() {
   bool isBf16Flt = (args.tiu_fmt == CVK_FMT_BF16);
   int fltEltSize = isBf16Flt ? 2 : 1;
@@ -3566,8 +3849,6 @@ bool Conv::compressWeight() {
   int totalCompressedSize = 0;
 
   int maxPlainSize = oc_step *kh * kw *ic * fltEltSize;
-  auto plainData = std::make_unique<std::vector<uint8_t> >(maxPlainSize);
-
   int maxComprSize = getCompressedDataSize(maxPlainSize, isBf16Flt ? 1 : 0);
   auto compressedData = std::make_unique<std::vector<uint8_t>>(maxComprSize);
 
@@ -3584,7 +3865,7 @@ bool Conv::compressWeight() {
       break;
     }
 
-    std::memcpy(plainData->data(), args.filter->data() + pos, stepSize);
+    const uint8_t *plainData = args.filter->data() + pos;
 
     // Calculate compress parameter first.
     CompressCommandInfo cmdInfo;
@@ -3592,17 +3873,32 @@ bool Conv::compressWeight() {
     cmdInfo.signedness = isBf16Flt ? 0 : 1;
     cmdInfo.is_bfloat16 = isBf16Flt ? 1 : 0;
     cmdInfo.bias0 = isBf16Flt ? 127 : 0;
-    getCompressParameter(plainData->data(), stepSize, cmdInfo.signedness,
+    getCompressParameter(plainData, stepSize, cmdInfo.signedness,
                          cmdInfo.is_bfloat16, &cmdInfo);
 
     int compressedSize = maxComprSize;
     if (isBf16Flt)
-      compressBf16Data(plainData->data(), stepSize, compressedData->data(),
+      compressBf16Data(plainData, stepSize, compressedData->data(),
                        &compressedSize, &cmdInfo);
     else
-      compressInt8Data(plainData->data(), stepSize, compressedData->data(),
+      compressInt8Data(plainData, stepSize, compressedData->data(),
                        &compressedSize, &cmdInfo);
 
+    // Check the round trip in debug mode.
+    LLVM_DEBUG({
+      std::vector<uint8_t> decompressed(stepSize);
+      CompressCommandInfo decInfo;
+      if (isBf16Flt)
+        decompressBf16Data(compressedData->data(), compressedSize,
+                           decompressed.data(), stepSize, &decInfo);
+      else
+        decompressInt8Data(compressedData->data(), compressedSize,
+                           decompressed.data(), stepSize, &decInfo);
+      if (!isBf16Flt || !cmdInfo.zero_guard_en)
+        assert(std::memcmp(decompressed.data(), plainData, stepSize) == 0 &&
+               "compressed weight mismatch");
+    });
+
     // Compress size must be less than tiled size.
     LLVM_DEBUG(llvm::dbgs()
                << "  [oc_pos=" << oc_pos << "] cur_oc " << cur_oc
@@ -3628,6 +3924,9 @@ bool Conv::compressWeight() {
     std::memcpy(args.new_filter->data() + pos, compressedData->data(),
                 compressedSize);
   }
+  LLVM_DEBUG(if (canCompress && totalCompressedSize) llvm::dbgs()
+             << "  compress ratio " << totalSize << "/" << totalCompressedSize
+             << " = " << (float)totalSize / totalCompressedSize << "\n");
   return canCompress;
 }
 
@@ -3638,30 +3937,10 @@ void Conv::doConvByTilePolicy() {
 
   configCModelDebug();
 
-  switch (tilePolicy) {
-  case NoTilePolicyType:
-    convNoTile();
-    break;
-
-  case SingleBufferPolicyType:
-    convNaive();
-    break;
-
-  case SingleBufferPs32PolicyType:
-    convNaive();
-    break;
-
-  case ReuseWeightPolicyType:
-    convReuseWeight();
-    break;
-
-  case ReuseActivationPolicyType:
-    convReuseActivation();
-    break;
-
-  default:
+  if (tilePolicy >= MaxTilePolicyType)
     return;
-  }
+
+  enqueueCmdsByTilePolicy();
 
   if (args.do_load_cmpr_wgt) {
     if (!compressWeight()) {
@@ -13,8 +13,13 @@
  */
 
 #include "tpu_mlir/Builder/BM168x/bmodel.hpp"
+#include <fcntl.h>
 #include <memory.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <ctime>
 #include <iostream>
 
@@ -51,6 +56,7 @@ const uint32_t BMODEL_MAGIC = 0xFF55AAEE;
 ModelGen::ModelGen(uint32_t reserved_size)
 {
   binary_.reserve(reserved_size);
+  reserved_size_ = 0;
   max_neuron_size_ = 0;
 }
 
@@ -64,14 +70,24 @@ ModelGen::~ModelGen()
   builder_.Release();
 }
 
+const uint8_t *ModelGen::BinaryData(uint32_t idx)
+{
+  if (binary_src_[idx] != NULL) {
+    return binary_src_[idx];
+  }
+  return binary_.data() + binary_vector_[idx].start();
+}
+
 Binary ModelGen::WriteBinary(size_t size, uint8_t *data)
 {
   // ASSERT(size != 0 && data != NULL);
-  for (auto &binary : binary_vector_) {
+  ASSERT(reserved_size_ == 0);
+  for (uint32_t idx = 0; idx < binary_vector_.size(); idx++) {
+    auto &binary = binary_vector_[idx];
     if (binary.size() != size) {
       continue;
     }
-    if (memcmp(data, binary_.data() + binary.start(), size) == 0) {
+    if (memcmp(data, BinaryData(idx), size) == 0) {
       return binary;
     }
   }
@@ -80,9 +96,51 @@ Binary ModelGen::WriteBinary(size_t size, uint8_t *data)
   memcpy(binary_.data() + start, data, size);
   Binary new_bin(start, size);
   binary_vector_.push_back(new_bin);
+  binary_src_.push_back(NULL);
   return new_bin;
 }
 
+Binary ModelGen::ReserveBinary(size_t size, const uint8_t *data)
+{
+  for (uint32_t idx = 0; idx < binary_vector_.size(); idx++) {
+    auto &binary = binary_vector_[idx];
+    if (binary.size() != size) {
+      continue;
+    }
+    auto src = BinaryData(idx);
+    if (src == data || memcmp(data, src, size) == 0) {
+      return binary;
+    }
+  }
+  Binary new_bin(binary_.size() + reserved_size_, size);
+  reserved_size_ += size;
+  binary_vector_.push_back(new_bin);
+  binary_src_.push_back(data);
+  return new_bin;
+}
+
+// copy referenced binary data to dst, which is the start of binary section
+void ModelGen::GatherBinary(uint8_t *dst)
+{
+  const uint64_t CHUNK = 0x1000000;
+  vector<std::pair<uint32_t, uint64_t>> chunks;
+  for (uint32_t idx = 0; idx < binary_vector_.size(); idx++) {
+    if (binary_src_[idx] == NULL) {
+      continue;
+    }
+    for (uint64_t offset = 0; offset < binary_vector_[idx].size(); offset += CHUNK) {
+      chunks.push_back({idx, offset});
+    }
+  }
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < chunks.size(); i++) {
+    auto &binary = binary_vector_[chunks[i].first];
+    auto offset = chunks[i].second;
+    auto size = std::min(CHUNK, binary.size() - offset);
+    memcpy(dst + binary.start() + offset, binary_src_[chunks[i].first] + offset, size);
+  }
+}
+
 void ModelGen::AddNet(const flatbuffers::Offset<bmodel::Net> &net)
 {
   nets_.push_back(net);
@@ -271,7 +329,7 @@ size_t ModelGen::Finish()
   builder_.Finish(model);
 
   // return size
-  size_t size = sizeof(MODEL_HEADER_T) + builder_.GetSize() + binary_.size();
+  size_t size = sizeof(MODEL_HEADER_T) + builder_.GetSize() + binary_.size() + reserved_size_;
   return size;
 }
 
@@ -283,6 +341,10 @@ uint8_t *ModelGen::GetBufferPointer()
 void ModelGen::Save(const string &filename)
 {
   ASSERT(!filename.empty());
+  if (reserved_size_ != 0) {
+    SaveReserved(filename);
+    return;
+  }
   std::ofstream fout(filename, std::ios::out | std::ios::trunc | std::ios::binary);
   if (!fout) {
     BMODEL_LOG(FATAL) << "Save file[" << filename << "] failed." << std::endl;
@@ -300,6 +362,26 @@ void ModelGen::Save(const string &filename)
   fout.close();
 }
 
+// save with referenced binary data: the file is mapped, and the referenced
+// data is copied straight from its source into the map in parallel
+void ModelGen::SaveReserved(const string &filename)
+{
+  size_t size = sizeof(MODEL_HEADER_T) + builder_.GetSize() + binary_.size() + reserved_size_;
+  int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate(fd, size) != 0) {
+    BMODEL_LOG(FATAL) << "Save file[" << filename << "] failed." << std::endl;
+    exit(-1);
+  }
+  void *buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (buffer == MAP_FAILED) {
+    BMODEL_LOG(FATAL) << "Map file[" << filename << "] failed." << std::endl;
+    exit(-1);
+  }
+  Save(buffer);
+  munmap(buffer, size);
+}
+
 void ModelGen::Save(void *buffer)
 {
   ASSERT(buffer != NULL);
@@ -308,32 +390,41 @@ void ModelGen::Save(void *buffer)
   p_header->magic = BMODEL_MAGIC;
   p_header->header_size = sizeof(MODEL_HEADER_T);
   p_header->flatbuffers_size = builder_.GetSize();
-  p_header->binary_size = binary_.size();
+  p_header->binary_size = binary_.size() + reserved_size_;
   uint8_t *p_flb = (uint8_t *)buffer + p_header->header_size;
   memcpy(p_flb, builder_.GetBufferPointer(), p_header->flatbuffers_size);
   uint8_t *p_binary = p_flb + p_header->flatbuffers_size;
-  memcpy(p_binary, binary_.data(), p_header->binary_size);
+  memcpy(p_binary, binary_.data(), binary_.size());
+  GatherBinary(p_binary);
 }
 
-ModelCtx::ModelCtx(const string &filename) : model_gen_(NULL), model_(NULL), bmodel_pointer_(NULL)
+ModelCtx::ModelCtx(const string &filename)
+    : model_gen_(NULL), model_(NULL), model_buffer_(NULL), mmap_addr_(NULL), mmap_size_(0),
+      bmodel_pointer_(NULL)
 {
-  // read file
-  file_.open(filename, std::ios::binary | std::ios::in);
-  if (!file_) {
+  // map file, flatbuffers and binary data are accessed in place
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
     BMODEL_LOG(FATAL) << "File[" << filename << "] open failed." << std::endl;
     exit(-1);
   }
-  file_.seekg(0, std::ios::end);
-  size_t length = file_.tellg();
-  if (length <= sizeof(header_)) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size <= sizeof(header_)) {
     BMODEL_LOG(FATAL) << "File[" << filename << "] is broken ." << std::endl;
     exit(-1);
   }
-  file_.seekg(0, std::ios::beg);
+  size_t length = st.st_size;
+  void *addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    BMODEL_LOG(FATAL) << "File[" << filename << "] map failed." << std::endl;
+    exit(-1);
+  }
+  mmap_addr_ = addr;
+  mmap_size_ = length;
 
   // read header and check
-  memset(&header_, 0, sizeof(header_));
-  file_.read((char *)&header_, sizeof(header_));
+  memcpy(&header_, mmap_addr_, sizeof(header_));
   if (header_.magic != BMODEL_MAGIC) {
     BMODEL_LOG(FATAL) << "File[" << filename << "] is broken .." << std::endl;
     exit(-1);
@@ -343,9 +434,7 @@ ModelCtx::ModelCtx(const string &filename) : model_gen_(NULL), model_(NULL), bmo
     exit(-1);
   }
   binary_offset_ = header_.header_size + header_.flatbuffers_size;
-  model_buffer_ = (void *)malloc(header_.flatbuffers_size);
-  ASSERT(model_buffer_ != NULL);
-  file_.read((char *)model_buffer_, header_.flatbuffers_size);
+  model_buffer_ = (uint8_t *)mmap_addr_ + header_.header_size;
   flatbuffers::Verifier v((uint8_t *)model_buffer_, header_.flatbuffers_size);
   if (!bmodel::VerifyModelBuffer(v)) {
     BMODEL_LOG(FATAL) << "Model file[" << filename << "] is broken." << std::endl;
@@ -362,10 +451,12 @@ ModelCtx::ModelCtx(const string &filename) : model_gen_(NULL), model_(NULL), bmo
   model_ = bmodel::GetModel(model_buffer_);
   ASSERT(model_ != NULL);
   update_bmodel();
+  bmodel_pointer_ = mmap_addr_;
 }
 
 ModelCtx::ModelCtx(const void *bmodel_data, size_t size)
-    : model_gen_(NULL), model_(NULL), model_buffer_(NULL), bmodel_pointer_(NULL)
+    : model_gen_(NULL), model_(NULL), model_buffer_(NULL), mmap_addr_(NULL), mmap_size_(0),
+      bmodel_pointer_(NULL)
 {
   ASSERT(bmodel_data != NULL);
   if (size <= sizeof(header_)) {
@@ -421,7 +512,9 @@ ModelCtx::~ModelCtx()
   if (model_gen_ != NULL) {
     delete model_gen_;
   }
-  if (model_buffer_ != NULL) {
+  if (mmap_addr_ != NULL) {
+    munmap(mmap_addr_, mmap_size_);
+  } else if (model_buffer_ != NULL) {
     free(model_buffer_);
   }
 }
@@ -447,12 +540,14 @@ void ModelCtx::read_binary(const Binary *binary, uint32_t offset, uint8_t *buffe
   ASSERT(binary != NULL);
   ASSERT(buffer != NULL);
   ASSERT(size + offset <= binary->size());
-  if (bmodel_pointer_ == NULL) {  // from file
-    file_.seekg(binary_offset_ + binary->start() + offset, std::ios::beg);
-    file_.read((char *)buffer, size);
-  } else {  // from buffer
-    memcpy(buffer, (uint8_t *)bmodel_pointer_ + binary_offset_ + binary->start() + offset, size);
-  }
+  memcpy(buffer, binary_data(binary) + offset, size);
+}
+
+const uint8_t *ModelCtx::binary_data(const Binary *binary) const
+{
+  ASSERT(binary != NULL);
+  ASSERT(binary->start() + binary->size() <= header_.binary_size);
+  return (const uint8_t *)bmodel_pointer_ + binary_offset_ + binary->start();
 }
 
 template <typename T>
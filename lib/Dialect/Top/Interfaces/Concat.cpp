@@ -20,9 +20,25 @@ int64_t top::ConcatOp::getFLOPs() { return 0; }
 
 LogicalResult top::ConcatOp::init(InferenceParameter &p) {
   auto concat = new Concat();
+  concat_attr_t attr;
+  auto axis_ = axis();
+  auto in_shape = Module::getShape(inputs()[0]);
+  attr.outer_dim = 1;
+  for (int i = 0; i < axis_; i++) {
+    attr.outer_dim *= in_shape[i];
+  }
+  attr.inner_dim = 1;
+  for (int i = axis_ + 1; i < in_shape.size(); i++) {
+    attr.inner_dim *= in_shape[i];
+  }
+  for (auto in : inputs()) {
+    attr.axis_dims.push_back(Module::getShape(in)[axis_]);
+  }
+  concat->setup(p.inputs, p.outputs[0], attr);
   p.handle = (void *)concat;
   return success();
 }
+
 void top::ConcatOp::deinit(InferenceParameter &p) {
   if (p.handle != nullptr) {
     auto concat = (Concat *)(p.handle);
@@ -32,26 +48,7 @@ void top::ConcatOp::deinit(InferenceParameter &p) {
 }
 
 LogicalResult top::ConcatOp::inference(InferenceParameter &p) {
-  auto axis_ = axis();
-  auto input_shape = inputs()[0].getType().cast<RankedTensorType>().getShape();
-  concat_attr_t attr;
-  int channel = input_shape[axis_];
-
-  int outer_dim = 1;
-  for (int i = 0; i < axis_; i++) {
-    outer_dim *= input_shape[i];
-  }
-  int inner_dim = 1;
-  for (int i = axis_ + 1; i < input_shape.size(); i++) {
-    inner_dim *= input_shape[i];
-  }
-
-  attr.src_shape = {outer_dim, channel, inner_dim};
-  attr.dst_shape = attr.src_shape;
-  attr.axis = axis_;
-
   auto concat = (Concat *)p.handle;
-  concat->setup(p.inputs, p.outputs[0], attr);
   concat->run();
   return success();
 }
@@ -37,18 +37,8 @@ LogicalResult top::GatherOp::inference(InferenceParameter &p) {
     inner_dims *= input_shape[i];
   }
 
-  auto num_elems = Module::getNumElements(output());
-#pragma omp parallel for schedule(static, omp_schedule(num_elems))
-  for (int64_t i = 0; i < outer_dims; ++i) {
-    for (int64_t j = 0; j < num_indices; ++j) {
-      for (int64_t k = 0; k < inner_dims; ++k) {
-        int64_t src_idx = (i * input_shape[ax] + inds[j]) * inner_dims + k;
-        int64_t dst_idx = (i * num_indices + j) * inner_dims + k;
-        dst[dst_idx] = src[src_idx];
-      }
-    }
-  }
-
+  gather_inner(dst, src, inds, num_indices, outer_dims, input_shape[ax],
+               inner_dims);
 
   return success();
 }
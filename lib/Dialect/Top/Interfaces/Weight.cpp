@@ -46,16 +46,12 @@ std::shared_ptr<std::vector<float>> WeightOp::read_as_float() {
   } else if (dtype.isF16()) {
     auto data_u16 = read<uint16_t>();
     auto data_f32 = std::make_shared<std::vector<float>>(data_u16->size());
-    for (uint64_t i = 0; i < data_u16->size(); i++) {
-      data_f32->data()[i] = f16_to_f32(data_u16->data()[i]);
-    }
+    f16_to_f32(data_u16->data(), data_f32->data(), data_u16->size());
     return data_f32;
   } else if (dtype.isBF16()) {
     auto data_u16 = read<uint16_t>();
     auto data_f32 = std::make_shared<std::vector<float>>(data_u16->size());
-    for (uint64_t i = 0; i < data_u16->size(); i++) {
-      data_f32->data()[i] = bf16_to_f32(data_u16->data()[i]);
-    }
+    bf16_to_f32(data_u16->data(), data_f32->data(), data_u16->size());
     return data_f32;
   } else if (dtype.isUnsignedInteger(16)) {
     auto data_u16 = read<uint16_t>();
@@ -167,10 +163,7 @@ mlir::Value WeightOp::clone_bf16(Operation *OwnerOp) {
   auto data = read<float>();
   auto count = data->size();
   auto data_bf16 = std::make_shared<std::vector<uint16_t>>(count);
-
-  for (uint32_t i = 0; i < count; i++) {
-    data_bf16->at(i) = f32_to_bf16(data->at(i));
-  }
+  f32_to_bf16(data->data(), data_bf16->data(), count);
   auto ctx = OwnerOp->getContext();
   OpBuilder builder(ctx);
   builder.setInsertionPoint(OwnerOp);
@@ -195,9 +188,7 @@ mlir::Value WeightOp::clone_f16(Operation *OwnerOp) {
   auto data = read<float>();
   auto count = data->size();
   auto data_f16 = std::make_shared<std::vector<uint16_t>>(count);
-  for (uint32_t i = 0; i < count; i++) {
-    data_f16->at(i) = f32_to_f16( data->at(i) );
-  }
+  f32_to_f16(data->data(), data_f16->data(), count);
   auto ctx = OwnerOp->getContext();
   OpBuilder builder(ctx);
   builder.setInsertionPoint(OwnerOp);
@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Dialect/Top/Transforms/Passes.h"
+#include "tpu_mlir/Support/Helper/Module.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Debug.h"
+
+#define DEBUG_TYPE "fold-constant"
+
+using namespace llvm;
+using namespace mlir;
+using namespace tpu_mlir::helper;
+namespace tpu_mlir {
+namespace top {
+
+// Ops with only weight inputs, such as Reshape/Permute/Mul/Concat on
+// constants from onnx, are computed here by inference, and replaced by new
+// weights. Ops are visited in order, so a folded op makes its users foldable.
+class FoldConstantPass : public FoldConstantBase<FoldConstantPass> {
+public:
+  FoldConstantPass() {}
+  void runOnOperation() override {
+    auto module = getOperation();
+    int64_t num_folded = 0;
+    for (auto func : module.getOps<FuncOp>()) {
+      for (auto &op : llvm::make_early_inc_range(func.getBody().getOps())) {
+        if (isFoldable(&op) && succeeded(fold(&op))) {
+          num_folded++;
+        }
+      }
+    }
+    if (num_folded > 0) {
+      Module::removeUnusedOp(module);
+    }
+    LLVM_DEBUG(llvm::dbgs() << "fold " << num_folded << " ops\n");
+  }
+
+private:
+  bool isFoldable(Operation *op) {
+    // BatchNorm and Cast have no inference
+    if (isa<top::WeightOp, top::NoneOp, top::InputOp, top::BatchNormOp,
+            top::CastOp>(op) ||
+        !isa<InferenceInterface>(op) || op->getNumResults() != 1) {
+      return false;
+    }
+    bool has_weight = false;
+    for (auto v : op->getOperands()) {
+      auto in_op = v.getDefiningOp();
+      if (isa_and_nonnull<top::WeightOp>(in_op)) {
+        has_weight = true;
+      } else if (!isa_and_nonnull<top::NoneOp>(in_op)) {
+        return false;
+      }
+    }
+    auto type = op->getResult(0).getType().dyn_cast<RankedTensorType>();
+    if (!has_weight || !type || !type.getElementType().isF32() ||
+        !type.hasStaticShape()) {
+      return false;
+    }
+    return type.getNumElements() <= maxSize;
+  }
+
+  LogicalResult fold(Operation *op) {
+    std::vector<std::shared_ptr<std::vector<float>>> inputs;
+    InferenceParameter p;
+    for (auto v : op->getOperands()) {
+      if (auto weight_op = dyn_cast<top::WeightOp>(v.getDefiningOp())) {
+        inputs.push_back(weight_op.read_as_float());
+        p.inputs.push_back(inputs.back()->data());
+      } else {
+        p.inputs.push_back(nullptr);
+      }
+    }
+    auto type = op->getResult(0).getType().cast<RankedTensorType>();
+    std::vector<float> output(type.getNumElements());
+    p.outputs.push_back(output.data());
+    auto infer_op = cast<InferenceInterface>(op);
+    if (failed(infer_op.init(p))) {
+      return failure();
+    }
+    auto ret = infer_op.inference(p);
+    infer_op.deinit(p);
+    if (failed(ret)) {
+      return failure();
+    }
+    LLVM_DEBUG(llvm::dbgs() << "fold " << Module::getName(op) << "\n");
+    auto weight = WeightOp::create(op, "folded", output, type);
+    op->getResult(0).replaceAllUsesWith(weight);
+    op->erase();
+    return success();
+  }
+};
+
+std::unique_ptr<OperationPass<ModuleOp>> createFoldConstantPass() {
+  return std::make_unique<FoldConstantPass>();
+}
+} // namespace top
+} // namespace tpu_mlir
@@ -13,11 +13,12 @@
 
 #include "mlir/IR/PatternMatch.h"
 #include "mlir/Dialect/Quant/QuantTypes.h"
-#include "llvm/Support/raw_ostream.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Format.h"
-#include <sstream>
-#include <fstream>
-#include <regex>
+#include "llvm/Support/LineIterator.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 using namespace mlir;
@@ -31,6 +32,144 @@ typedef struct {
   double max;
 } cali_info;
 
+// Calibration table, in text or binary format.
+// Text: "# comment" lines, and "op_name threshold min max" lines.
+// Binary: written by CalibrationTable.dump in kld_calibrator.py, little endian
+//   header: cali_bin_header_t
+//   entries: cali_bin_entry_t[num], chained by next in hash buckets
+//   buckets: uint32_t[bucket_num], first entry of each bucket
+//   strings: names and comments
+//   per channel data: double[3][channels] of threshold/min/max, not used yet
+class CalibrationTable {
+public:
+  void load(StringRef file) {
+    auto buffer_or = MemoryBuffer::getFile(file);
+    if (!buffer_or) {
+      llvm_unreachable("can't open calibration table file!");
+    }
+    buffer = std::move(*buffer_or);
+    auto data = buffer->getBuffer();
+    if (data.startswith(StringRef(BIN_MAGIC, sizeof(BIN_MAGIC)))) {
+      loadBinary();
+    } else {
+      loadText();
+    }
+  }
+
+  const cali_info *find(StringRef name) {
+    if (!is_binary) {
+      auto it = text_map.find(name);
+      return it == text_map.end() ? nullptr : &it->second;
+    }
+    auto data = buffer->getBufferStart();
+    uint32_t idx;
+    memcpy(&idx, data + header.buckets_offset +
+                     (hash(name) & (header.bucket_num - 1)) * sizeof(uint32_t),
+           sizeof(uint32_t));
+    auto size = buffer->getBufferSize();
+    // a valid chain visits each entry at most once
+    for (uint32_t step = 0; idx != END_IDX; step++) {
+      if (idx >= header.num || step >= header.num) {
+        llvm::errs() << "entry index " << idx << " of [" << name << "]";
+        llvm_unreachable("\n  => calibration table entry chain is corrupt\n");
+      }
+      cali_bin_entry_t entry;
+      memcpy(&entry, data + header.entries_offset + idx * sizeof(entry),
+             sizeof(entry));
+      if (entry.name_offset > size ||
+          entry.name_len > size - entry.name_offset) {
+        llvm::errs() << "name offset " << entry.name_offset << " length "
+                     << entry.name_len << " of file size " << size;
+        llvm_unreachable("\n  => calibration table name is out of file\n");
+      }
+      if (StringRef(data + entry.name_offset, entry.name_len) == name) {
+        bin_info = {entry.threshold, entry.min, entry.max};
+        return &bin_info;
+      }
+      idx = entry.next;
+    }
+    return nullptr;
+  }
+
+private:
+  static constexpr char BIN_MAGIC[8] = {'T', 'P', 'U', 'C', 'A', 'L', 'I', 0};
+  static constexpr uint32_t END_IDX = 0xFFFFFFFF;
+
+  typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t num;
+    uint32_t bucket_num; // power of 2
+    uint32_t reserved;
+    uint64_t entries_offset;
+    uint64_t buckets_offset;
+    uint64_t strings_offset;
+    uint64_t comment_offset;
+    uint64_t comment_len;
+  } cali_bin_header_t;
+
+  typedef struct {
+    uint64_t name_offset;
+    uint32_t name_len;
+    uint32_t channels;
+    double threshold;
+    double min;
+    double max;
+    uint64_t channel_offset;
+    uint32_t next;
+    uint32_t reserved;
+  } cali_bin_entry_t;
+
+  // FNV-1a
+  static uint64_t hash(StringRef name) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (auto c : name) {
+      h ^= (uint8_t)c;
+      h *= 0x100000001b3ULL;
+    }
+    return h;
+  }
+
+  void loadBinary() {
+    auto size = buffer->getBufferSize();
+    if (size < sizeof(header)) {
+      llvm_unreachable("calibration table is truncated");
+    }
+    memcpy(&header, buffer->getBufferStart(), sizeof(header));
+    if (header.version != 1 || header.bucket_num == 0 ||
+        (header.bucket_num & (header.bucket_num - 1)) != 0 ||
+        header.entries_offset > size ||
+        header.num >
+            (size - header.entries_offset) / sizeof(cali_bin_entry_t) ||
+        header.buckets_offset > size ||
+        header.bucket_num > (size - header.buckets_offset) / sizeof(uint32_t)) {
+      llvm_unreachable("calibration table binary format error");
+    }
+    is_binary = true;
+  }
+
+  void loadText() {
+    for (line_iterator it(*buffer, true, '#'); !it.is_at_end(); ++it) {
+      SmallVector<StringRef, 4> fields;
+      SplitString(*it, fields);
+      cali_info info = {0, 0, 0};
+      if (fields.size() != 4 || fields[1].getAsDouble(info.threshold) ||
+          fields[2].getAsDouble(info.min) || fields[3].getAsDouble(info.max)) {
+        // Format of threshold table error
+        llvm::errs() << *it;
+        llvm_unreachable("\n  => not match required format\n");
+      }
+      text_map[fields[0]] = info;
+    }
+  }
+
+  std::unique_ptr<MemoryBuffer> buffer;
+  bool is_binary = false;
+  cali_bin_header_t header;
+  cali_info bin_info;
+  StringMap<cali_info> text_map;
+};
+
 class ImportCalibrationTablePass
     : public ImportCalibrationTableBase<ImportCalibrationTablePass> {
 public:
@@ -43,33 +182,8 @@ public:
       module.dump();
       llvm_unreachable("wrong mlir state");
     }
-    std::map<std::string, cali_info> calibration_map;
-    std::ifstream infile(this->tableFile);
-    if (!infile) {
-      llvm_unreachable("can't open calibration table file!");
-    }
-    std::string line;
-    std::regex cali_pattern("\\S+\\s+[-0-9.e]+\\s+[-0-9.e]+\\s+[-0-9.e]+");
-    std::regex info_pattern("#.*");
-    while (std::getline(infile, line)) {
-      if (line.back() == '\r') {
-        line.pop_back();
-      }
-      std::istringstream iss(line);
-      std::string name;
-      if (std::regex_match(line, cali_pattern)) {
-        cali_info info = {0, 0, 0};
-        if (!(iss >> name >> info.threshold >> info.min >> info.max)) {
-          break;
-        }
-        calibration_map[name] = info;
-      } else if (std::regex_match(line, info_pattern)) {
-      } else {
-        // Format of threshold table error
-        llvm::errs() << line;
-        llvm_unreachable("\n  => not match required format\n");
-      }
-    }
+    CalibrationTable calibration_table;
+    calibration_table.load(this->tableFile);
     double min, max;
     for (auto func : module.getOps<FuncOp>()) {
       func.walk([&](Operation *op) {
@@ -79,14 +193,14 @@ public:
             if (type.getElementType().isIntOrIndex()) {
               continue;
             }
-            auto name = Module::getName(value).str();
-            if (calibration_map.find(name) == calibration_map.end()) {
+            auto name = Module::getName(value);
+            auto info = calibration_table.find(name);
+            if (info == nullptr) {
               llvm::errs() << "[" << name << "] not in " << this->tableFile
                            << "!!\n";
               llvm_unreachable("Import Calibration failed!!\n");
             }
-            auto &info = calibration_map[name];
-            getMinMax(op, info, min, max);
+            getMinMax(op, *info, min, max);
             auto quant_type = quant::CalibratedQuantizedType::get(
                 type.getElementType(), min, max);
             auto new_type = RankedTensorType::get(type.getShape(), quant_type);
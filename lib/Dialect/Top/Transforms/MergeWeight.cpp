@@ -0,0 +1,80 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Dialect/Top/Transforms/Passes.h"
+#include "tpu_mlir/Support/Helper/Module.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Support/Debug.h"
+
+#include <map>
+
+#define DEBUG_TYPE "merge-weight"
+
+using namespace llvm;
+using namespace mlir;
+using namespace tpu_mlir::helper;
+namespace tpu_mlir {
+namespace top {
+
+// Weights with the same type and data, such as tied embeddings, zero biases
+// and lut tables of each layer, are merged into one weight: they take the
+// name of the first one, so that they keep one tensor in npz and one address
+// in coeff. Each weight op keeps its only user, as layer-group and weight
+// compression expect. Merged weights record the hash of type and data, so
+// that different weights with a conflicting name are still found later.
+// Weight reorder changes weight type in place, so run it after weight-reorder.
+class MergeWeightPass : public MergeWeightBase<MergeWeightPass> {
+public:
+  MergeWeightPass() {}
+  void runOnOperation() override {
+    auto module = getOperation();
+    auto builder = OpBuilder(module.getContext());
+    int64_t num_merged = 0;
+    // hash => weights with different data, data is read again to compare,
+    // so that only one weight data is kept in memory
+    std::map<size_t, std::vector<WeightOp>> all_weights;
+    for (auto func : module.getOps<FuncOp>()) {
+      auto &block = func.getBody().front();
+      for (auto op : block.getOps<WeightOp>()) {
+        auto data = op.read_as_byte();
+        auto type = op.output().getType();
+        auto hash = hash_combine(type.getAsOpaquePointer(),
+                                 hash_value(ArrayRef<uint8_t>(*data)));
+        auto &weights = all_weights[hash];
+        auto iter =
+            std::find_if(weights.begin(), weights.end(), [&](WeightOp &w) {
+              return w.output().getType() == type &&
+                     *w.read_as_byte() == *data;
+            });
+        if (iter == weights.end()) {
+          weights.push_back(op);
+          continue;
+        }
+        auto same_op = *iter;
+        auto name = Module::getName(same_op.getOperation());
+        LLVM_DEBUG(llvm::dbgs()
+                   << "merge " << Module::getName(op.getOperation())
+                   << " into " << name << "\n");
+        num_merged++;
+        auto hash_attr = builder.getI64IntegerAttr((int64_t)hash);
+        same_op->setAttr(Module::Attr::MERGED_HASH, hash_attr);
+        op->setAttr(Module::Attr::MERGED_HASH, hash_attr);
+        op->setLoc(NameLoc::get(builder.getStringAttr(name)));
+      }
+    }
+    LLVM_DEBUG(llvm::dbgs() << "merge " << num_merged << " weights\n");
+  }
+};
+
+std::unique_ptr<OperationPass<ModuleOp>> createMergeWeightPass() {
+  return std::make_unique<MergeWeightPass>();
+}
+} // namespace top
+} // namespace tpu_mlir
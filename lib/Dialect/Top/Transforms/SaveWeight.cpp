@@ -14,6 +14,7 @@
 #include "mlir/IR/PatternMatch.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 
+#include <map>
 #include <set>
 
 using namespace llvm;
@@ -30,6 +31,7 @@ public:
     Module::removeUnusedOp(module);
     // check name conflict
     std::set<StringRef> all_names;
+    std::map<StringRef, top::WeightOp> all_weights;
     for (auto func : module.getOps<FuncOp>()) {
       func.walk([&](Operation *op) {
         if (op->getLoc().dyn_cast<NameLoc>()  && !Module::isOpInGroup(op)) {
@@ -37,11 +39,20 @@ public:
             op->erase();
           } else {
             auto name = Module::getName(op);
+            auto weight = dyn_cast<top::WeightOp>(op);
+            // weights merged by merge-weight share the name
+            if (weight && all_weights.count(name) &&
+                Module::isMergedWeight(all_weights[name], weight)) {
+              return;
+            }
             if (all_names.find(name) != all_names.end()) {
               op->dump();
               llvm_unreachable("op name conflict");
             }
             all_names.insert(name);
+            if (weight) {
+              all_weights[name] = weight;
+            }
           }
         }
       });
@@ -13,6 +13,7 @@
 #include "tpu_mlir/Support/Helper/Module.h"
 #include "tpu_mlir/Support/Helper/Quant.h"
 #include "tpu_mlir/Support/MathUtils.h"
+#include "tpu_mlir/Support/Permute.h"
 
 using namespace mlir;
 using namespace tpu_mlir;
@@ -26,32 +27,27 @@ using namespace tpu_mlir::backend;
 template <typename T>
 static void filter_reorder(std::shared_ptr<std::vector<T>> &filter,
                            std::vector<int64_t> &shape) {
-  int32_t oc = shape[0];
-  int32_t ic = shape[1];
-  int32_t kd = shape[2];
-  int32_t kh = shape[3];
-  int32_t kw = shape[4];
+  int64_t oc = shape[0];
+  int64_t ic = shape[1];
+  int64_t kd = shape[2];
+  int64_t kh = shape[3];
+  int64_t kw = shape[4];
   auto type_bytes = sizeof(T);
-  int32_t IC_PARALLEL = 64 / type_bytes;
+  int64_t IC_PARALLEL = 64 / type_bytes;
   auto kernel_hw = kh * kw;
-  int32_t new_ic = ceiling_func(ic * kd, IC_PARALLEL);
-  int32_t new_hw = kernel_hw * IC_PARALLEL;
-  auto filter_new = std::make_shared<std::vector<T>>(oc * new_ic * new_hw, 0);
-  for (int oc_idx = 0; oc_idx < oc; oc_idx++) {
-    for (int ic_idx = 0; ic_idx < new_ic; ic_idx++) {
-      for (int k_idx = 0; k_idx < kernel_hw; k_idx++) {
-        for (int inner = 0; inner < IC_PARALLEL; inner++) {
-          if (ic_idx * IC_PARALLEL + inner >= ic * kd)
-            break;
-          int orig_offset = oc_idx * ic * kd * kh * kw +
-                            (ic_idx * IC_PARALLEL + inner) * kernel_hw + k_idx;
-          int trans_offset = oc_idx * new_ic * new_hw + ic_idx * new_hw +
-                             k_idx * IC_PARALLEL + inner;
-          filter_new->at(trans_offset) = filter->at(orig_offset);
-        }
-      }
-    }
+  int64_t new_ic = ceiling_func(ic * kd, IC_PARALLEL);
+  int64_t new_hw = kernel_hw * IC_PARALLEL;
+  // pad ic * kd to new_ic * IC_PARALLEL, then
+  // (oc, new_ic, IC_PARALLEL, kernel_hw) to (oc, new_ic, kernel_hw, IC_PARALLEL)
+  auto filter_pad = std::make_shared<std::vector<T>>(oc * new_ic * new_hw, 0);
+  for (int64_t oc_idx = 0; oc_idx < oc; oc_idx++) {
+    std::copy_n(filter->data() + oc_idx * ic * kd * kernel_hw,
+                ic * kd * kernel_hw,
+                filter_pad->data() + oc_idx * new_ic * new_hw);
   }
+  auto filter_new = std::make_shared<std::vector<T>>(oc * new_ic * new_hw);
+  permute(filter_new->data(), filter_pad->data(),
+          {oc, new_ic, IC_PARALLEL, kernel_hw}, {0, 1, 3, 2});
   filter = filter_new;
   shape = {1, oc, new_ic, kh * kw, IC_PARALLEL};
 }
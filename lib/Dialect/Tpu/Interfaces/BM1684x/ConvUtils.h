@@ -10,6 +10,7 @@
 #include "tpu_mlir/Backend/BM168x/BM1684x.h"
 #include "tpu_mlir/Support/Helper/Module.h"
 #include "tpu_mlir/Support/MathUtils.h"
+#include "tpu_mlir/Support/Permute.h"
 
 using namespace tpu_mlir::backend;
 using namespace tpu_mlir::helper;
@@ -36,16 +37,12 @@ reshape_coeff_for_broadcast_channel(std::shared_ptr<std::vector<T>> &coeff,
   auto c2w = ceiling_func(c, new_c);
   int64_t new_w = (align ? old_w_align : w) * (c2w - 1) + w;
   auto coeff_new = std::make_shared<std::vector<T>>(new_w * new_c, 0);
-  for (uint i = 0; i < c2w; i++) {
-    for (uint j = 0; j < new_c; j++) {
-      if (i * new_c + j >= c) {
-        break;
-      }
-      for (uint k = 0; k < w; k++) {
-        uint src_idx = (i * new_c + j) * w + k;
-        uint dst_idx = j * new_w + i * (align ? old_w_align : w) + k;
-        coeff_new->at(dst_idx) = coeff->at(src_idx);
-      }
+  int64_t w_stride = align ? old_w_align : w;
+  // the innermost w is not moved, copy it by rows
+  for (int64_t i = 0; i < c2w; i++) {
+    for (int64_t j = 0; j < new_c && i * new_c + j < c; j++) {
+      std::copy_n(coeff->data() + (i * new_c + j) * w, w,
+                  coeff_new->data() + j * new_w + i * w_stride);
     }
   }
   assert(shape.size() > 2);
@@ -65,22 +62,16 @@ static void filter_reorder(std::shared_ptr<std::vector<T>> &filter,
   auto kernel_hw = kh * kw;
   int64_t new_ic = ceiling_func(ic, IC_PARALLEL);
   int64_t new_hw = kernel_hw * IC_PARALLEL;
-  auto filter_new = std::make_shared<std::vector<T>>(oc * new_ic * new_hw, 0);
-  for (int oc_idx = 0; oc_idx < oc; oc_idx++) {
-    for (int ic_idx = 0; ic_idx < new_ic; ic_idx++) {
-      for (int k_idx = 0; k_idx < kernel_hw; k_idx++) {
-        for (int inner = 0; inner < IC_PARALLEL; inner++) {
-          if (ic_idx * IC_PARALLEL + inner >= ic)
-            break;
-          int orig_offset = oc_idx * ic * kh * kw +
-                            (ic_idx * IC_PARALLEL + inner) * kernel_hw + k_idx;
-          int trans_offset = oc_idx * new_ic * new_hw + ic_idx * new_hw +
-                             k_idx * IC_PARALLEL + inner;
-          filter_new->at(trans_offset) = filter->at(orig_offset);
-        }
-      }
-    }
+  // pad ic to new_ic * IC_PARALLEL, then (oc, new_ic, IC_PARALLEL, kernel_hw)
+  // to (oc, new_ic, kernel_hw, IC_PARALLEL)
+  auto filter_pad = std::make_shared<std::vector<T>>(oc * new_ic * new_hw, 0);
+  for (int64_t oc_idx = 0; oc_idx < oc; oc_idx++) {
+    std::copy_n(filter->data() + oc_idx * ic * kernel_hw, ic * kernel_hw,
+                filter_pad->data() + oc_idx * new_ic * new_hw);
   }
+  auto filter_new = std::make_shared<std::vector<T>>(oc * new_ic * new_hw);
+  permute(filter_new->data(), filter_pad->data(),
+          {oc, new_ic, IC_PARALLEL, kernel_hw}, {0, 1, 3, 2});
   filter = filter_new;
   assert(shape.size() > 2);
   shape.assign(shape.size(), 1);
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Dialect/Tpu/IR/TpuOps.h"
+#include "tpu_mlir/Support/Dnnl/Concat.h"
 #include "tpu_mlir/Support/Dnnl/Dnnl.h"
 #include "tpu_mlir/Support/Helper/Module.h"
 #include "tpu_mlir/Support/Helper/Quant.h"
@@ -17,30 +18,38 @@ using namespace tpu_mlir;
 using namespace tpu_mlir::helper;
 using namespace mlir;
 
-LogicalResult tpu::ConcatOp::init(InferenceParameter &p) { return success(); }
-void tpu::ConcatOp::deinit(InferenceParameter &p) {}
-
-LogicalResult tpu::ConcatOp::inference(InferenceParameter &p) {
+LogicalResult tpu::ConcatOp::init(InferenceParameter &p) {
+  auto concat = new Concat();
+  concat_attr_t attr;
   auto axis_ = axis();
-  auto op0_shape = inputs()[0].getType().cast<RankedTensorType>().getShape();
-
-  int64_t high = 1;
-  for (int64_t i = 0; i < axis_; ++i)
-    high *= op0_shape[i];
-
-  SmallVector<int64_t> tailNum(inputs().size());
-  for (auto idt : llvm::enumerate(inputs())) {
-    tailNum[idt.index()] =
-        idt.value().getType().cast<RankedTensorType>().getNumElements() / high;
+  auto in_shape = Module::getShape(inputs()[0]);
+  attr.outer_dim = 1;
+  for (int i = 0; i < axis_; i++) {
+    attr.outer_dim *= in_shape[i];
+  }
+  attr.inner_dim = 1;
+  for (int i = axis_ + 1; i < in_shape.size(); i++) {
+    attr.inner_dim *= in_shape[i];
+  }
+  for (auto in : inputs()) {
+    attr.axis_dims.push_back(Module::getShape(in)[axis_]);
   }
-  auto out_p = p.outputs[0];
-  for (int64_t i = 0; i < high; ++i) {
-    for (auto idt : llvm::enumerate(tailNum)) {
-      memcpy(out_p, p.inputs[idt.index()] + i * idt.value(),
-             idt.value() * sizeof(float));
-      out_p += idt.value();
-    }
+  concat->setup(p.inputs, p.outputs[0], attr);
+  p.handle = (void *)concat;
+  return success();
+}
+
+void tpu::ConcatOp::deinit(InferenceParameter &p) {
+  if (p.handle != nullptr) {
+    auto concat = (Concat *)(p.handle);
+    delete concat;
+    p.handle = nullptr;
   }
+}
+
+LogicalResult tpu::ConcatOp::inference(InferenceParameter &p) {
+  auto concat = (Concat *)p.handle;
+  concat->run();
   return success();
 }
 
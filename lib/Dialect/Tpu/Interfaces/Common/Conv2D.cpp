@@ -64,7 +64,15 @@ LogicalResult tpu::Conv2DOp::init(InferenceParameter &p) {
   conv_attr_t attr = {0};
   parseParam(&attr);
 
-  conv->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], attr);
+  // int8 in and out, keep int8 in oneDNN and requant s32 accumulators
+  auto in_type = Module::getStorageType(input());
+  bool int8 = Quant::isUniformQuantized(input()) && in_type.isInteger(8) &&
+              Module::getStorageType(filter()).isInteger(8) &&
+              Quant::isUniformQuantized(output());
+  if (!int8 || !conv->setup_int8(p.inputs[0], p.inputs[1], attr,
+                                 in_type.isUnsignedInteger(8))) {
+    conv->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], attr);
+  }
   p.handle = (void *)conv;
   return success();
 }
@@ -102,6 +110,10 @@ LogicalResult tpu::Conv2DOp::inference(InferenceParameter &p) {
     auto rshift_v = Module::getI64Array(rshift().value());
     auto multiplier_v = Module::getI64Array(multiplier(), rshift_v->size(), 1);
     bool per_axis = rshift_v->size() == c;
+    auto acc = conv->int8_output();
+    auto bias = with_bias() ? p.inputs[2] : nullptr;
+    bool relu = do_relu();
+    double limit = relu_limit().convertToDouble();
     auto mode = quant_mode();
     MultiplierType m_type;
     if (is_cv18xx) {
@@ -122,9 +134,12 @@ LogicalResult tpu::Conv2DOp::inference(InferenceParameter &p) {
       for (int in = 0; in < n; in++) {
         for (int hw = 0; hw < h * w; hw++) {
           int offset = (in * c + ic) * h * w + hw;
-          int64_t v = 0;
-          v = applyMultiplierAndRShift(p.outputs[0][offset], multi, shift,
-                                       m_type) +
+          int64_t v = acc == nullptr
+                          ? (int64_t)p.outputs[0][offset]
+                          : int8_epilogue(acc[offset],
+                                          bias == nullptr ? 0 : bias[ic], relu,
+                                          limit);
+          v = applyMultiplierAndRShift(v, multi, shift, m_type) +
               o_qtype.getZeroPoint();
           p.outputs[0][offset] = sType.isUnsignedInteger(8) ? Quant::to_uint8(v)
                                                             : Quant::to_int8(v);
@@ -59,8 +59,22 @@ LogicalResult tpu::MatMulOp::init(InferenceParameter &p) {
   double limit;
   parseParam(batch, M, K, N, with_bias, relu, limit, zp);
 
-  matmul->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], batch, M,
-                K, N, relu, limit, zp);
+  // int8 in and out, keep int8 in oneDNN and requant s32 accumulators
+  auto in_type = Module::getStorageType(input());
+  auto right_type = Module::getStorageType(right());
+  bool right_is_const =
+      isa_and_nonnull<top::WeightOp>(right().getDefiningOp());
+  bool int8 = Quant::isUniformQuantized(input()) && in_type.isInteger(8) &&
+              Quant::isUniformQuantized(output()) &&
+              (right_is_const ? right_type.isInteger(8)
+                              : right_type.isSignedInteger(8) ||
+                                    right_type.isSignlessInteger(8));
+  if (!int8 ||
+      !matmul->setup_int8(p.inputs[0], p.inputs[1], right_is_const, batch, M,
+                          K, N, zp, in_type.isUnsignedInteger(8))) {
+    matmul->setup(p.inputs[0], p.inputs[1], p.inputs[2], p.outputs[0], batch,
+                  M, K, N, relu, limit, zp);
+  }
   p.handle = (void *)matmul;
   return success();
 }
@@ -93,13 +107,26 @@ LogicalResult tpu::MatMulOp::inference(InferenceParameter &p) {
     auto rft = rshift();
     auto mlti = multiplier();
     auto num_output = Module::getNumElements(output());
+    auto acc = matmul->int8_output();
+    int64_t batch, M, K, N, zp;
+    bool relu, with_bias;
+    double limit;
+    parseParam(batch, M, K, N, with_bias, relu, limit, zp);
+    auto bias = with_bias ? p.inputs[2] : nullptr;
+    auto value = [&](int64_t i) -> int64_t {
+      if (acc == nullptr) {
+        return (int64_t)p.outputs[0][i];
+      }
+      return int8_epilogue(acc[i], bias == nullptr ? 0 : bias[i % N], relu,
+                           limit);
+    };
     if (quant_mode() == tpu::RequantMode::TFlite_Lshift ||
         quant_mode() == tpu::RequantMode::TFlite) {
 #pragma omp parallel for schedule(static, omp_schedule(num_output))
       for (int64_t i = 0; i < num_output; i++) {
         // auto v = (((int64_t)(p.outputs[0][i] * mlti) + (1 << (rft - 1))) >> rft);
         auto v = MultiplyByQuantizedMultiplier(
-                                (int32_t)(p.outputs[0][i]),
+                                (int32_t)value(i),
                                 (int32_t)mlti, -(int32_t)rft);
         if (out_type.isUnsignedInteger(8)) {
           p.outputs[0][i] = Quant::to_uint8(v + o_qtype.getZeroPoint());
@@ -110,7 +137,7 @@ LogicalResult tpu::MatMulOp::inference(InferenceParameter &p) {
     } else if (quant_mode() == tpu::RequantMode::Normal) {
 #pragma omp parallel for schedule(static, omp_schedule(num_output))
       for (int i = 0; i < num_output; ++i) {
-        auto v = applyMultiplierAndRShift(p.outputs[0][i], mlti, rft);
+        auto v = applyMultiplierAndRShift(value(i), mlti, rft);
         if (out_type.isUnsignedInteger(8)) {
           p.outputs[0][i] = Quant::to_uint8(v + o_qtype.getZeroPoint());
         } else {
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Dialect/Tpu/IR/TpuOps.h"
+#include "tpu_mlir/Support/ActiveLut.h"
 #include "tpu_mlir/Support/Dnnl/Dnnl.h"
 #include "tpu_mlir/Support/Helper/Quant.h"
 #include "tpu_mlir/Support/Helper/Module.h"
@@ -17,15 +18,33 @@ using namespace tpu_mlir;
 using namespace tpu_mlir::helper;
 using namespace mlir;
 
-LogicalResult tpu::SigmoidOp::init(InferenceParameter &p) { return success(); }
-void tpu::SigmoidOp::deinit(InferenceParameter &p) {}
+static float active_sigmoid(float val) { return 1 / (1 + std::exp(-val)); }
+
+LogicalResult tpu::SigmoidOp::init(InferenceParameter &p) {
+  // f16/bf16 output is looked up in a table of all inputs
+  auto out_type = Module::getStorageType(output());
+  if (out_type.isBF16() || out_type.isF16()) {
+    p.handle = (void *)get_active_lut(active_sigmoid, out_type.isBF16());
+  }
+  return success();
+}
+
+void tpu::SigmoidOp::deinit(InferenceParameter &p) {
+  // the table is shared, not owned
+  p.handle = nullptr;
+}
 
 LogicalResult tpu::SigmoidOp::inference(InferenceParameter &p) {
   auto num_element = Module::getNumElements(input());
+  if (p.handle != nullptr) {
+    auto out_type = Module::getStorageType(output());
+    active_by_lut(p.inputs[0], p.outputs[0], num_element,
+                  (const float *)p.handle, active_sigmoid, out_type.isBF16());
+    return success();
+  }
 #pragma omp parallel for schedule(static, omp_schedule(num_element))
   for (int i = 0; i < num_element; ++i) {
-    auto val = p.inputs[0][i];
-    p.outputs[0][i] = 1 / (1 + std::exp(-val));
+    p.outputs[0][i] = active_sigmoid(p.inputs[0][i]);
   }
   return success();
 }
@@ -23,22 +23,9 @@ void tpu::UpsampleOp::deinit(InferenceParameter &p) {}
 LogicalResult tpu::UpsampleOp::inference(InferenceParameter &p) {
   int64_t n, c, ih, iw;
   Module::getNCHW(input(), n, c, ih, iw);
-  int64_t oh = ih * scale_h();
-  int64_t ow = iw * scale_w();
   auto num_elem = Module::getNumElements(output());
-#pragma omp parallel for schedule(static, omp_schedule(num_elem))
-  for (int64_t d0 = 0; d0 < n; d0++) {
-    for (int64_t d1 = 0; d1 < c; d1++) {
-      for (int64_t d2 = 0; d2 < oh; d2++) {
-        for (int64_t d3 = 0; d3 < ow; d3++) {
-          int64_t idx_o = (((d0 * c + d1) * oh) + d2) * ow + d3;
-          int64_t idx_i =
-              ((((d0 * c + d1) * ih) + d2 / scale_h())) * iw + (d3 / scale_w());
-          p.outputs[0][idx_o] = p.inputs[0][idx_i];
-        }
-      }
-    }
-  }
+  upsample_nearest(p.outputs[0], p.inputs[0], n * c, ih, iw, scale_h(),
+                   scale_w());
 
   if (do_relu()) {
     auto limit = relu_limit().convertToDouble();
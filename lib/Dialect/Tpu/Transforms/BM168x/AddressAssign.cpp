@@ -23,6 +23,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <map>
 #include <set>
 #include <tuple>
 #include <vector>
@@ -61,8 +62,22 @@ public:
     Builder builder(module.getContext());
     // assign weight first
     auto addr = start_addr;
+    // weights with the same name are merged, and share one address
+    std::map<StringRef, top::WeightOp> weight_addrs;
     for (auto func : module.getOps<FuncOp>()) {
       func.walk([&](top::WeightOp op) {
+        auto name = Module::getName(op.getOperation());
+        auto iter = weight_addrs.find(name);
+        if (iter != weight_addrs.end()) {
+          if (!Module::isMergedWeight(iter->second, op)) {
+            op.dump();
+            llvm_unreachable("weight name conflict");
+          }
+          Module::setAddress(op.output(),
+                             Module::getAddress(iter->second.output()));
+          return;
+        }
+        weight_addrs[name] = op;
         Module::setAddress(op.output(), addr);
         int64_t bytes = Module::getBytes(op.output());
         addr = align_up(addr + bytes, alignment);
@@ -17,6 +17,7 @@
 #include "tpu_mlir/Support/Helper/Module.h"
 #include "tpu_mlir/Support/Helper/Quant.h"
 #include "tpu_mlir/Support/MathUtils.h"
+#include "tpu_mlir/Support/TPUCompressUtil.h"
 
 #include "mlir/Dialect/Quant/QuantTypes.h"
 #include "mlir/IR/BlockAndValueMapping.h"
@@ -53,11 +54,15 @@ public:
     bm168x->init();
 
     std::vector<top::WeightOp> weights;
+    // weights with the same name share one address, store only once
+    std::set<StringRef> weight_names;
     for (auto func : module.getOps<FuncOp>()) {
       func.walk([&](top::WeightOp op) {
         // TODO: store all weight to gmem for compare
         // bm168x->value_s2d(op.output(), op.read_as_byte()->data());
-        weights.push_back(op);
+        if (weight_names.insert(Module::getName(op.getOperation())).second) {
+          weights.push_back(op);
+        }
       });
     }
     std::vector<Value> inputs;
@@ -118,6 +123,7 @@ private:
                                           uint64_t coeff_size);
   void codegen(Operation *op);
   void codegen_for_group(tpu::GroupOp gOP);
+  void report_compress(std::vector<top::WeightOp> &coeffs);
 
 private:
   ModuleOp module;
@@ -204,6 +210,9 @@ CodegenPass::CreateCoeffMem(std::vector<top::WeightOp> &coeffs,
     offset += align_up((int64_t)data->size(), BM168x::ALIGNMENT);
   }
   assert(offset == coeff_size);
+  if (compress_report) {
+    report_compress(coeffs);
+  }
   std::vector<uint8_t> sha256(bmodel::SHA256_LEN, 0);
   bmodel::CalcSha256(data_u8->data(), coeff_size, sha256.data());
   auto binary_coeff = model_gen->WriteBinary(coeff_size, data_u8->data());
@@ -215,6 +224,52 @@ CodegenPass::CreateCoeffMem(std::vector<top::WeightOp> &coeffs,
   return cmb.Finish();
 }
 
+// Compress int8 conv/matmul weights with the block format of CV18xx, and
+// report the size of each layer. Weights in bmodel are not changed, as
+// BM168x backend has no decompression when loading coeff to local memory.
+void CodegenPass::report_compress(std::vector<top::WeightOp> &coeffs) {
+  uint64_t total_size = 0, total_compressed = 0;
+  llvm::errs() << "weight compress report:\n";
+  for (auto weight : coeffs) {
+    auto v = weight.output();
+    if (!v.hasOneUse()) {
+      continue;
+    }
+    auto user = *v.getUsers().begin();
+    if (!isa<tpu::Conv2DOp, tpu::MatMulOp>(user) || user->getOperand(1) != v) {
+      continue;
+    }
+    auto stype = Module::getStorageType(v);
+    if (!stype.isInteger(8)) {
+      continue;
+    }
+    auto data = weight.read_as_byte();
+    int size = data->size();
+    int64_t zeros = std::count(data->begin(), data->end(), 0);
+    CompressCommandInfo cmd_info;
+    memset(&cmd_info, 0, sizeof(cmd_info));
+    uint8_t signedness = stype.isUnsignedInteger(8) ? 0 : 1;
+    getCompressParameter(data->data(), size, signedness, 0, &cmd_info);
+    int compressed_size = getCompressedDataSize(size, 0);
+    std::vector<uint8_t> compressed(compressed_size);
+    compressInt8Data(data->data(), size, compressed.data(), &compressed_size,
+                     &cmd_info);
+    total_size += size;
+    total_compressed += std::min(size, compressed_size);
+    llvm::errs() << "  " << Module::getName(user) << " ("
+                 << user->getName().getStringRef() << "): " << size << " => "
+                 << compressed_size << " bytes, ratio "
+                 << format("%.2f", (float)size / compressed_size) << ", zeros "
+                 << format("%.1f%%", 100.0f * zeros / size) << "\n";
+  }
+  if (total_compressed > 0) {
+    llvm::errs() << "  total: " << total_size << " => " << total_compressed
+                 << " bytes, ratio "
+                 << format("%.2f", (float)total_size / total_compressed)
+                 << "\n";
+  }
+}
+
 std::shared_ptr<std::vector<Offset<bmodel::CmdGroup>>>
 CodegenPass::CreateCmdGroupVector() {
   auto cmd_group_v = std::make_shared<std::vector<Offset<bmodel::CmdGroup>>>();
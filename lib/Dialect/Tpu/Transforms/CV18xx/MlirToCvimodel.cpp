@@ -85,12 +85,34 @@ static void buildInputsOutputs(flatbuffers::FlatBufferBuilder &fbb,
   fbOutputs = fbb.CreateVector(fbStrVec);
 }
 
-static void genMD5Hash(std::vector<uint8_t> &totalBin, uint8_t *resData) {
+// Writes cvimodel body and hashes it on the fly; without output stream it only
+// hashes
+class CviModelWriter {
+public:
+  CviModelWriter(llvm::raw_ostream *os) : os(os) { MD5_Init(&ctx); }
+
+  void write(const void *data, size_t size) {
+    MD5_Update(&ctx, data, size);
+    if (os) {
+      os->write(reinterpret_cast<const char *>(data), size);
+    }
+  }
+
+  void pad(size_t size) {
+    static const uint8_t zeros[256] = {0};
+    while (size > 0) {
+      auto n = std::min(size, sizeof(zeros));
+      write(zeros, n);
+      size -= n;
+    }
+  }
+
+  void finish(uint8_t *md5) { MD5_Final(md5, &ctx); }
+
+private:
+  llvm::raw_ostream *os;
   MD5_CTX ctx;
-  MD5_Init(&ctx);
-  MD5_Update(&ctx, totalBin.data(), totalBin.size());
-  MD5_Final(resData, &ctx);
-}
+};
 
 static std::string getStrOfCurrentTime() {
   std::stringstream ssTime;
@@ -133,7 +155,9 @@ void CviTpuRoutine::codeGen() {
     // sotre neuron
   }
   cvi_backend_submit(backend_ctx);
-  cvi_backend_get_cmdbuf(backend_ctx, cmdbuf);
+  cmdbuf = cvi_backend_take_cmdbuf(backend_ctx);
+  LLVM_DEBUG(llvm::errs() << "routine " << name << " cmdbuf size "
+                          << cmdbuf->size() << "\n";);
   cvi_backend_delete_context(backend_ctx);
 }
 
@@ -158,9 +182,13 @@ CviModelBuilder::CviModelBuilder(ModuleOp &module) : fbb_(1024) {
     addRoutine(call, &layer_id);
   });
   Module::removeUnusedOp(module);
+  // weights with the same name share one address, store only once
+  std::set<llvm::StringRef> weight_names;
   for (auto func : module.getOps<FuncOp>()) {
     func.walk([&](top::WeightOp op) {
-      weights.push_back(op);
+      if (weight_names.insert(Module::getName(op.getOperation())).second) {
+        weights.push_back(op);
+      }
     });
   }
   Module::getInputsOutputs(module, inputs, outputs);
@@ -183,35 +211,25 @@ void CviModelBuilder::addRoutine(func::CallOp &call, int* layer_id) {
 FBSection CviModelBuilder::buildSection(std::string name,
                                         cvi::model::SectionType type) {
   auto fbName = fbb_.CreateString(name);
-  uint32_t size = 0;
-  uint32_t offset = 0;
-  auto data_u8 = std::make_shared<std::vector<uint8_t>>(coeff_size, 0);
-  for (auto weight : weights) {
-    auto data = weight.read_as_byte();
-    memcpy(data_u8->data() + offset, data->data(), data->size());
-    offset += align_up((int64_t)data->size(), CV18xx::WEIGHT_ALIGNMENT);
-    LLVM_DEBUG(llvm::errs() << "buildSection offset " << offset << "\n";);
-  }
-  assert(offset == coeff_size);
-  uint32_t bin_offset = (uint32_t)binBuffer_.size();
-  for (uint32_t i = 0; i < coeff_size; i++) {
-    binBuffer_.push_back(data_u8->at(i));
-    LLVM_DEBUG(llvm::errs() << "buildSection " << i << " " << (int)(data_u8->at(i)) << " end \n";);
-  }
+  // weights are read and written one by one in storeModel
+  uint32_t bin_offset = binSize_;
+  binSections_.push_back({nullptr, (uint32_t)coeff_size});
+  binSize_ += coeff_size;
   return CreateSection(fbb_, type, fbName, coeff_size, bin_offset);
 }
 
 FBSection CviModelBuilder::buildSection(std::string name, cvi::model::SectionType type,
-                                        std::vector<uint8_t>& data) {
+                                        const CviCmdBuf &cmdbuf) {
   auto fbName = fbb_.CreateString(name);
   uint32_t size = 0;
   uint32_t offset = 0;
 
-  size = (uint32_t)data.size();
-  offset = (uint32_t)binBuffer_.size();
-  // don't need compress data
-  if (data.size()) {
-    binBuffer_.insert(binBuffer_.end(), data.begin(), data.end());
+  size = (uint32_t)cmdbuf.size();
+  offset = binSize_;
+  // don't need compress data, written from cmdbuf in storeModel
+  if (size) {
+    binSections_.push_back({&cmdbuf, size});
+    binSize_ += size;
   }
   return CreateSection(fbb_, type, fbName, size, offset);
 }
@@ -226,7 +244,7 @@ FBSectionVector CviModelBuilder::buildSections() {
     if (rt->isTpuRoutine) {
       auto tpuRt = (CviTpuRoutine *)rt;
       auto cmdbufSec =
-          buildSection(tpuRt->name, SectionType_CMDBUF, tpuRt->cmdbuf);
+          buildSection(tpuRt->name, SectionType_CMDBUF, *tpuRt->cmdbuf);
       sectionVec.push_back(cmdbufSec);
     }
   }
@@ -423,6 +441,27 @@ FBProgram CviModelBuilder::buildProgram() {
                        (uint32_t)sharedGmemSize_, (uint32_t)privateGmemSize_);
 }
 
+void CviModelBuilder::writeBody(CviModelWriter &writer) {
+  writer.write(fbb_.GetBufferPointer(), fbb_.GetSize());
+  for (auto &sec : binSections_) {
+    if (sec.cmdbuf) {
+      sec.cmdbuf->for_each(
+          [&](const uint8_t *data, size_t size) { writer.write(data, size); });
+      continue;
+    }
+    int64_t offset = 0;
+    for (auto weight : weights) {
+      auto data = weight.read_as_byte();
+      writer.write(data->data(), data->size());
+      auto aligned = align_up((int64_t)data->size(), CV18xx::WEIGHT_ALIGNMENT);
+      writer.pad(aligned - data->size());
+      offset += aligned;
+      LLVM_DEBUG(llvm::errs() << "write weight offset " << offset << "\n";);
+    }
+    assert(offset == sec.size);
+  }
+}
+
 void CviModelBuilder::storeModel(std::string filename) {
   std::string errorMessage;
   auto output = openOutputFile(filename, &errorMessage);
@@ -433,21 +472,7 @@ void CviModelBuilder::storeModel(std::string filename) {
   FBModel fbModel = build(); // build
   fbb_.Finish(fbModel);
 
-  std::vector<uint8_t> modelData;
-  modelData.resize(fbb_.GetSize() + binBuffer_.size());
-  uint8_t *dst = modelData.data();
-  uint8_t *src = fbb_.GetBufferPointer();
-  for (uint32_t i = 0; i < fbb_.GetSize(); i++) {
-    *dst++ = *src++;
-  }
-  src = binBuffer_.data();
-  for (uint32_t i = 0; i < binBuffer_.size(); i++) {
-    *dst++ = *src++;
-  }
-  binBuffer_.clear();
-
   CviModelHeader header;
-  genMD5Hash(modelData, (uint8_t *)header.md5);
   std::string magic = u8"CviModel";
   std::string padding = u8"AA";
   memcpy(header.magic, magic.c_str(), 8);
@@ -458,8 +483,26 @@ void CviModelBuilder::storeModel(std::string filename) {
   header.major = majorVersion_; // defined in cvimodel.fbs
   header.minor = minorVersion_; // defined in cvimodel.fbs
 
-  output->os().write(reinterpret_cast<char *>(&header), sizeof(CviModelHeader));
-  output->os().write(reinterpret_cast<char *>(modelData.data()), modelData.size());
+  // sections are streamed from their own buffers, md5 of the body is put in
+  // the header at last
+  auto &os = output->os();
+  if (os.supportsSeeking()) {
+    memset(header.md5, 0, sizeof(header.md5));
+    os.write(reinterpret_cast<char *>(&header), sizeof(CviModelHeader));
+    CviModelWriter writer(&os);
+    writeBody(writer);
+    writer.finish((uint8_t *)header.md5);
+    os.seek(0);
+    os.write(reinterpret_cast<char *>(&header), sizeof(CviModelHeader));
+  } else {
+    // hash first, then write
+    CviModelWriter hasher(nullptr);
+    writeBody(hasher);
+    hasher.finish((uint8_t *)header.md5);
+    os.write(reinterpret_cast<char *>(&header), sizeof(CviModelHeader));
+    CviModelWriter writer(&os);
+    writeBody(writer);
+  }
   output->keep();
 }
 
@@ -0,0 +1,155 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/ActivationStatistics.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+
+namespace tpu_mlir {
+
+static const char STAT_MAGIC[8] = {'T', 'P', 'U', 'S', 'T', 'A', 'T', 0};
+static const uint32_t STAT_VERSION = 1;
+
+void ActivationStatistics::init_histogram(const std::string &name,
+                                          double abs_max, int64_t bin_num) {
+  auto &t = tensors[name];
+  t.width = abs_max / (bin_num - 1);
+  t.histogram.assign(bin_num, 0);
+}
+
+void ActivationStatistics::update(const std::string &name, const float *data,
+                                  int64_t num) {
+  auto &t = tensors[name];
+  float min = t.min, max = t.max;
+#pragma omp parallel for schedule(static) reduction(min : min) reduction(max : max)
+  for (int64_t i = 0; i < num; i++) {
+    min = std::min(min, data[i]);
+    max = std::max(max, data[i]);
+  }
+  t.min = min;
+  t.max = max;
+  t.count++;
+  if (t.histogram.empty()) {
+    return;
+  }
+  int64_t bin_num = t.histogram.size();
+  float width = t.width;
+#pragma omp parallel
+  {
+    std::vector<int64_t> hist(bin_num, 0);
+#pragma omp for schedule(static)
+    for (int64_t i = 0; i < num; i++) {
+      if (data[i] == 0) {
+        continue;
+      }
+      float bin = std::floor(std::abs(data[i]) / width + 0.5f);
+      // out of range and nan are dropped, as np.histogram
+      if (bin <= bin_num - 1) {
+        hist[(int64_t)bin]++;
+      }
+    }
+#pragma omp critical
+    for (int64_t i = 0; i < bin_num; i++) {
+      t.histogram[i] += hist[i];
+    }
+  }
+}
+
+void ActivationStatistics::merge(const ActivationStatistics &other) {
+  for (auto &it : other.tensors) {
+    auto &src = it.second;
+    auto &dst = tensors[it.first];
+    dst.min = std::min(dst.min, src.min);
+    dst.max = std::max(dst.max, src.max);
+    dst.count += src.count;
+    if (src.histogram.empty()) {
+      continue;
+    }
+    if (dst.histogram.empty()) {
+      dst.width = src.width;
+      dst.histogram = src.histogram;
+      continue;
+    }
+    if (dst.width != src.width || dst.histogram.size() != src.histogram.size()) {
+      llvm::errs() << "histogram of " << it.first << " has different bins\n";
+      llvm_unreachable("merge statistics failed");
+    }
+    for (size_t i = 0; i < dst.histogram.size(); i++) {
+      dst.histogram[i] += src.histogram[i];
+    }
+  }
+}
+
+template <typename T> static void put(std::string &buf, const T &v) {
+  buf.append((const char *)&v, sizeof(T));
+}
+
+template <typename T> static bool get(llvm::StringRef &buf, T &v) {
+  if (buf.size() < sizeof(T)) {
+    return false;
+  }
+  memcpy(&v, buf.data(), sizeof(T));
+  buf = buf.drop_front(sizeof(T));
+  return true;
+}
+
+// magic, version, num, then for each tensor:
+// name_len, name, min, max, count, width, bin_num, histogram
+std::string ActivationStatistics::serialize() const {
+  std::string buf(STAT_MAGIC, sizeof(STAT_MAGIC));
+  put(buf, STAT_VERSION);
+  put(buf, (uint64_t)tensors.size());
+  for (auto &it : tensors) {
+    auto &t = it.second;
+    put(buf, (uint32_t)it.first.size());
+    buf.append(it.first);
+    put(buf, t.min);
+    put(buf, t.max);
+    put(buf, t.count);
+    put(buf, t.width);
+    put(buf, (uint64_t)t.histogram.size());
+    buf.append((const char *)t.histogram.data(),
+               t.histogram.size() * sizeof(int64_t));
+  }
+  return buf;
+}
+
+bool ActivationStatistics::deserialize(llvm::StringRef data) {
+  if (!data.startswith(llvm::StringRef(STAT_MAGIC, sizeof(STAT_MAGIC)))) {
+    return false;
+  }
+  data = data.drop_front(sizeof(STAT_MAGIC));
+  uint32_t version;
+  uint64_t num;
+  if (!get(data, version) || version != STAT_VERSION || !get(data, num)) {
+    return false;
+  }
+  tensors.clear();
+  for (uint64_t i = 0; i < num; i++) {
+    uint32_t name_len;
+    uint64_t bin_num;
+    if (!get(data, name_len) || data.size() < name_len) {
+      return false;
+    }
+    auto &t = tensors[data.take_front(name_len).str()];
+    data = data.drop_front(name_len);
+    if (!get(data, t.min) || !get(data, t.max) || !get(data, t.count) ||
+        !get(data, t.width) || !get(data, bin_num) ||
+        data.size() < bin_num * sizeof(int64_t)) {
+      return false;
+    }
+    t.histogram.resize(bin_num);
+    memcpy(t.histogram.data(), data.data(), bin_num * sizeof(int64_t));
+    data = data.drop_front(bin_num * sizeof(int64_t));
+  }
+  return true;
+}
+
+} // namespace tpu_mlir
@@ -0,0 +1,84 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/ActiveLut.h"
+#include "tpu_mlir/Support/Float16.h"
+#include "tpu_mlir/Support/MathUtils.h"
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tpu_mlir {
+
+static const int LUT_SIZE = 65536;
+
+const float *get_active_lut(active_f32_f func, bool is_bf16) {
+  static std::mutex mutex;
+  static std::map<std::pair<active_f32_f, bool>, std::unique_ptr<float[]>>
+      luts;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto &lut = luts[{func, is_bf16}];
+  if (lut) {
+    return lut.get();
+  }
+  lut.reset(new float[LUT_SIZE]);
+  auto table = lut.get();
+#pragma omp parallel for schedule(static)
+  for (int i = 0; i < LUT_SIZE; i++) {
+    table[i] = func(is_bf16 ? bf16_to_f32(i) : f16_to_f32(i));
+  }
+  // round by the same function as ops do
+  if (is_bf16) {
+    f32_to_bf16(table, table, LUT_SIZE);
+  } else {
+    f32_to_f16(table, table, LUT_SIZE);
+  }
+  return table;
+}
+
+// index of x in table, or -1 if x is not exact in bf16
+static inline int bf16_index(uint32_t bits) {
+  return (bits & 0xFFFF) == 0 ? (int)(bits >> 16) : -1;
+}
+
+// index of x in table, or -1 if x is not zero or normal in f16; f16
+// denormals, inf and nan are computed, which is rare
+static inline int f16_index(uint32_t bits) {
+  uint32_t sign = (bits >> 16) & 0x8000;
+  uint32_t abs = bits & 0x7FFFFFFF;
+  if (abs == 0) {
+    return sign;
+  }
+  int32_t exp = (int32_t)(abs >> 23) - 127;
+  if (exp < -14 || exp > 15 || (abs & 0x1FFF) != 0) {
+    return -1;
+  }
+  return sign | ((exp + 15) << 10) | ((abs >> 13) & 0x3FF);
+}
+
+void active_by_lut(const float *src, float *dst, int64_t num,
+                   const float *table, active_f32_f func, bool is_bf16) {
+#pragma omp parallel for schedule(static, omp_schedule(num))
+  for (int64_t i = 0; i < num; i++) {
+    uint32_t bits;
+    memcpy(&bits, src + i, sizeof(bits));
+    int idx = is_bf16 ? bf16_index(bits) : f16_index(bits);
+    if (idx >= 0) {
+      dst[i] = table[idx];
+    } else if (is_bf16) {
+      dst[i] = bf16_to_f32(f32_to_bf16(func(src[i])));
+    } else {
+      dst[i] = f16_to_f32(f32_to_f16(func(src[i])));
+    }
+  }
+}
+
+} // namespace tpu_mlir
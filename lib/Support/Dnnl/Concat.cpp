@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/Concat.h"
+#include <cstring>
 
 using namespace dnnl;
 using tag = memory::format_tag;
@@ -16,40 +17,73 @@ using dt = memory::data_type;
 
 namespace tpu_mlir {
 
+// below this size of a block, per block memcpy costs more than oneDNN
+static const int64_t MIN_MEMCPY_BLOCK = 64;
+
 Concat::Concat() {
   eng = dnnl::engine(engine::kind::cpu, 0);
   eng_stream = dnnl::stream(eng);
 }
 
-void Concat::setup(std::vector<float *>input, float *output, concat_attr_t &attr) {
-  this->attr_ = std::move(attr);
+void Concat::setup(std::vector<float *> input, float *output,
+                   concat_attr_t &attr) {
+  attr_ = attr;
   p_input = input;
   p_output = output;
+  concat_args.clear();
 
-    std::vector<memory::desc> src_mds;
-    std::vector<memory> src_mems;
-
-const size_t input_num = input.size();
-for (size_t i = 0; i < input_num; i++) {
-  auto src_md = memory::desc(attr_.src_shape, dt::f32, tag::ncw);
-  auto src_mem = memory(src_md, eng, p_input[i]);
+  // each input is a contiguous block of axis_dim * inner_dim per outer index
+  int64_t min_block = attr_.axis_dims[0] * attr_.inner_dim;
+  int64_t axis_sum = 0;
+  for (auto dim : attr_.axis_dims) {
+    min_block = std::min(min_block, dim * attr_.inner_dim);
+    axis_sum += dim;
+  }
+  use_memcpy = attr_.outer_dim == 1 || min_block >= MIN_MEMCPY_BLOCK;
+  if (use_memcpy) {
+    return;
+  }
 
+  std::vector<memory::desc> src_mds;
+  for (size_t i = 0; i < p_input.size(); i++) {
+    memory::dims src_shape = {attr_.outer_dim, attr_.axis_dims[i],
+                              attr_.inner_dim};
+    auto src_md = memory::desc(src_shape, dt::f32, tag::abc);
     src_mds.push_back(src_md);
-    src_mems.push_back(src_mem);
-}
-
- auto concat_pd = concat::primitive_desc(attr_.axis, src_mds, eng);
- auto dst_mem = memory(concat_pd.dst_desc(), eng);
- auto concat_prim = concat(concat_pd);
-
- for (int n = 0; n < input_num; ++n)
-        concat_args.insert({DNNL_ARG_MULTIPLE_SRC + n, src_mems[n]});
-  concat_args.insert({DNNL_ARG_DST, dst_mem});
+    concat_args.insert(
+        {DNNL_ARG_MULTIPLE_SRC + (int)i, memory(src_md, eng, p_input[i])});
+  }
+  memory::dims dst_shape = {attr_.outer_dim, axis_sum, attr_.inner_dim};
+  auto dst_md = memory::desc(dst_shape, dt::f32, tag::abc);
+  auto concat_pd = concat::primitive_desc(dst_md, 1, src_mds, eng);
+  concat_prim = concat(concat_pd);
+  concat_args.insert({DNNL_ARG_DST, memory(dst_md, eng, p_output)});
 }
 
 void Concat::run() {
-  concat_prim.execute(eng_stream, concat_args);
-  eng_stream.wait();
+  if (!use_memcpy) {
+    concat_prim.execute(eng_stream, concat_args);
+    eng_stream.wait();
+    return;
+  }
+  const int64_t num_input = p_input.size();
+  std::vector<int64_t> block(num_input), dst_offset(num_input);
+  int64_t dst_block = 0;
+  for (int64_t i = 0; i < num_input; i++) {
+    block[i] = attr_.axis_dims[i] * attr_.inner_dim;
+    dst_offset[i] = dst_block;
+    dst_block += block[i];
+  }
+#pragma omp parallel for schedule(static) collapse(2)
+  for (int64_t o = 0; o < attr_.outer_dim; o++) {
+    for (int64_t i = 0; i < num_input; i++) {
+      auto dst = p_output + o * dst_block + dst_offset[i];
+      auto src = p_input[i] + o * block[i];
+      if (dst != src) {
+        memcpy(dst, src, block[i] * sizeof(float));
+      }
+    }
+  }
 }
 
 } // namespace tpu_mlir
@@ -18,6 +18,7 @@ Conv::Conv() {
   eng = dnnl::engine(engine::kind::cpu, 0);
   eng_stream = dnnl::stream(eng);
   memset(&_attr, 0, sizeof(conv_attr_t));
+  int8_mode = false;
 }
 
 Conv::~Conv() {}
@@ -160,8 +161,153 @@ void Conv::setup(float *input, float *weight, float *bias, float *output,
   }
 }
 
+bool Conv::setup_int8(float *input, float *weight, conv_attr_t attr,
+                      bool input_unsigned) {
+  if (!int8_isa_exact()) {
+    return false;
+  }
+  // weight after zp should be s8, and accumulators should be exact
+  int64_t oc_size = attr.ic / attr.groups * attr.kd * attr.kh * attr.kw;
+  int64_t weight_size = attr.oc * oc_size;
+  int64_t max_abs_sum = 0;
+  for (int64_t o = 0; o < attr.oc; o++) {
+    int64_t sum = 0;
+    for (int64_t i = o * oc_size; i < (o + 1) * oc_size; i++) {
+      int64_t w = (int64_t)weight[i] - attr.kernel_zp;
+      if (w < -128 || w > 127) {
+        return false;
+      }
+      sum += std::abs(w);
+    }
+    max_abs_sum = std::max(max_abs_sum, sum);
+  }
+  if (!int8_acc_exact(max_abs_sum, input_unsigned)) {
+    return false;
+  }
+  int8_mode = true;
+  origin_input = input;
+  memcpy(&_attr, &attr, sizeof(conv_attr_t));
+  // pad with zp explicitly, dnnl pads zero
+  if (attr.pad_value != 0 && (attr.pdf > 0 || attr.pdb > 0 || attr.pht > 0 ||
+                              attr.phb > 0 || attr.pwl > 0 || attr.pwr > 0)) {
+    src_shape = {attr.n, attr.ic, attr.id + attr.pdf + attr.pdb,
+                 attr.ih + attr.pht + attr.phb, attr.iw + attr.pwl + attr.pwr};
+    attr.pdf = attr.pdb = attr.pht = attr.phb = attr.pwl = attr.pwr = 0;
+  } else {
+    src_shape = {attr.n, attr.ic, attr.id, attr.ih, attr.iw};
+  }
+  input_i8.assign(src_shape[0] * src_shape[1] * src_shape[2] * src_shape[3] *
+                      src_shape[4],
+                  (int8_t)(uint8_t)_attr.pad_value);
+  weight_i8.resize(weight_size);
+  for (int64_t i = 0; i < weight_size; i++) {
+    weight_i8[i] = (int8_t)((int64_t)weight[i] - attr.kernel_zp);
+  }
+  dst_shape = {attr.n, attr.oc, attr.od, attr.oh, attr.ow};
+  output_i32.resize(dst_shape[0] * dst_shape[1] * dst_shape[2] * dst_shape[3] *
+                    dst_shape[4]);
+  memory::dims filter_shape =
+      (attr.groups != 1)
+          ? memory::dims{attr.groups,
+                         attr.oc / attr.groups,
+                         attr.ic / attr.groups,
+                         attr.kd,
+                         attr.kh,
+                         attr.kw}
+          : memory::dims{attr.oc, attr.ic, attr.kd, attr.kh, attr.kw};
+  memory::dims strides = {attr.sd, attr.sh, attr.sw};
+  memory::dims padding_l = {attr.pdf, attr.pht, attr.pwl};
+  memory::dims padding_r = {attr.pdb, attr.phb, attr.pwr};
+  memory::dims dilation = {attr.dd - 1, attr.dh - 1, attr.dw - 1};
+  auto src_dt = input_unsigned ? memory::data_type::u8 : memory::data_type::s8;
+
+  net.clear();
+  net_args.clear();
+  auto src_md = memory::desc({src_shape}, src_dt, memory::format_tag::any);
+  auto filter_md = memory::desc({filter_shape}, memory::data_type::s8,
+                                memory::format_tag::any);
+  auto dst_md = memory::desc({dst_shape}, memory::data_type::s32,
+                             memory::format_tag::any);
+  auto conv_desc = convolution_forward::desc(
+      prop_kind::forward_inference, algorithm::convolution_direct, src_md,
+      filter_md, dst_md, strides, dilation, padding_l, padding_r);
+  conv_prim_desc = convolution_forward::primitive_desc(conv_desc, eng);
+
+  auto filter_tag = (attr.groups != 1) ? memory::format_tag::goidhw
+                                       : memory::format_tag::oidhw;
+  auto filter_memory = memory(
+      {{filter_shape}, memory::data_type::s8, filter_tag}, eng,
+      weight_i8.data());
+  prim_filter_memory = filter_memory;
+  if (conv_prim_desc.weights_desc() != filter_memory.get_desc()) {
+    prim_filter_memory = memory(conv_prim_desc.weights_desc(), eng);
+    reorder(filter_memory, prim_filter_memory)
+        .execute(eng_stream, filter_memory, prim_filter_memory);
+    eng_stream.wait();
+    weight_i8.clear();
+    weight_i8.shrink_to_fit();
+  }
+
+  auto src_memory = memory({{src_shape}, src_dt, memory::format_tag::ncdhw},
+                           eng, input_i8.data());
+  auto prim_src_memory = src_memory;
+  if (conv_prim_desc.src_desc() != src_memory.get_desc()) {
+    prim_src_memory = memory(conv_prim_desc.src_desc(), eng);
+    net.push_back(reorder(src_memory, prim_src_memory));
+    net_args.push_back(
+        {{DNNL_ARG_FROM, src_memory}, {DNNL_ARG_TO, prim_src_memory}});
+  }
+
+  auto dst_memory = memory(
+      {{dst_shape}, memory::data_type::s32, memory::format_tag::ncdhw}, eng,
+      output_i32.data());
+  auto prim_dst_memory = dst_memory;
+  if (conv_prim_desc.dst_desc() != dst_memory.get_desc()) {
+    prim_dst_memory = memory(conv_prim_desc.dst_desc(), eng);
+  }
+  net.push_back(convolution_forward(conv_prim_desc));
+  net_args.push_back({{DNNL_ARG_SRC, prim_src_memory},
+                      {DNNL_ARG_WEIGHTS, prim_filter_memory},
+                      {DNNL_ARG_DST, prim_dst_memory}});
+  if (prim_dst_memory != dst_memory) {
+    net.push_back(reorder(prim_dst_memory, dst_memory));
+    net_args.push_back(
+        {{DNNL_ARG_FROM, prim_dst_memory}, {DNNL_ARG_TO, dst_memory}});
+  }
+  return true;
+}
+
+const int32_t *Conv::int8_output() const {
+  return int8_mode ? output_i32.data() : nullptr;
+}
+
+// convert input to int8, into the interior if it is padded
+void Conv::int8_input_refresh() {
+  auto &a = _attr;
+  int64_t pd = src_shape[2], ph = src_shape[3], pw = src_shape[4];
+  if (pd == a.id && ph == a.ih && pw == a.iw) {
+    float_to_int8(input_i8.data(), origin_input, input_i8.size());
+    return;
+  }
+  int64_t rows = a.n * a.ic * a.id * a.ih;
+#pragma omp parallel for schedule(static, omp_schedule(rows))
+  for (int64_t r = 0; r < rows; r++) {
+    int64_t h = r % a.ih;
+    int64_t d = r / a.ih % a.id;
+    int64_t nc = r / a.ih / a.id;
+    auto src = origin_input + r * a.iw;
+    auto dst = input_i8.data() + ((nc * pd + d + a.pdf) * ph + h + a.pht) * pw +
+               a.pwl;
+    for (int64_t w = 0; w < a.iw; w++) {
+      dst[w] = (int8_t)(uint8_t)(int)src[w];
+    }
+  }
+}
+
 void Conv::run() {
-  if (input_after_pad) {
+  if (int8_mode) {
+    int8_input_refresh();
+  } else if (input_after_pad) {
     pad_tensor(input_after_pad->data(), origin_input, _attr.n, _attr.ic,
                _attr.id, _attr.ih, _attr.iw, _attr.pdf, _attr.pdb, _attr.pht,
                _attr.phb, _attr.pwl, _attr.pwr, _attr.pad_value);
@@ -8,13 +8,28 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/Deconv.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 #include "tpu_mlir/Support/MathUtils.h"
+#include <map>
+#include <mutex>
 #include <string.h>
 
 using namespace dnnl;
 using namespace tpu_mlir;
+
+// Deconvs of the same shape share one primitive
+static std::mutex deconv_cache_mutex;
+static std::map<std::vector<int64_t>,
+                std::pair<convolution_forward::primitive_desc,
+                          convolution_forward>>
+    conv_cache;
+static std::map<std::vector<int64_t>,
+                std::pair<deconvolution_forward::primitive_desc,
+                          deconvolution_forward>>
+    deconv_cache;
+
 Deconv::Deconv() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
+  eng = dnnl_cpu_engine();
   eng_stream = dnnl::stream(eng);
   memset(&_attrs, 0, sizeof(deconv_attr_t));
   _izp = 0;
@@ -34,7 +49,9 @@ void Deconv::pad_init(float *input, deconv_attr_t &attr, int izp) {
                  (attr.iw - 1) * attr.sw + 1 + attr.dw * (attr.kw - 1)};
     int input_padded_size = src_shape[0] * src_shape[1] * src_shape[2] *
                             src_shape[3] * src_shape[4];
-    input_after_pad = std::make_shared<std::vector<float>>(input_padded_size);
+    // padding and insertion are filled once here
+    input_after_pad =
+        std::make_shared<std::vector<float>>(input_padded_size, (float)izp);
     attr.pad_d = attr.pad_d_after = attr.pad_h = attr.pad_h_after = attr.pad_w =
         attr.pad_w_after = 0;
     attr.sd = attr.sh = attr.sw = 1;
@@ -67,6 +84,13 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
                             attr.pad_w_after};
   memory::dims dilation = {attr.dd - 1, attr.dh - 1, attr.dw - 1};
 
+  std::vector<int64_t> key = {_izp != 0, bias != nullptr, attr.do_relu};
+  for (auto &dims : {src_shape, filter_shape, dst_shape, strides, dilation,
+                     padding_l, padding_r}) {
+    key.insert(key.end(), dims.begin(), dims.end());
+  }
+  std::lock_guard<std::mutex> lock(deconv_cache_mutex);
+
   net.clear();
   net_args.clear();
   auto src_md = memory::desc({src_shape}, memory::data_type::f32,
@@ -77,7 +101,11 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
                               memory::format_tag::any);
   auto dst_md = memory::desc({dst_shape}, memory::data_type::f32,
                              memory::format_tag::any);
-  if (_izp != 0) {
+  auto conv_it = conv_cache.find(key);
+  auto deconv_it = deconv_cache.find(key);
+  if (_izp != 0 && conv_it != conv_cache.end()) {
+    conv_prim_desc = conv_it->second.first;
+  } else if (_izp != 0) {
     auto conv_desc = convolution_forward::desc(
         prop_kind::forward_inference, algorithm::convolution_direct, src_md,
         filter_md, bias_md, dst_md, strides, dilation, padding_l, padding_r);
@@ -101,7 +129,45 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
 
     conv_prim_desc =
         convolution_forward::primitive_desc(conv_desc, conv_attr, eng);
+    conv_it = conv_cache
+                  .emplace(key, std::make_pair(conv_prim_desc,
+                                               convolution_forward(
+                                                   conv_prim_desc)))
+                  .first;
+  } else if (deconv_it != deconv_cache.end()) {
+    deconv_prim_desc = deconv_it->second.first;
+  } else {
+    auto deconv_desc = deconvolution_forward::desc(
+        prop_kind::forward_inference, algorithm::deconvolution_direct, src_md,
+        filter_md, bias_md, dst_md, strides, dilation, padding_l, padding_r);
 
+    if (bias == nullptr)
+      deconv_desc = deconvolution_forward::desc(
+          prop_kind::forward_inference, algorithm::deconvolution_direct, src_md,
+          filter_md, dst_md, strides, dilation, padding_l, padding_r);
+
+    post_ops ops;
+    primitive_attr deconv_attr;
+
+    if (attr.do_relu) {
+      const float ops_scale = 1.f;
+      const float ops_alpha = 0.f; // relu negative slope
+      const float ops_beta = 0.f;
+      ops.append_eltwise(ops_scale, algorithm::eltwise_relu, ops_alpha,
+                         ops_beta);
+      deconv_attr.set_post_ops(ops);
+    }
+
+    deconv_prim_desc =
+        deconvolution_forward::primitive_desc(deconv_desc, deconv_attr, eng);
+    deconv_it = deconv_cache
+                    .emplace(key, std::make_pair(deconv_prim_desc,
+                                                 deconvolution_forward(
+                                                     deconv_prim_desc)))
+                    .first;
+  }
+
+  if (_izp != 0) {
     // set mkldnn memory
     auto filter_tag =
         (attr.g != 1) ? memory::format_tag::goidhw : memory::format_tag::oidhw;
@@ -151,8 +217,15 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
           {{DNNL_ARG_FROM, src_memory}, {DNNL_ARG_TO, prim_src_memory}});
     }
 
-    auto prim_dst_memory = memory(conv_prim_desc.dst_desc(), eng);
-    net.push_back(convolution_forward(conv_prim_desc));
+    // reorder or copy the output
+    auto dst_memory =
+        memory({{dst_shape}, memory::data_type::f32, memory::format_tag::ncdhw},
+               eng, output);
+    auto prim_dst_memory = dst_memory;
+    if (conv_prim_desc.dst_desc() != dst_memory.get_desc()) {
+      prim_dst_memory = memory(conv_prim_desc.dst_desc(), eng);
+    }
+    net.push_back(conv_it->second.second);
     if (bias != nullptr) {
       net_args.push_back({{DNNL_ARG_SRC, prim_src_memory},
                           {DNNL_ARG_WEIGHTS, prim_filter_memory},
@@ -163,40 +236,12 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
                           {DNNL_ARG_WEIGHTS, prim_filter_memory},
                           {DNNL_ARG_DST, prim_dst_memory}});
     }
-    // reorder or copy the output
-    auto dst_memory =
-        memory({{dst_shape}, memory::data_type::f32, memory::format_tag::ncdhw},
-               eng, output);
     if (prim_dst_memory != dst_memory) {
       net.push_back(reorder(prim_dst_memory, dst_memory));
       net_args.push_back(
           {{DNNL_ARG_FROM, prim_dst_memory}, {DNNL_ARG_TO, dst_memory}});
     }
   } else {
-    auto deconv_desc = deconvolution_forward::desc(
-        prop_kind::forward_inference, algorithm::deconvolution_direct, src_md,
-        filter_md, bias_md, dst_md, strides, dilation, padding_l, padding_r);
-
-    if (bias == nullptr)
-      deconv_desc = deconvolution_forward::desc(
-          prop_kind::forward_inference, algorithm::deconvolution_direct, src_md,
-          filter_md, dst_md, strides, dilation, padding_l, padding_r);
-
-    post_ops ops;
-    primitive_attr deconv_attr;
-
-    if (attr.do_relu) {
-      const float ops_scale = 1.f;
-      const float ops_alpha = 0.f; // relu negative slope
-      const float ops_beta = 0.f;
-      ops.append_eltwise(ops_scale, algorithm::eltwise_relu, ops_alpha,
-                         ops_beta);
-      deconv_attr.set_post_ops(ops);
-    }
-
-    deconv_prim_desc =
-        deconvolution_forward::primitive_desc(deconv_desc, deconv_attr, eng);
-
     // set mkldnn memory
     auto filter_tag =
         (attr.g != 1) ? memory::format_tag::goidhw : memory::format_tag::oidhw;
@@ -234,8 +279,15 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
           {{DNNL_ARG_FROM, src_memory}, {DNNL_ARG_TO, prim_src_memory}});
     }
 
-    auto prim_dst_memory = memory(deconv_prim_desc.dst_desc(), eng);
-    net.push_back(deconvolution_forward(deconv_prim_desc));
+    // reorder or copy the output
+    auto dst_memory =
+        memory({{dst_shape}, memory::data_type::f32, memory::format_tag::ncdhw},
+               eng, output);
+    auto prim_dst_memory = dst_memory;
+    if (deconv_prim_desc.dst_desc() != dst_memory.get_desc()) {
+      prim_dst_memory = memory(deconv_prim_desc.dst_desc(), eng);
+    }
+    net.push_back(deconv_it->second.second);
     if (bias != nullptr) {
       net_args.push_back({{DNNL_ARG_SRC, prim_src_memory},
                           {DNNL_ARG_WEIGHTS, prim_filter_memory},
@@ -246,10 +298,6 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
                           {DNNL_ARG_WEIGHTS, prim_filter_memory},
                           {DNNL_ARG_DST, prim_dst_memory}});
     }
-    // reorder or copy the output
-    auto dst_memory =
-        memory({{dst_shape}, memory::data_type::f32, memory::format_tag::ncdhw},
-               eng, output);
     if (prim_dst_memory != dst_memory) {
       net.push_back(reorder(prim_dst_memory, dst_memory));
       net_args.push_back(
@@ -260,12 +308,23 @@ void Deconv::setup(float *input, float *weight, float *bias, float *output,
 
 void Deconv::run() {
   if (input_after_pad) {
-    pad_tensor_for_deconv(input_after_pad->data(), origin_input, _attrs.n,
-                          _attrs.ic, _attrs.id, _attrs.ih, _attrs.iw, _attrs.kd,
-                          _attrs.kh, _attrs.kw, _attrs.dd, _attrs.dh, _attrs.dw,
-                          _attrs.sd, _attrs.sh, _attrs.sw, _attrs.pad_d,
-                          _attrs.pad_d_after, _attrs.pad_h, _attrs.pad_h_after,
-                          _attrs.pad_w, _attrs.pad_w_after, _izp);
+    // same layout as pad_tensor_for_deconv
+    int k[3] = {(int)_attrs.kd, (int)_attrs.kh, (int)_attrs.kw};
+    int dilation[3] = {(int)_attrs.dd, (int)_attrs.dh, (int)_attrs.dw};
+    int pad[3] = {(int)_attrs.pad_d, (int)_attrs.pad_h, (int)_attrs.pad_w};
+    int pad_after[3] = {(int)_attrs.pad_d_after, (int)_attrs.pad_h_after,
+                        (int)_attrs.pad_w_after};
+    int stride[3] = {(int)_attrs.sd, (int)_attrs.sh, (int)_attrs.sw};
+    int start[3], end[3];
+    for (int i = 0; i < 3; i++) {
+      int size = src_shape[i + 2];
+      start[i] = (k[i] - 1) * dilation[i] - pad[i];
+      end[i] = std::min(size, size - (k[i] - 1) * dilation[i] + pad_after[i]);
+    }
+    pad_tensor_interior(input_after_pad->data(), origin_input, _attrs.n,
+                        _attrs.ic, _attrs.id, _attrs.ih, _attrs.iw,
+                        src_shape[2], src_shape[3], src_shape[4], start,
+                        stride, end);
   }
   for (size_t i = 0; i < net.size(); ++i) {
     net.at(i).execute(eng_stream, net_args.at(i));
@@ -32,4 +32,17 @@ memory::data_type getDnnlType(mlir::Value v) {
   type.dump();
   return memory::data_type::f32;
 }
+
+int64_t int8_epilogue(int32_t acc, float bias, bool do_relu,
+                      double relu_limit) {
+  int64_t v = (int64_t)acc + (int64_t)bias;
+  if (do_relu) {
+    v = std::max(v, (int64_t)0);
+    if (relu_limit > 0.f && v > relu_limit) {
+      // bounded relu gives the limit in f32, then it is truncated to int
+      v = (int64_t)(float)relu_limit;
+    }
+  }
+  return v;
+}
 } // namespace tpu_mlir
@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
+#include "tpu_mlir/Support/MathUtils.h"
 using namespace dnnl;
 namespace tpu_mlir {
 
@@ -28,4 +29,35 @@ void post_relu(primitive_attr &attr, bool &do_relu, double &relu_limit)
     attr.set_post_ops(ops);
   }
 }
+
+void float_to_int8(int8_t *dst, const float *src, int64_t num) {
+#pragma omp parallel for schedule(static, omp_schedule(num))
+  for (int64_t i = 0; i < num; i++) {
+    dst[i] = (int8_t)(uint8_t)(int)src[i];
+  }
+}
+
+bool int8_isa_exact() {
+  static bool exact = [] {
+    switch (get_effective_cpu_isa()) {
+    case cpu_isa::avx512_core_vnni:
+    case cpu_isa::avx512_core_bf16:
+    case cpu_isa::avx512_core_amx:
+      return true;
+    default:
+      return false;
+    }
+  }();
+  return exact;
+}
+
+bool int8_acc_exact(int64_t max_abs_sum, bool input_unsigned) {
+  int64_t max_input = input_unsigned ? 255 : 128;
+  return max_abs_sum * max_input < (1 << 24);
+}
+
+const engine &dnnl_cpu_engine() {
+  static engine eng(engine::kind::cpu, 0);
+  return eng;
+}
 } // namespace tpu_mlir
@@ -109,7 +109,74 @@ void MatMul::setup(float *left, float *right, float *bias, float *output,
   }
 }
 
+bool MatMul::setup_int8(float *left, float *right, bool right_is_const,
+                        int64_t batch, int64_t M, int64_t K, int64_t N,
+                        int64_t right_zp, bool left_unsigned) {
+  if (!int8_isa_exact()) {
+    return false;
+  }
+  int64_t weight_len = batch * K * N;
+  // right after zp should be s8, and accumulators should be exact; a not
+  // constant right can be any s8
+  int64_t max_abs_sum = K * 128;
+  if (right_is_const) {
+    std::vector<int64_t> sums(batch * N, 0);
+    for (int64_t i = 0; i < weight_len; i++) {
+      int64_t w = (int64_t)right[i] - right_zp;
+      if (w < -128 || w > 127) {
+        return false;
+      }
+      sums[i / (K * N) * N + i % N] += std::abs(w);
+    }
+    max_abs_sum = *std::max_element(sums.begin(), sums.end());
+  } else if (right_zp != 0) {
+    return false;
+  }
+  if (!int8_acc_exact(max_abs_sum, left_unsigned)) {
+    return false;
+  }
+  int8_mode = true;
+  this->right_is_const = right_is_const;
+  p_left = left;
+  p_right = right;
+  left_i8.resize(batch * M * K);
+  right_i8.resize(weight_len);
+  output_i32.resize(batch * M * N);
+  if (right_is_const) {
+    for (int64_t i = 0; i < weight_len; i++) {
+      right_i8[i] = (int8_t)((int64_t)right[i] - right_zp);
+    }
+  }
+  memory::dims src_dims = {batch, M, K};
+  memory::dims weights_dims = {batch, K, N};
+  memory::dims dst_dims = {batch, M, N};
+  auto src_md = memory::desc(src_dims, left_unsigned ? dt::u8 : dt::s8,
+                             tag::abc);
+  auto weights_md = memory::desc(weights_dims, dt::s8, tag::abc);
+  auto dst_md = memory::desc(dst_dims, dt::s32, tag::abc);
+  auto matmul_pd =
+      matmul::primitive_desc(matmul::desc(src_md, weights_md, dst_md), eng);
+  net.clear();
+  net_args.clear();
+  net.push_back(matmul(matmul_pd));
+  net_args.push_back(
+      {{DNNL_ARG_SRC, memory(src_md, eng, left_i8.data())},
+       {DNNL_ARG_WEIGHTS, memory(weights_md, eng, right_i8.data())},
+       {DNNL_ARG_DST, memory(dst_md, eng, output_i32.data())}});
+  return true;
+}
+
+const int32_t *MatMul::int8_output() const {
+  return int8_mode ? output_i32.data() : nullptr;
+}
+
 void MatMul::run() {
+  if (int8_mode) {
+    float_to_int8(left_i8.data(), p_left, left_i8.size());
+    if (!right_is_const) {
+      float_to_int8(right_i8.data(), p_right, right_i8.size());
+    }
+  }
   for (size_t i = 0; i < net.size(); ++i)
     net.at(i).execute(engine_stream, net_args.at(i));
   engine_stream.wait();
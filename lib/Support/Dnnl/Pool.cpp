@@ -8,13 +8,22 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/Dnnl/Pool.h"
+#include "tpu_mlir/Support/Dnnl/DnnlUtils.h"
 #include "tpu_mlir/Support/MathUtils.h"
+#include <map>
+#include <mutex>
 
 using namespace dnnl;
 using namespace tpu_mlir;
 
+// Poolings of the same shape share one primitive
+static std::mutex pool_cache_mutex;
+static std::map<std::vector<int64_t>, std::pair<pooling_forward::primitive_desc,
+                                                pooling_forward>>
+    pool_cache;
+
 Pooling::Pooling() {
-  eng = dnnl::engine(engine::kind::cpu, 0);
+  eng = dnnl_cpu_engine();
   eng_stream = dnnl::stream(eng);
   memset(&_attrs, 0, sizeof(pool_attr_t));
   _izp = 0;
@@ -22,24 +31,59 @@ Pooling::Pooling() {
 
 Pooling::~Pooling() {}
 
-void Pooling::pad_init(float *input, pool_attr_t &attr, int izp) {
+void Pooling::pad_init(float *input, pool_attr_t &attr, int izp, bool is_avg) {
   origin_input = input;
   _izp = izp;
   memcpy(&_attrs, &attr, sizeof(pool_attr_t));
-  if (izp && (attr.pad_d > 0 || attr.pad_d_after > 0 || attr.pad_h > 0 ||
-              attr.pad_h_after > 0 || attr.pad_w > 0 || attr.pad_w_after > 0)) {
+  bool has_pad = attr.pad_d > 0 || attr.pad_d_after > 0 || attr.pad_h > 0 ||
+                 attr.pad_h_after > 0 || attr.pad_w > 0 || attr.pad_w_after > 0;
+  if (izp && has_pad && is_avg) {
     src_shape = {attr.n, attr.c, attr.id + attr.pad_d + attr.pad_d_after,
                  attr.ih + attr.pad_h + attr.pad_h_after,
                  attr.iw + attr.pad_w + attr.pad_w_after};
     int input_padded_size = src_shape[0] * src_shape[1] * src_shape[2] *
                             src_shape[3] * src_shape[4];
-    input_after_pad = std::make_shared<std::vector<float>>(input_padded_size);
+    // padding is filled once here
+    input_after_pad =
+        std::make_shared<std::vector<float>>(input_padded_size, (float)izp);
     attr.pad_d = attr.pad_d_after = attr.pad_h = attr.pad_h_after = attr.pad_w =
         attr.pad_w_after = 0;
     p_input = input_after_pad->data();
   } else {
     src_shape = {attr.n, attr.c, attr.id, attr.ih, attr.iw};
     p_input = input;
+    if (izp && has_pad) {
+      pad_outputs_init(attr);
+    }
+  }
+}
+
+// max(window with izp padding) = max(max(window), izp)
+void Pooling::pad_outputs_init(pool_attr_t &attr) {
+  int64_t in[3] = {attr.id, attr.ih, attr.iw};
+  int64_t out[3] = {attr.od, attr.oh, attr.ow};
+  int64_t k[3] = {attr.kd, attr.kh, attr.kw};
+  int64_t s[3] = {attr.sd, attr.sh, attr.sw};
+  int64_t pad[3] = {attr.pad_d, attr.pad_h, attr.pad_w};
+  int64_t idx = 0;
+  for (int64_t od = 0; od < out[0]; od++) {
+    for (int64_t oh = 0; oh < out[1]; oh++) {
+      for (int64_t ow = 0; ow < out[2]; ow++, idx++) {
+        int64_t o[3] = {od, oh, ow};
+        bool padded = false, pad_only = false;
+        for (int i = 0; i < 3; i++) {
+          int64_t start = o[i] * s[i] - pad[i];
+          int64_t end = start + k[i];
+          padded |= start < 0 || end > in[i];
+          pad_only |= end <= 0 || start >= in[i];
+        }
+        if (pad_only) {
+          pad_only_outputs.push_back(idx);
+        } else if (padded) {
+          pad_outputs.push_back(idx);
+        }
+      }
+    }
   }
 }
 
@@ -48,27 +92,42 @@ void Pooling::setup(float *input, float *output, pool_attr_t attr, bool is_avg,
   this->kd = attr.kd;
   this->kh = attr.kh;
   this->kw = attr.kw;
-  pad_init(input, attr, izp);
-  memory::dims dst_shape = {attr.n, attr.c, attr.od, attr.oh, attr.ow};
+  pad_init(input, attr, izp, is_avg);
+  p_output = output;
+  dst_shape = {attr.n, attr.c, attr.od, attr.oh, attr.ow};
   memory::dims strides = {attr.sd, attr.sh, attr.sw};
   memory::dims kernel = {attr.kd, attr.kh, attr.kw};
   memory::dims padding_tl = {attr.pad_d, attr.pad_h, attr.pad_w};
   memory::dims padding_br = {attr.pad_d_after, attr.pad_h_after,
                              attr.pad_w_after};
-  auto src_md = memory::desc({src_shape}, memory::data_type::f32,
-                             memory::format_tag::ncdhw);
-  auto dst_md = memory::desc({dst_shape}, memory::data_type::f32,
-                             memory::format_tag::ncdhw);
   auto pool_avg_algo = attr.count_include_pad
                            ? algorithm::pooling_avg_include_padding
                            : algorithm::pooling_avg_exclude_padding;
-  // pool desc
-  auto pool_desc = pooling_forward::desc(
-      prop_kind::forward_inference,
-      is_avg ? pool_avg_algo : algorithm::pooling_max, src_md, dst_md, strides,
-      kernel, padding_tl, padding_br);
+  auto pool_algo = is_avg ? pool_avg_algo : algorithm::pooling_max;
+
+  std::vector<int64_t> key = {(int64_t)pool_algo};
+  for (auto &dims :
+       {src_shape, dst_shape, strides, kernel, padding_tl, padding_br}) {
+    key.insert(key.end(), dims.begin(), dims.end());
+  }
+  std::unique_lock<std::mutex> lock(pool_cache_mutex);
+  auto it = pool_cache.find(key);
+  if (it == pool_cache.end()) {
+    auto src_md = memory::desc({src_shape}, memory::data_type::f32,
+                               memory::format_tag::ncdhw);
+    auto dst_md = memory::desc({dst_shape}, memory::data_type::f32,
+                               memory::format_tag::ncdhw);
+    // pool desc
+    auto pool_desc =
+        pooling_forward::desc(prop_kind::forward_inference, pool_algo, src_md,
+                              dst_md, strides, kernel, padding_tl, padding_br);
+    auto pd = pooling_forward::primitive_desc(pool_desc, eng);
+    it = pool_cache.emplace(key, std::make_pair(pd, pooling_forward(pd))).first;
+  }
+  prim_desc = it->second.first;
+  auto pool_prim = it->second.second;
+  lock.unlock();
 
-  prim_desc = pooling_forward::primitive_desc(pool_desc, eng);
   memory src_memory =
       memory({{src_shape}, memory::data_type::f32, memory::format_tag::ncdhw},
              eng, p_input);
@@ -84,8 +143,11 @@ void Pooling::setup(float *input, float *output, pool_attr_t attr, bool is_avg,
     net_args.push_back(
         {{DNNL_ARG_FROM, src_memory}, {DNNL_ARG_TO, prim_src_memory}});
   }
-  auto prim_dst_memory = memory(prim_desc.dst_desc(), eng);
-  net.push_back(pooling_forward(prim_desc));
+  auto prim_dst_memory = dst_memory;
+  if (prim_desc.dst_desc() != dst_memory.get_desc()) {
+    prim_dst_memory = memory(prim_desc.dst_desc(), eng);
+  }
+  net.push_back(pool_prim);
   net_args.push_back(
       {{DNNL_ARG_SRC, prim_src_memory}, {DNNL_ARG_DST, prim_dst_memory}});
   if (prim_dst_memory != dst_memory) {
@@ -97,12 +159,30 @@ void Pooling::setup(float *input, float *output, pool_attr_t attr, bool is_avg,
 
 void Pooling::run() {
   if (input_after_pad) {
-    pad_tensor(input_after_pad->data(), origin_input, _attrs.n, _attrs.c,
-               _attrs.id, _attrs.ih, _attrs.iw, _attrs.pad_d,
-               _attrs.pad_d_after, _attrs.pad_h, _attrs.pad_h_after,
-               _attrs.pad_w, _attrs.pad_w_after, _izp);
+    int start[3] = {(int)_attrs.pad_d, (int)_attrs.pad_h, (int)_attrs.pad_w};
+    int stride[3] = {1, 1, 1};
+    int end[3] = {(int)src_shape[2], (int)src_shape[3], (int)src_shape[4]};
+    pad_tensor_interior(input_after_pad->data(), origin_input, _attrs.n,
+                        _attrs.c, _attrs.id, _attrs.ih, _attrs.iw, end[0],
+                        end[1], end[2], start, stride, end);
   }
   for (size_t i = 0; i < net.size(); ++i)
     net.at(i).execute(eng_stream, net_args.at(i));
   eng_stream.wait();
+  if (pad_outputs.empty() && pad_only_outputs.empty()) {
+    return;
+  }
+  int64_t nc = _attrs.n * _attrs.c;
+  int64_t plane = _attrs.od * _attrs.oh * _attrs.ow;
+  float zp = _izp;
+#pragma omp parallel for schedule(static, omp_schedule(nc))
+  for (int64_t i = 0; i < nc; i++) {
+    float *p = p_output + i * plane;
+    for (auto o : pad_outputs) {
+      p[o] = std::max(p[o], zp);
+    }
+    for (auto o : pad_only_outputs) {
+      p[o] = zp;
+    }
+  }
 }
@@ -9,8 +9,14 @@
 #include "tpu_mlir/Support/MathUtils.h"
 #include "tpu_mlir/Support/Float16.h"
 #include "bitcasts.h"
+#include <algorithm>
 #include <math.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FLOAT16_X86_SIMD
+#endif
+
 namespace tpu_mlir {
 
 /*
@@ -735,7 +741,302 @@ uint16_t f32_to_f16(float src) {
   return ret.bits;
 }
 
+// ============================================================
+// batch conversion, with AVX2/AVX-512 kernels selected at runtime
+// The kernels must produce the same bits as the scalar functions above:
+// - bf16: round half to even; fp32 NaN => 0x7fff; fp32 denormal => signed
+//   zero, or the smallest normal if it rounds up to it
+// - f16: IEEE round half to even; NaN => 0x7fff, f16 NaN => 0xFFC00000
+// - cv18xx bf16: HW rounding, inf/nan => 0x7f7f
+// ============================================================
+
+namespace {
+enum SimdLevel { SIMD_NONE, SIMD_AVX2, SIMD_AVX512 };
+
+SimdLevel simd_level() {
+  static SimdLevel level = []() {
+#ifdef FLOAT16_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+      return SIMD_AVX2;
+    }
+#endif
+    return SIMD_NONE;
+  }();
+  return level;
+}
+
+// split into blocks for openmp, kernel(src, dst, num) does one block
+template <typename Src, typename Dst, typename Kernel>
+void parallel_convert(Src *src, Dst *dst, int64_t num, Kernel kernel) {
+  const int64_t block = 4096;
+  int64_t num_blocks = (num + block - 1) / block;
+#pragma omp parallel for schedule(static)
+  for (int64_t b = 0; b < num_blocks; b++) {
+    int64_t offset = b * block;
+    kernel(src + offset, dst + offset, std::min(block, num - offset));
+  }
+}
+} // namespace
+
+#ifdef FLOAT16_X86_SIMD
+// fp32 bits => bf16 bits in the low half of each lane
+__attribute__((target("avx2"))) static inline __m256i
+bf16_round_avx2(__m256i x) {
+  const __m256i one = _mm256_set1_epi32(1);
+  auto lsb = _mm256_and_si256(_mm256_srli_epi32(x, 16), one);
+  auto bias = _mm256_add_epi32(_mm256_set1_epi32(0x7fff), lsb);
+  auto r = _mm256_srli_epi32(_mm256_add_epi32(x, bias), 16);
+  auto abs = _mm256_and_si256(x, _mm256_set1_epi32(0x7fffffff));
+  auto nan = _mm256_cmpgt_epi32(abs, _mm256_set1_epi32(0x7f800000));
+  r = _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7fff), nan);
+  // denormal: only 0x007f8000 and above round up to the smallest normal
+  auto exp = _mm256_and_si256(x, _mm256_set1_epi32(0x7f800000));
+  auto denorm = _mm256_cmpeq_epi32(exp, _mm256_setzero_si256());
+  auto high = _mm256_set1_epi32(0x7f8000);
+  auto up = _mm256_cmpeq_epi32(_mm256_and_si256(x, high), high);
+  auto d = _mm256_or_si256(
+      _mm256_and_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(0x8000)),
+      _mm256_and_si256(up, _mm256_set1_epi32(0x80)));
+  return _mm256_blendv_epi8(r, d, denorm);
+}
+
+__attribute__((target("avx512f"))) static inline __m512i
+bf16_round_avx512(__m512i x) {
+  const __m512i one = _mm512_set1_epi32(1);
+  auto lsb = _mm512_and_si512(_mm512_srli_epi32(x, 16), one);
+  auto bias = _mm512_add_epi32(_mm512_set1_epi32(0x7fff), lsb);
+  auto r = _mm512_srli_epi32(_mm512_add_epi32(x, bias), 16);
+  auto abs = _mm512_and_si512(x, _mm512_set1_epi32(0x7fffffff));
+  auto nan = _mm512_cmpgt_epi32_mask(abs, _mm512_set1_epi32(0x7f800000));
+  r = _mm512_mask_mov_epi32(r, nan, _mm512_set1_epi32(0x7fff));
+  auto exp = _mm512_and_si512(x, _mm512_set1_epi32(0x7f800000));
+  auto denorm = _mm512_cmpeq_epi32_mask(exp, _mm512_setzero_si512());
+  auto high = _mm512_set1_epi32(0x7f8000);
+  auto up = _mm512_cmpeq_epi32_mask(_mm512_and_si512(x, high), high);
+  auto d = _mm512_and_si512(_mm512_srli_epi32(x, 16), _mm512_set1_epi32(0x8000));
+  d = _mm512_mask_or_epi32(d, up, d, _mm512_set1_epi32(0x80));
+  return _mm512_mask_mov_epi32(r, denorm, d);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+cvi_bf16_round_avx2(__m256i x, bool is_tpu) {
+  if (!is_tpu) {
+    return _mm256_srli_epi32(x, 16);
+  }
+  auto lsb = _mm256_and_si256(_mm256_srli_epi32(x, 16), _mm256_set1_epi32(1));
+  auto bias = _mm256_add_epi32(_mm256_set1_epi32(0x7fff), lsb);
+  auto r = _mm256_srli_epi32(_mm256_add_epi32(x, bias), 16);
+  auto exp_mask = _mm256_set1_epi32(0x7f80);
+  auto inf = _mm256_cmpeq_epi32(_mm256_and_si256(r, exp_mask), exp_mask);
+  return _mm256_blendv_epi8(r, _mm256_set1_epi32(0x7f7f), inf);
+}
+
+__attribute__((target("avx512f"))) static inline __m512i
+cvi_bf16_round_avx512(__m512i x, bool is_tpu) {
+  if (!is_tpu) {
+    return _mm512_srli_epi32(x, 16);
+  }
+  auto lsb = _mm512_and_si512(_mm512_srli_epi32(x, 16), _mm512_set1_epi32(1));
+  auto bias = _mm512_add_epi32(_mm512_set1_epi32(0x7fff), lsb);
+  auto r = _mm512_srli_epi32(_mm512_add_epi32(x, bias), 16);
+  auto exp_mask = _mm512_set1_epi32(0x7f80);
+  auto inf = _mm512_cmpeq_epi32_mask(_mm512_and_si512(r, exp_mask), exp_mask);
+  return _mm512_mask_mov_epi32(r, inf, _mm512_set1_epi32(0x7f7f));
+}
+
+// 8 x u32 (< 0x10000) => 8 x u16
+__attribute__((target("avx2"))) static inline __m128i pack_u16_avx2(__m256i x) {
+  return _mm_packus_epi32(_mm256_castsi256_si128(x),
+                          _mm256_extracti128_si256(x, 1));
+}
+
+__attribute__((target("avx2,f16c"))) static inline __m128i
+f16_round_avx2(__m256 x) {
+  auto h = _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  auto nan = _mm256_castps_si256(_mm256_cmp_ps(x, x, _CMP_UNORD_Q));
+  auto nan16 = pack_u16_avx2(_mm256_srli_epi32(nan, 16));
+  return _mm_blendv_epi8(h, _mm_set1_epi16(0x7fff), nan16);
+}
+
+__attribute__((target("avx2,f16c"))) static inline __m256
+f16_widen_avx2(__m128i h) {
+  auto y = _mm256_cvtph_ps(h);
+  auto nan = _mm256_cmp_ps(y, y, _CMP_UNORD_Q);
+  return _mm256_blendv_ps(y, _mm256_castsi256_ps(_mm256_set1_epi32(0xFFC00000)),
+                          nan);
+}
+
+__attribute__((target("avx512f"))) static inline __m512
+f16_round_trip_avx512(__m512 x) {
+  auto h = _mm512_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  auto y = _mm512_cvtph_ps(h);
+  // input nan => 0x7fff => 0xFFC00000, as f16 nan
+  auto nan = _mm512_cmp_ps_mask(x, x, _CMP_UNORD_Q);
+  return _mm512_mask_mov_ps(y, nan,
+                            _mm512_castsi512_ps(_mm512_set1_epi32(0xFFC00000)));
+}
+
+__attribute__((target("avx2"))) static void
+f32_to_bf16_avx2(const float *src, float *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    auto x = _mm256_loadu_si256((const __m256i *)(src + i));
+    auto r = _mm256_slli_epi32(bf16_round_avx2(x), 16);
+    _mm256_storeu_si256((__m256i *)(dst + i), r);
+  }
+  for (; i < num; i++) {
+    dst[i] = bf16_to_f32(f32_to_bf16(src[i]));
+  }
+}
+
+__attribute__((target("avx512f"))) static void
+f32_to_bf16_avx512(const float *src, float *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    auto x = _mm512_loadu_si512(src + i);
+    _mm512_storeu_si512(dst + i, _mm512_slli_epi32(bf16_round_avx512(x), 16));
+  }
+  for (; i < num; i++) {
+    dst[i] = bf16_to_f32(f32_to_bf16(src[i]));
+  }
+}
+
+__attribute__((target("avx2,f16c"))) static void
+f32_to_f16_avx2(const float *src, float *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    auto h = f16_round_avx2(_mm256_loadu_ps(src + i));
+    _mm256_storeu_ps(dst + i, f16_widen_avx2(h));
+  }
+  for (; i < num; i++) {
+    dst[i] = f16_to_f32(f32_to_f16(src[i]));
+  }
+}
+
+__attribute__((target("avx512f"))) static void
+f32_to_f16_avx512(const float *src, float *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    _mm512_storeu_ps(dst + i, f16_round_trip_avx512(_mm512_loadu_ps(src + i)));
+  }
+  for (; i < num; i++) {
+    dst[i] = f16_to_f32(f32_to_f16(src[i]));
+  }
+}
+
+__attribute__((target("avx2"))) static void
+f32_to_bf16_u16_avx2(const float *src, uint16_t *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    auto x = _mm256_loadu_si256((const __m256i *)(src + i));
+    _mm_storeu_si128((__m128i *)(dst + i), pack_u16_avx2(bf16_round_avx2(x)));
+  }
+  for (; i < num; i++) {
+    dst[i] = f32_to_bf16(src[i]);
+  }
+}
+
+__attribute__((target("avx2,f16c"))) static void
+f32_to_f16_u16_avx2(const float *src, uint16_t *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    _mm_storeu_si128((__m128i *)(dst + i),
+                     f16_round_avx2(_mm256_loadu_ps(src + i)));
+  }
+  for (; i < num; i++) {
+    dst[i] = f32_to_f16(src[i]);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+bf16_to_f32_avx2(const uint16_t *src, float *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    auto h = _mm_loadu_si128((const __m128i *)(src + i));
+    auto x = _mm256_slli_epi32(_mm256_cvtepu16_epi32(h), 16);
+    _mm256_storeu_si256((__m256i *)(dst + i), x);
+  }
+  for (; i < num; i++) {
+    dst[i] = bf16_to_f32(src[i]);
+  }
+}
+
+__attribute__((target("avx2,f16c"))) static void
+f16_to_f32_avx2(const uint16_t *src, float *dst, int64_t num) {
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    auto h = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm256_storeu_ps(dst + i, f16_widen_avx2(h));
+  }
+  for (; i < num; i++) {
+    dst[i] = f16_to_f32(src[i]);
+  }
+}
+
+__attribute__((target("avx2"))) static void
+cvi_f32_to_bf16_avx2(const float *src, float *dst, int64_t num, bool is_tpu) {
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    auto x = _mm256_loadu_si256((const __m256i *)(src + i));
+    auto r = _mm256_slli_epi32(cvi_bf16_round_avx2(x, is_tpu), 16);
+    _mm256_storeu_si256((__m256i *)(dst + i), r);
+  }
+  for (; i < num; i++) {
+    dst[i] = cvi_f32_to_bf16(src[i], is_tpu);
+  }
+}
+
+__attribute__((target("avx512f"))) static void
+cvi_f32_to_bf16_avx512(const float *src, float *dst, int64_t num,
+                       bool is_tpu) {
+  int64_t i = 0;
+  for (; i + 16 <= num; i += 16) {
+    auto x = _mm512_loadu_si512(src + i);
+    auto r = _mm512_slli_epi32(cvi_bf16_round_avx512(x, is_tpu), 16);
+    _mm512_storeu_si512(dst + i, r);
+  }
+  for (; i < num; i++) {
+    dst[i] = cvi_f32_to_bf16(src[i], is_tpu);
+  }
+}
+
+// cvi(cvi(src + zero_point, zero_point != 0) * scale), scale is bf16 already
+__attribute__((target("avx2"))) static void
+cvi_int8_to_bf16_avx2(const float *src, float *dst, int64_t num, float scale,
+                      int zero_point) {
+  auto zp = _mm256_set1_ps((float)zero_point);
+  auto s = _mm256_set1_ps(scale);
+  int64_t i = 0;
+  for (; i + 8 <= num; i += 8) {
+    auto x = _mm256_add_ps(_mm256_loadu_ps(src + i), zp);
+    auto r = _mm256_slli_epi32(
+        cvi_bf16_round_avx2(_mm256_castps_si256(x), zero_point != 0), 16);
+    auto y = _mm256_mul_ps(_mm256_castsi256_ps(r), s);
+    r = _mm256_slli_epi32(cvi_bf16_round_avx2(_mm256_castps_si256(y), true),
+                          16);
+    _mm256_storeu_si256((__m256i *)(dst + i), r);
+  }
+  for (; i < num; i++) {
+    dst[i] = cvi_f32_to_bf16(
+        cvi_f32_to_bf16(src[i] + zero_point, (zero_point != 0)) * scale);
+  }
+}
+#endif // FLOAT16_X86_SIMD
+
 void f32_to_f16(float *p_src, float *p_dst, int num) {
+#ifdef FLOAT16_X86_SIMD
+  if (simd_level() == SIMD_AVX512) {
+    parallel_convert(p_src, p_dst, num, f32_to_f16_avx512);
+    return;
+  } else if (simd_level() == SIMD_AVX2) {
+    parallel_convert(p_src, p_dst, num, f32_to_f16_avx2);
+    return;
+  }
+#endif
 #pragma omp parallel for schedule(static, omp_schedule(num))
   for (int i = 0; i < num; i++) {
     uint16_t tmp = f32_to_f16(p_src[i]);
@@ -744,6 +1045,15 @@ void f32_to_f16(float *p_src, float *p_dst, int num) {
 }
 
 void f32_to_bf16(float *p_src, float *p_dst, int num) {
+#ifdef FLOAT16_X86_SIMD
+  if (simd_level() == SIMD_AVX512) {
+    parallel_convert(p_src, p_dst, num, f32_to_bf16_avx512);
+    return;
+  } else if (simd_level() == SIMD_AVX2) {
+    parallel_convert(p_src, p_dst, num, f32_to_bf16_avx2);
+    return;
+  }
+#endif
 #pragma omp parallel for schedule(static, omp_schedule(num))
   for (int i = 0; i < num; i++) {
     uint16_t tmp = f32_to_bf16(p_src[i]);
@@ -751,6 +1061,58 @@ void f32_to_bf16(float *p_src, float *p_dst, int num) {
   }
 }
 
+void f32_to_f16(const float *p_src, uint16_t *p_dst, int64_t num) {
+#ifdef FLOAT16_X86_SIMD
+  if (simd_level() != SIMD_NONE) {
+    parallel_convert(p_src, p_dst, num, f32_to_f16_u16_avx2);
+    return;
+  }
+#endif
+#pragma omp parallel for schedule(static, omp_schedule(num))
+  for (int64_t i = 0; i < num; i++) {
+    p_dst[i] = f32_to_f16(p_src[i]);
+  }
+}
+
+void f32_to_bf16(const float *p_src, uint16_t *p_dst, int64_t num) {
+#ifdef FLOAT16_X86_SIMD
+  if (simd_level() != SIMD_NONE) {
+    parallel_convert(p_src, p_dst, num, f32_to_bf16_u16_avx2);
+    return;
+  }
+#endif
+#pragma omp parallel for schedule(static, omp_schedule(num))
+  for (int64_t i = 0; i < num; i++) {
+    p_dst[i] = f32_to_bf16(p_src[i]);
+  }
+}
+
+void f16_to_f32(const uint16_t *p_src, float *p_dst, int64_t num) {
+#ifdef FLOAT16_X86_SIMD
+  if (simd_level() != SIMD_NONE) {
+    parallel_convert(p_src, p_dst, num, f16_to_f32_avx2);
+    return;
+  }
+#endif
+#pragma omp parallel for schedule(static, omp_schedule(num))
+  for (int64_t i = 0; i < num; i++) {
+    p_dst[i] = f16_to_f32(p_src[i]);
+  }
+}
+
+void bf16_to_f32(const uint16_t *p_src, float *p_dst, int64_t num) {
+#ifdef FLOAT16_X86_SIMD
+  if (simd_level() != SIMD_NONE) {
+    parallel_convert(p_src, p_dst, num, bf16_to_f32_avx2);
+    return;
+  }
+#endif
+#pragma omp parallel for schedule(static, omp_schedule(num))
+  for (int64_t i = 0; i < num; i++) {
+    p_dst[i] = bf16_to_f32(p_src[i]);
+  }
+}
+
 /*
 for cv18xx
 */
@@ -799,6 +1161,21 @@ float cvi_f32_to_bf16(float src, bool is_tpu) {
 
 void cvi_f32_to_bf16(float *p_src, float *p_dst, int num,
                     bool is_tpu) {
+#ifdef FLOAT16_X86_SIMD
+  auto kernel512 = [is_tpu](const float *src, float *dst, int64_t n) {
+    cvi_f32_to_bf16_avx512(src, dst, n, is_tpu);
+  };
+  auto kernel256 = [is_tpu](const float *src, float *dst, int64_t n) {
+    cvi_f32_to_bf16_avx2(src, dst, n, is_tpu);
+  };
+  if (simd_level() == SIMD_AVX512) {
+    parallel_convert(p_src, p_dst, num, kernel512);
+    return;
+  } else if (simd_level() == SIMD_AVX2) {
+    parallel_convert(p_src, p_dst, num, kernel256);
+    return;
+  }
+#endif
 #pragma omp parallel for schedule(static, omp_schedule(num))
   for (int i = 0; i < num; i++) {
     p_dst[i] = cvi_f32_to_bf16(p_src[i], is_tpu);
@@ -812,6 +1189,15 @@ void cvi_int8_to_bf16(float *p_src, float *p_dst,
   if (is_tpu) {
     scale = cvi_f32_to_bf16(scale);
     zero_point = cvi_f32_to_bf16(zero_point);
+#ifdef FLOAT16_X86_SIMD
+    if (simd_level() != SIMD_NONE) {
+      parallel_convert(p_src, p_dst, num,
+                       [=](const float *src, float *dst, int64_t n) {
+                         cvi_int8_to_bf16_avx2(src, dst, n, scale, zero_point);
+                       });
+      return;
+    }
+#endif
 #pragma omp parallel for schedule(static, omp_schedule(num))
     for (int i = 0; i < num; i++) {
         p_dst[i] = cvi_f32_to_bf16(
@@ -347,6 +347,18 @@ bool Module::isOpInGroup(Operation *Op) {
   return false;
 }
 
+bool Module::isMergedWeight(top::WeightOp op) {
+  return op->hasAttr(Attr::MERGED_HASH);
+}
+
+bool Module::isMergedWeight(top::WeightOp a, top::WeightOp b) {
+  auto hash_a = a->getAttrOfType<IntegerAttr>(Attr::MERGED_HASH);
+  auto hash_b = b->getAttrOfType<IntegerAttr>(Attr::MERGED_HASH);
+  return hash_a && hash_a == hash_b &&
+         a.output().getType() == b.output().getType() &&
+         getName(a.getOperation()) == getName(b.getOperation());
+}
+
 FuncOp Module::getFuncOp(ModuleOp module, StringRef func_name) {
   for (auto func : module.getOps<FuncOp>()) {
     if (func.getName() == func_name) {
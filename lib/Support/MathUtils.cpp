@@ -16,6 +16,11 @@
 #include "llvm/Support/Debug.h"
 #include <map>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MATHUTILS_X86_SIMD
+#endif
+
 #define DEBUG_TYPE "math_utils"
 namespace tpu_mlir {
 
@@ -594,6 +599,41 @@ void pad_tensor_for_deconv(float *p_after_pad, float *src, int n, int c, int d,
   }
 }
 
+void pad_tensor_interior(float *p_after_pad, float *src, int n, int c, int d,
+                         int h, int w, int od, int oh, int ow,
+                         const int start[3], const int stride[3],
+                         const int end[3]) {
+  // valid range of src w
+  int w_begin = 0, w_end = w;
+  while (w_begin < w && start[2] + w_begin * stride[2] < 0)
+    w_begin++;
+  while (w_end > w_begin && start[2] + (w_end - 1) * stride[2] >= end[2])
+    w_end--;
+  if (w_begin >= w_end)
+    return;
+  int64_t rows = (int64_t)n * c * d * h;
+#pragma omp parallel for schedule(static, omp_schedule(rows))
+  for (int64_t r = 0; r < rows; r++) {
+    int j = r % h;
+    int m = r / h % d;
+    int64_t i = r / h / d;
+    int dm = start[0] + m * stride[0];
+    int dj = start[1] + j * stride[1];
+    if (dm < 0 || dm >= end[0] || dj < 0 || dj >= end[1])
+      continue;
+    float *src_row = src + r * w;
+    float *dst_row = p_after_pad + ((i * od + dm) * oh + dj) * ow;
+    if (stride[2] == 1) {
+      memcpy(dst_row + start[2] + w_begin, src_row + w_begin,
+             (w_end - w_begin) * sizeof(float));
+    } else {
+      for (int k = w_begin; k < w_end; k++) {
+        dst_row[start[2] + k * stride[2]] = src_row[k];
+      }
+    }
+  }
+}
+
 void tensor_sub_zp(float *tensor_after_zp, float *src, int64_t length,
                    float zero_point) {
 #pragma omp parallel for schedule(static, omp_schedule(length))
@@ -602,6 +642,67 @@ void tensor_sub_zp(float *tensor_after_zp, float *src, int64_t length,
   }
 }
 
+// repeat each of src[0, w) scale times into dst
+static inline void repeat_row(float *dst, const float *src, int64_t w,
+                              int64_t scale) {
+  if (scale == 1) {
+    memcpy(dst, src, w * sizeof(float));
+    return;
+  }
+  int64_t i = 0;
+#ifdef MATHUTILS_X86_SIMD
+  if (scale == 2) {
+    for (; i + 4 <= w; i += 4) {
+      __m128 v = _mm_loadu_ps(src + i);
+      _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(v, v));
+      _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(v, v));
+    }
+  }
+#endif
+  for (; i < w; i++) {
+    std::fill_n(dst + i * scale, scale, src[i]);
+  }
+}
+
+void upsample_nearest(float *dst, const float *src, int64_t planes, int64_t h,
+                      int64_t w, int64_t scale_h, int64_t scale_w) {
+  int64_t rows = planes * h;
+  int64_t ow = w * scale_w;
+#pragma omp parallel for schedule(static, omp_schedule(rows))
+  for (int64_t r = 0; r < rows; r++) {
+    // fill the first output row, then copy it to the other scale_h - 1 rows
+    float *dst_row = dst + r * scale_h * ow;
+    repeat_row(dst_row, src + r * w, w, scale_w);
+    for (int64_t i = 1; i < scale_h; i++) {
+      memcpy(dst_row + i * ow, dst_row, ow * sizeof(float));
+    }
+  }
+}
+
+void gather_inner(float *dst, const float *src, const float *indices,
+                  int64_t num_indices, int64_t outer, int64_t axis_dim,
+                  int64_t inner) {
+  for (int64_t j = 0; j < num_indices; j++) {
+    int64_t idx = (int64_t)indices[j];
+    if (idx < -axis_dim || idx >= axis_dim) {
+      llvm::errs() << "gather index " << idx << " out of range [" << -axis_dim
+                   << ", " << axis_dim << ")\n";
+      llvm_unreachable("gather index out of range");
+    }
+  }
+  int64_t blocks = outer * num_indices;
+#pragma omp parallel for schedule(static, omp_schedule(blocks))
+  for (int64_t b = 0; b < blocks; b++) {
+    int64_t i = b / num_indices;
+    int64_t idx = (int64_t)indices[b % num_indices];
+    if (idx < 0) {
+      idx += axis_dim;
+    }
+    memcpy(dst + b * inner, src + (i * axis_dim + idx) * inner,
+           inner * sizeof(float));
+  }
+}
+
 int omp_schedule(int count) {
   return (count + omp_get_num_threads() - 1) / omp_get_num_threads();
 }
@@ -13,12 +13,19 @@
 #include "tpu_mlir/Dialect/Tpu/IR/TpuOps.h"
 #include "tpu_mlir/Support/Helper/Quant.h"
 #include "tpu_mlir/Support/Helper/Module.h"
+#include "tpu_mlir/Interfaces/FlopsInterface.h"
 
 #include "mlir/Dialect/Func/IR/FuncOps.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <numeric>
+#include <thread>
 
 using namespace mlir;
 using namespace mlir::func;
@@ -43,14 +50,146 @@ ModuleInterpreter::~ModuleInterpreter() {
   }
 }
 
+static bool isViewOp(Operation *op) {
+  return isa<top::ReshapeOp, top::SqueezeOp, tpu::ReshapeOp, tpu::SqueezeOp>(
+      op);
+}
+
+// slice is a contiguous part of the input if it only cuts the outermost
+// non-unit axis with step 1; return the offset in elements, or -1
+static int64_t sliceViewOffset(Operation *op) {
+  if (!isa<top::SliceOp, tpu::SliceOp>(op)) {
+    return -1;
+  }
+  auto offset = Module::getI64Array(op->getAttrOfType<ArrayAttr>("offset"));
+  auto steps = Module::getI64Array(op->getAttrOfType<ArrayAttr>("steps"));
+  auto in_shape = Module::getShape(op->getOperand(0));
+  auto out_shape = Module::getShape(op->getResult(0));
+  if (in_shape.size() != out_shape.size()) {
+    return -1;
+  }
+  int64_t num_dims = in_shape.size();
+  int64_t axis = 0;
+  while (axis < num_dims - 1 && in_shape[axis] == 1) {
+    axis++;
+  }
+  int64_t inner = 1;
+  for (int64_t i = num_dims - 1; i >= 0; i--) {
+    if (steps->at(i) != 1) {
+      return -1;
+    }
+    if (i != axis && (offset->at(i) != 0 || in_shape[i] != out_shape[i])) {
+      return -1;
+    }
+    if (i > axis) {
+      inner *= in_shape[i];
+    }
+  }
+  return offset->at(axis) * inner;
+}
+
+// concat writes contiguous blocks of its inputs if all axes before the
+// concat axis are 1
+static bool isOuterConcat(Operation *op) {
+  int64_t axis;
+  if (auto concat = dyn_cast<top::ConcatOp>(op)) {
+    if (concat.do_relu()) {
+      return false;
+    }
+    axis = concat.axis();
+  } else if (auto concat = dyn_cast<tpu::ConcatOp>(op)) {
+    axis = concat.axis();
+  } else {
+    return false;
+  }
+  auto shape = Module::getShape(op->getResult(0));
+  for (int64_t i = 0; i < axis; i++) {
+    if (shape[i] != 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Decide which tensors can live in the buffer of another tensor: outputs of
+// reshape/squeeze and outer slices are views of the input, and inputs of an
+// outer concat are written by their producers into the concat output.
+// Aliased tensors must have the same element type (including the quant
+// parameters) as their base, so that dequantizing the base converts them.
+void ModuleInterpreter::plan_alias(Operation *func) {
+  auto can_alias = [&](Value from, Value to) {
+    auto op = from.getDefiningOp();
+    return op != nullptr && op->getNumResults() == 1 &&
+           !isa<top::WeightOp, top::NoneOp>(op) &&
+           Module::getElementType(from) == Module::getElementType(to);
+  };
+  func->walk([&](Operation *op) {
+    if (op->getNumResults() != 1 || op->getNumOperands() == 0 ||
+        !isa<InferenceInterface>(op)) {
+      return;
+    }
+    auto out = op->getResult(0);
+    auto name = Module::getName(op).str();
+    auto in = op->getOperand(0);
+    if (isViewOp(op) || sliceViewOffset(op) >= 0) {
+      if (can_alias(in, out)) {
+        int64_t offset = isViewOp(op) ? 0 : sliceViewOffset(op);
+        alias_map[Module::getName(out).str()] = {Module::getName(in).str(),
+                                                 offset};
+        alias_ops.insert(name);
+      }
+      return;
+    }
+    if (!isOuterConcat(op)) {
+      return;
+    }
+    // find the tensor really computed for each input, through views
+    std::vector<Value> producers;
+    std::set<std::string> producer_names;
+    for (auto v : op->getOperands()) {
+      while (v.getDefiningOp() && isViewOp(v.getDefiningOp()) &&
+             alias_ops.count(Module::getName(v.getDefiningOp()).str())) {
+        v = v.getDefiningOp()->getOperand(0);
+      }
+      auto v_name = Module::getName(v).str();
+      if (!can_alias(v, out) || alias_map.count(v_name) ||
+          producer_names.count(v_name)) {
+        return;
+      }
+      producers.push_back(v);
+      producer_names.insert(v_name);
+    }
+    int64_t offset = 0;
+    auto out_name = Module::getName(out).str();
+    for (auto v : producers) {
+      alias_map[Module::getName(v).str()] = {out_name, offset};
+      offset += Module::getNumElements(v);
+    }
+    alias_ops.insert(name);
+  });
+}
+
+float *ModuleInterpreter::tensor_data(const std::string &name) {
+  auto it = alias_map.find(name);
+  if (it != alias_map.end()) {
+    auto base = tensor_data(it->second.base);
+    return base == nullptr ? nullptr : base + it->second.offset;
+  }
+  auto mem = mem_map.find(name);
+  return mem == mem_map.end() ? nullptr : mem->second->data();
+}
+
 void ModuleInterpreter::allocate_resources() {
   all_tensor_names.clear();
   value_map.clear();
   mem_map.clear();
+  alias_map.clear();
+  alias_ops.clear();
   for (auto func : module.getOps<FuncOp>()) {
     // if (func.getName() != "main") {
     //   continue;
     // }
+    plan_alias(func);
     // alloce buffer for all value
     func.walk([&](Operation *op) {
       if (op == func.getOperation() || isa<top::NoneOp>(op)) {
@@ -67,10 +206,15 @@ void ModuleInterpreter::allocate_resources() {
           auto name = Module::getName(result).str();
           value_map[name] = result;
           if (auto wOp = llvm::dyn_cast<top::WeightOp>(op)) {
-            mem_map[name] = wOp.read_as_float();
-            all_weight_names.push_back(name);
+            // weights merged by merge-weight share the name and data
+            if (mem_map.count(name) == 0) {
+              mem_map[name] = wOp.read_as_float();
+              all_weight_names.push_back(name);
+            }
           } else {
-            mem_map[name] = std::make_shared<std::vector<float>>(count);
+            if (alias_map.count(name) == 0) {
+              mem_map[name] = std::make_shared<std::vector<float>>(count);
+            }
             all_tensor_names.push_back(name);
           }
           if (isa<top::InputOp>(op)) {
@@ -94,7 +238,7 @@ void ModuleInterpreter::allocate_resources() {
         auto param = std::make_shared<InferenceParameter>();
         for (auto result: op->getResults()) {
           auto o_name = Module::getName(result).str();
-          param->outputs.push_back(mem_map[o_name]->data());
+          param->outputs.push_back(tensor_data(o_name));
         }
         for (auto input : op->getOperands()) {
           if (input.getType().isa<NoneType>()) {
@@ -102,11 +246,12 @@ void ModuleInterpreter::allocate_resources() {
             continue;
           }
           auto input_name = Module::getName(input).str();
-          if (mem_map.find(input_name) == mem_map.end()) {
+          auto input_data = tensor_data(input_name);
+          if (input_data == nullptr) {
             input.dump();
             llvm_unreachable("input operands not allocated");
           } else {
-            param->inputs.push_back(mem_map[input_name]->data());
+            param->inputs.push_back(input_data);
           }
         }
         if (failed(infer_op.init(*param))) {
@@ -153,14 +298,29 @@ void ModuleInterpreter::invoke(bool express_type) {
   for (auto func : module.getOps<FuncOp>()) {
     func.walk([&](InferenceInterface infer_op) {
       auto name = Module::getName(infer_op.getOperation()).str();
+      if (alias_ops.count(name)) {
+        return;
+      }
+      // no clock read when profile is off
+      std::chrono::steady_clock::time_point start;
+      if (profile_enabled) {
+        start = std::chrono::steady_clock::now();
+      }
       if (failed(infer_op.inference(*inference_map[name]))) {
         infer_op.dump();
         llvm_unreachable("invoke failed!!");
       }
+      if (profile_enabled) {
+        record_profile(name, start, std::chrono::steady_clock::now());
+      }
     });
   }
   if (express_type && state == Module::State::TPU_LOWERED) {
     for (auto &name : all_tensor_names) {
+      if (alias_map.count(name)) {
+        // converted with its base
+        continue;
+      }
       auto mem = mem_map.at(name);
       auto value = value_map.at(name);
       if (Quant::isUniformQuantized(value)) {
@@ -189,7 +349,8 @@ ModuleInterpreter::invoke_at(const std::string op_name) {
     llvm_unreachable("invoke_at infer error");
   }
   auto infer_op = cast<InferenceInterface>(op);
-  if (failed(infer_op.inference(*inference_map[op_name]))) {
+  if (alias_ops.count(Module::getName(op).str()) == 0 &&
+      failed(infer_op.inference(*inference_map[op_name]))) {
     infer_op.dump();
     llvm_unreachable("infer_op.inference failed!!");
   }
@@ -197,35 +358,308 @@ ModuleInterpreter::invoke_at(const std::string op_name) {
   return getTensor(op_name);
 }
 
+void ModuleInterpreter::invoke_dataset(const InputProducer &producer,
+                                       const OutputConsumer &consumer,
+                                       int prefetch) {
+  prefetch = std::max(prefetch, 1);
+  std::vector<InputSample> samples(prefetch);
+  // slots of samples; ready keeps the order of the dataset
+  std::deque<int> free_slots, ready_slots;
+  for (int i = 0; i < prefetch; i++) {
+    free_slots.push_back(i);
+  }
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool end = false;  // producer has no more samples
+  bool stop = false; // consumer needs no more samples
+  std::thread worker([&]() {
+    while (true) {
+      int slot;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return stop || !free_slots.empty(); });
+        if (stop) {
+          return;
+        }
+        slot = free_slots.front();
+        free_slots.pop_front();
+      }
+      bool ok = producer(samples[slot]);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ok) {
+        ready_slots.push_back(slot);
+      } else {
+        end = true;
+      }
+      cond.notify_all();
+      if (!ok) {
+        return;
+      }
+    }
+  });
+  for (int64_t idx = 0;; idx++) {
+    int slot;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return end || !ready_slots.empty(); });
+      if (ready_slots.empty()) {
+        break;
+      }
+      slot = ready_slots.front();
+      ready_slots.pop_front();
+    }
+    for (auto &it : samples[slot]) {
+      setTensor(it.first, it.second.data(), it.second.size() * sizeof(float));
+    }
+    invoke();
+    bool next = consumer(idx);
+    std::lock_guard<std::mutex> lock(mutex);
+    free_slots.push_back(slot);
+    if (!next) {
+      stop = true;
+    }
+    cond.notify_all();
+    if (stop) {
+      break;
+    }
+  }
+  worker.join();
+}
+
+void ModuleInterpreter::collect_statistics(ActivationStatistics &stats) {
+  for (auto &name : all_tensor_names) {
+    auto count = Module::getNumElements(value_map.at(name));
+    stats.update(name, tensor_data(name), count);
+  }
+}
+
+void ModuleInterpreter::add_reference(ModuleInterpreter &fp32) {
+  references.emplace_back();
+  auto &ref = references.back();
+  for (auto &name : all_tensor_names) {
+    if (alias_map.count(name)) {
+      // stored in its base, see reference_data
+      continue;
+    }
+    auto data = fp32.tensor_data(name);
+    if (data == nullptr) {
+      llvm::errs() << "Can't find reference tensor: " << name << "\n";
+      llvm_unreachable("Error, add_reference failed");
+    }
+    auto count = Module::getNumElements(value_map.at(name));
+    ref[name].assign(data, data + count);
+  }
+}
+
+const float *ModuleInterpreter::reference_data(const Reference &ref,
+                                               const std::string &name) {
+  auto it = alias_map.find(name);
+  if (it != alias_map.end()) {
+    auto base = reference_data(ref, it->second.base);
+    return base == nullptr ? nullptr : base + it->second.offset;
+  }
+  auto r = ref.find(name);
+  return r == ref.end() ? nullptr : r->second.data();
+}
+
+const ModuleInterpreter::TunePlan &
+ModuleInterpreter::tune_plan(const std::map<std::string, double> &fake_quant,
+                             const std::string &target) {
+  std::set<std::string> sources;
+  for (auto &it : fake_quant) {
+    sources.insert(it.first);
+  }
+  auto key = std::make_pair(sources, target);
+  auto it = tune_plans.find(key);
+  if (it != tune_plans.end()) {
+    return it->second;
+  }
+  if (value_map.count(target) == 0) {
+    llvm::errs() << "Can't find op:" << target << "\n";
+    llvm_unreachable("eval_fake_quant target error");
+  }
+  // ancestors of target
+  auto target_op = value_map.at(target).getDefiningOp();
+  std::set<Operation *> ancestors;
+  std::vector<Operation *> stack = {target_op};
+  while (!stack.empty()) {
+    auto op = stack.back();
+    stack.pop_back();
+    if (op == nullptr || !ancestors.insert(op).second) {
+      continue;
+    }
+    for (auto v : op->getOperands()) {
+      stack.push_back(v.getDefiningOp());
+    }
+  }
+  // Descendants of sources among them. Sources themselves are always fake
+  // quantized references, so their ops are not in the cone, and a target
+  // input downstream of another source is not computed again.
+  TunePlan plan;
+  std::set<std::string> dirty(sources);
+  for (auto func : module.getOps<FuncOp>()) {
+    func.walk([&](InferenceInterface infer_op) {
+      auto op = infer_op.getOperation();
+      if (ancestors.count(op) == 0) {
+        return;
+      }
+      bool is_source = false;
+      for (auto r : op->getResults()) {
+        is_source |= sources.count(Module::getName(r).str()) > 0;
+      }
+      bool is_dirty = op == target_op;
+      for (auto v : op->getOperands()) {
+        is_dirty |= !v.getType().isa<NoneType>() &&
+                    dirty.count(Module::getName(v).str()) > 0;
+      }
+      if (is_source || !is_dirty) {
+        return;
+      }
+      plan.ops.push_back(op);
+      for (auto r : op->getResults()) {
+        dirty.insert(Module::getName(r).str());
+      }
+    });
+  }
+  // tensors read by the cone and not computed in it come from the reference
+  std::set<std::string> inputs;
+  for (auto op : plan.ops) {
+    for (auto v : op->getOperands()) {
+      if (v.getType().isa<NoneType>()) {
+        continue;
+      }
+      auto name = Module::getName(v).str();
+      if (value_map.count(name) &&
+          (sources.count(name) || dirty.count(name) == 0) &&
+          inputs.insert(name).second) {
+        plan.inputs.push_back(name);
+      }
+    }
+  }
+  for (auto &name : sources) {
+    if (inputs.count(name) == 0) {
+      llvm::errs() << name << " does not reach " << target << "\n";
+      llvm_unreachable("eval_fake_quant fake_quant error");
+    }
+  }
+  // fake quantized ones last, as they may share a buffer with another input
+  std::stable_partition(
+      plan.inputs.begin(), plan.inputs.end(),
+      [&](const std::string &name) { return sources.count(name) == 0; });
+  return tune_plans.emplace(key, std::move(plan)).first->second;
+}
+
+// as import_quant_bias in kld_calibrator.py
+static void fake_quantize(const float *src, float *dst, int64_t num,
+                          double threshold) {
+  float scale = 127.0 / threshold;
+#pragma omp parallel for schedule(static)
+  for (int64_t i = 0; i < num; i++) {
+    float v = std::nearbyint(src[i] * scale);
+    dst[i] = std::min(std::max(v, -128.0f), 127.0f) / scale;
+  }
+}
+
+TuneDistance
+ModuleInterpreter::eval_fake_quant(const std::map<std::string, double> &fake_quant,
+                                   const std::string &target) {
+  if (references.empty()) {
+    llvm_unreachable("no reference, add_reference first");
+  }
+  auto &plan = tune_plan(fake_quant, target);
+  TuneDistance dist;
+  for (auto &ref : references) {
+    // inputs of the cone come from the reference, fake quantized or not
+    for (auto &name : plan.inputs) {
+      auto src = reference_data(ref, name);
+      if (src == nullptr) {
+        // weight
+        continue;
+      }
+      auto num = Module::getNumElements(value_map.at(name));
+      auto fq = fake_quant.find(name);
+      if (fq != fake_quant.end()) {
+        fake_quantize(src, tensor_data(name), num, fq->second);
+      } else {
+        memcpy(tensor_data(name), src, num * sizeof(float));
+      }
+    }
+    auto y = reference_data(ref, target);
+    auto x = tensor_data(target);
+    if (y == nullptr) {
+      llvm::errs() << "Can't find reference tensor: " << target << "\n";
+      llvm_unreachable("eval_fake_quant failed!!");
+    }
+    int64_t num = Module::getNumElements(value_map.at(target));
+    if (plan.ops.empty()) {
+      // target is not computed, e.g. input
+      memcpy(x, y, num * sizeof(float));
+    }
+    for (auto op : plan.ops) {
+      auto name = Module::getName(op).str();
+      if (alias_ops.count(name) == 0 &&
+          failed(cast<InferenceInterface>(op).inference(
+              *inference_map[name]))) {
+        op->dump();
+        llvm_unreachable("eval_fake_quant failed!!");
+      }
+    }
+    double xy = 0, xx = 0, yy = 0, diff2 = 0, y1 = 0;
+#pragma omp parallel for schedule(static) reduction(+ : xy, xx, yy, diff2, y1)
+    for (int64_t i = 0; i < num; i++) {
+      double a = std::isnan(x[i]) ? 0 : x[i];
+      double b = std::isnan(y[i]) ? 0 : y[i];
+      xy += a * b;
+      xx += a * a;
+      yy += b * b;
+      diff2 += (b - a) * (b - a);
+      y1 += std::abs(b);
+    }
+    dist.distance += std::sqrt(diff2) / y1;
+    dist.cosine += xy / std::sqrt(xx * yy);
+    dist.sqnr += 10 * std::log10(yy / diff2);
+  }
+  dist.distance /= references.size();
+  dist.cosine /= references.size();
+  dist.sqnr /= references.size();
+  return dist;
+}
+
 void ModuleInterpreter::setTensor(const std::string &name, const void *data,
                                   size_t size, bool is_integer) {
-  auto it = mem_map.find(name);
-  if (it == mem_map.end()) {
+  auto act = tensor_data(name);
+  if (act == nullptr) {
     llvm::errs() << "Can't find op name: " << name << "\n";
     llvm_unreachable("Error, setTensor failed");
   }
-  auto act = it->second;
-  if (act->size() * sizeof(float) != size) {
+  auto value = value_map.at(name);
+  auto count = Module::getNumElements(value);
+  if (count * sizeof(float) != size) {
     llvm::errs() << "Tensor " << name
-                 << " data need size: " << act->size() * sizeof(float)
+                 << " data need size: " << count * sizeof(float)
                  << " , but set size: " << size << "\n";
     llvm_unreachable("Error, setTensor failed");
   }
-  auto value = value_map.at(name);
   if (is_integer == false && Quant::isUniformQuantized(value)) {
     auto qtype = Quant::getUniformQuantizedType(value);
     float *p = (float *)data;
-    for (uint32_t i = 0; i < act->size(); i++) {
+    for (int64_t i = 0; i < count; i++) {
       auto d = p[i] / qtype.getScale() + qtype.getZeroPoint();
-      act->at(i) = qtype.isSigned() ? Quant::to_int8(d) : Quant::to_uint8(d);
+      act[i] = qtype.isSigned() ? Quant::to_int8(d) : Quant::to_uint8(d);
     }
   } else {
-    memcpy(act->data(), data, size);
+    memcpy(act, data, size);
   }
 }
 
 std::shared_ptr<std::vector<float>>
 ModuleInterpreter::getTensor(const std::string &name) {
+  if (alias_map.count(name)) {
+    // copy out of the base buffer
+    auto data = tensor_data(name);
+    auto count = Module::getNumElements(value_map.at(name));
+    return std::make_shared<std::vector<float>>(data, data + count);
+  }
   auto it = mem_map.find(name);
   if (it == mem_map.end()) {
     llvm::errs() << "Can't find op name: " << name << "\n";
@@ -245,4 +679,125 @@ ModuleInterpreter::getTensorShape(const std::string &name) {
   return it->second.getType().cast<RankedTensorType>().getShape();
 }
 
+void ModuleInterpreter::enable_profile(bool enable) {
+  profile_enabled = enable;
+  profiles.clear();
+  profile_idx.clear();
+  trace_events.clear();
+  if (!enable) {
+    return;
+  }
+  profile_start = std::chrono::steady_clock::now();
+  auto mem_bytes = [&](Value v) -> int64_t {
+    if (v.getType().isa<NoneType>()) {
+      return 0;
+    }
+    return Module::getNumElements(v) * sizeof(float);
+  };
+  for (auto func : module.getOps<FuncOp>()) {
+    func.walk([&](InferenceInterface infer_op) {
+      auto op = infer_op.getOperation();
+      OpProfile prof;
+      prof.name = Module::getName(op).str();
+      prof.type = op->getName().getStringRef().str();
+      if (auto flops_op = dyn_cast<FlopsInterface>(op)) {
+        prof.flops = flops_op.getFLOPs();
+      }
+      for (auto v : op->getOperands()) {
+        prof.read_bytes += mem_bytes(v);
+      }
+      for (auto v : op->getResults()) {
+        prof.write_bytes += mem_bytes(v);
+      }
+      profile_idx[prof.name] = profiles.size();
+      profiles.push_back(prof);
+    });
+  }
+}
+
+void ModuleInterpreter::record_profile(
+    const std::string &name, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end) {
+  auto it = profile_idx.find(name);
+  if (it == profile_idx.end()) {
+    return;
+  }
+  auto &prof = profiles[it->second];
+  double dur = std::chrono::duration<double, std::micro>(end - start).count();
+  prof.count++;
+  prof.time_us += dur;
+  // keep the trace bounded when invoked many times, e.g. calibration
+  if (trace_events.size() < MAX_TRACE_EVENTS) {
+    double ts =
+        std::chrono::duration<double, std::micro>(start - profile_start).count();
+    trace_events.push_back({it->second, ts, dur});
+  }
+}
+
+std::vector<OpProfile> ModuleInterpreter::get_profile() {
+  auto sorted = profiles;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const OpProfile &a, const OpProfile &b) {
+                     return a.time_us > b.time_us;
+                   });
+  return sorted;
+}
+
+void ModuleInterpreter::print_profile(llvm::raw_ostream &os) {
+  double total = 0;
+  for (auto &prof : profiles) {
+    total += prof.time_us;
+  }
+  os << llvm::left_justify("name", 40) << " " << llvm::left_justify("type", 20)
+     << llvm::right_justify("count", 9) << llvm::right_justify("time(us)", 13)
+     << llvm::right_justify("ratio", 8) << llvm::right_justify("GFLOPS", 11)
+     << llvm::right_justify("GB/s", 11) << "\n";
+  for (auto &prof : get_profile()) {
+    if (prof.count == 0) {
+      continue;
+    }
+    double avg_us = prof.time_us / prof.count;
+    double gflops = avg_us > 0 ? prof.flops / avg_us / 1e3 : 0;
+    double gbps =
+        avg_us > 0 ? (prof.read_bytes + prof.write_bytes) / avg_us / 1e3 : 0;
+    os << llvm::format("%-40s %-20s %8ld %12.1f %6.2f%% %10.2f %10.2f\n",
+                       prof.name.c_str(), prof.type.c_str(), prof.count,
+                       prof.time_us, total > 0 ? prof.time_us * 100 / total : 0,
+                       gflops, gbps);
+  }
+  os << llvm::format("total time: %.1f us\n", total);
+}
+
+void ModuleInterpreter::dump_profile_trace(const std::string &filename) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(filename, ec);
+  if (ec) {
+    llvm::errs() << "Can't open file: " << filename << "\n";
+    llvm_unreachable("dump_profile_trace failed");
+  }
+  llvm::json::OStream json(os);
+  json.object([&] {
+    json.attributeArray("traceEvents", [&] {
+      for (auto &event : trace_events) {
+        auto &prof = profiles[event.op_idx];
+        json.object([&] {
+          json.attribute("name", prof.name);
+          json.attribute("cat", prof.type);
+          json.attribute("ph", "X");
+          json.attribute("ts", event.start_us);
+          json.attribute("dur", event.dur_us);
+          json.attribute("pid", 0);
+          json.attribute("tid", 0);
+          json.attributeObject("args", [&] {
+            json.attribute("flops", prof.flops);
+            json.attribute("read_bytes", prof.read_bytes);
+            json.attribute("write_bytes", prof.write_bytes);
+          });
+        });
+      }
+    });
+    json.attribute("displayTimeUnit", "ms");
+  });
+}
+
 } // namespace tpu_mlir
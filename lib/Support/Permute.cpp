@@ -0,0 +1,212 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/Permute.h"
+#include "llvm/Support/ErrorHandling.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define PERMUTE_X86_SIMD
+#endif
+
+namespace tpu_mlir {
+
+// Remove size 1 axes, and merge the axes which stay adjacent after permute,
+// e.g. (2, 3, 4, 5) with order (2, 3, 0, 1) is (6, 20) with order (1, 0).
+static void simplify(const std::vector<int64_t> &shape,
+                     const std::vector<int64_t> &order,
+                     std::vector<int64_t> &new_shape,
+                     std::vector<int64_t> &new_order) {
+  int num_dims = shape.size();
+  std::vector<int64_t> index(num_dims, -1);
+  for (int i = 0; i < num_dims; i++) {
+    if (shape[i] != 1) {
+      index[i] = new_shape.size();
+      new_shape.push_back(shape[i]);
+    }
+  }
+  std::vector<int64_t> squeezed;
+  for (auto o : order) {
+    if (index[o] >= 0) {
+      squeezed.push_back(index[o]);
+    }
+  }
+  // group[i] is the first input axis of the merged axis i
+  std::vector<int64_t> groups;
+  std::vector<int64_t> merged_shape;
+  for (size_t i = 0; i < squeezed.size(); i++) {
+    if (i > 0 && squeezed[i] == squeezed[i - 1] + 1) {
+      merged_shape.back() *= new_shape[squeezed[i]];
+      continue;
+    }
+    groups.push_back(squeezed[i]);
+    merged_shape.push_back(new_shape[squeezed[i]]);
+  }
+  // renumber by the order of input axes
+  std::vector<int64_t> sorted(groups);
+  std::sort(sorted.begin(), sorted.end());
+  new_shape.assign(groups.size(), 0);
+  new_order.assign(groups.size(), 0);
+  for (size_t i = 0; i < groups.size(); i++) {
+    auto axis = std::lower_bound(sorted.begin(), sorted.end(), groups[i]) -
+                sorted.begin();
+    new_order[i] = axis;
+    new_shape[axis] = merged_shape[i];
+  }
+}
+
+// Transpose a rows x cols block: dst[c * dst_stride + r] =
+// src[r * src_stride + c].
+template <typename T>
+static inline void transpose_block(T *dst, const T *src, int64_t rows,
+                                   int64_t cols, int64_t src_stride,
+                                   int64_t dst_stride) {
+  int64_t r = 0;
+#ifdef PERMUTE_X86_SIMD
+  if (sizeof(T) == 4) {
+    for (; r + 4 <= rows; r += 4) {
+      int64_t c = 0;
+      for (; c + 4 <= cols; c += 4) {
+        auto s = reinterpret_cast<const float *>(src + r * src_stride + c);
+        __m128 r0 = _mm_loadu_ps(s);
+        __m128 r1 = _mm_loadu_ps(s + src_stride);
+        __m128 r2 = _mm_loadu_ps(s + 2 * src_stride);
+        __m128 r3 = _mm_loadu_ps(s + 3 * src_stride);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        auto d = reinterpret_cast<float *>(dst + c * dst_stride + r);
+        _mm_storeu_ps(d, r0);
+        _mm_storeu_ps(d + dst_stride, r1);
+        _mm_storeu_ps(d + 2 * dst_stride, r2);
+        _mm_storeu_ps(d + 3 * dst_stride, r3);
+      }
+      for (; c < cols; c++) {
+        for (int64_t i = r; i < r + 4; i++) {
+          dst[c * dst_stride + i] = src[i * src_stride + c];
+        }
+      }
+    }
+  }
+#endif
+  for (; r < rows; r++) {
+    for (int64_t c = 0; c < cols; c++) {
+      dst[c * dst_stride + r] = src[r * src_stride + c];
+    }
+  }
+}
+
+template <typename T>
+static void permute_impl(T *dst, const T *src,
+                         const std::vector<int64_t> &shape,
+                         const std::vector<int64_t> &order) {
+  int num_dims = shape.size();
+  // strides of input axes, in src and in dst
+  std::vector<int64_t> src_stride(num_dims, 1), dst_stride(num_dims, 1);
+  for (int i = num_dims - 2; i >= 0; i--) {
+    src_stride[i] = src_stride[i + 1] * shape[i + 1];
+  }
+  int64_t stride = 1;
+  for (int i = num_dims - 1; i >= 0; i--) {
+    dst_stride[order[i]] = stride;
+    stride *= shape[order[i]];
+  }
+  int64_t total = stride;
+  // the last input axis is contiguous in src, col_axis; the last output axis
+  // is contiguous in dst, row_axis.
+  int col_axis = num_dims - 1;
+  int row_axis = order[num_dims - 1];
+  std::vector<int> outer_axes;
+  for (int i = 0; i < num_dims; i++) {
+    if (i != col_axis && i != row_axis) {
+      outer_axes.push_back(i);
+    }
+  }
+  auto base_of = [&](int64_t idx, int64_t &src_base, int64_t &dst_base) {
+    src_base = dst_base = 0;
+    for (int k = outer_axes.size() - 1; k >= 0; k--) {
+      int axis = outer_axes[k];
+      int64_t sub = idx % shape[axis];
+      idx /= shape[axis];
+      src_base += sub * src_stride[axis];
+      dst_base += sub * dst_stride[axis];
+    }
+  };
+
+  if (row_axis == col_axis) {
+    // the innermost axis is not moved, copy by rows
+    int64_t cols = shape[col_axis];
+    int64_t outer = total / cols;
+#pragma omp parallel for schedule(static)
+    for (int64_t m = 0; m < outer; m++) {
+      int64_t src_base, dst_base;
+      base_of(m, src_base, dst_base);
+      memcpy(dst + dst_base, src + src_base, cols * sizeof(T));
+    }
+    return;
+  }
+
+  // transpose (rows, cols) to (cols, rows) by tiles, so that both src and
+  // dst are accessed in cache lines
+  int64_t rows = shape[row_axis], cols = shape[col_axis];
+  int64_t outer = total / (rows * cols);
+  const int64_t tile = std::max<int64_t>(16, 64 / sizeof(T));
+  int64_t row_tiles = (rows + tile - 1) / tile;
+#pragma omp parallel for collapse(2) schedule(static)
+  for (int64_t m = 0; m < outer; m++) {
+    for (int64_t rt = 0; rt < row_tiles; rt++) {
+      int64_t src_base, dst_base;
+      base_of(m, src_base, dst_base);
+      int64_t r = rt * tile;
+      int64_t cur_rows = std::min(tile, rows - r);
+      for (int64_t c = 0; c < cols; c += tile) {
+        int64_t cur_cols = std::min(tile, cols - c);
+        transpose_block(dst + dst_base + c * dst_stride[col_axis] + r,
+                        src + src_base + r * src_stride[row_axis] + c,
+                        cur_rows, cur_cols, src_stride[row_axis],
+                        dst_stride[col_axis]);
+      }
+    }
+  }
+}
+
+void permute(void *dst, const void *src, const std::vector<int64_t> &shape,
+             const std::vector<int64_t> &order, int word_size) {
+  if (shape.size() != order.size()) {
+    llvm_unreachable("permute order doesn't match shape");
+  }
+  int64_t total = 1;
+  for (auto s : shape) {
+    total *= s;
+  }
+  std::vector<int64_t> new_shape, new_order;
+  simplify(shape, order, new_shape, new_order);
+  if (new_shape.size() <= 1) {
+    memcpy(dst, src, total * word_size);
+    return;
+  }
+  switch (word_size) {
+  case 1:
+    permute_impl((uint8_t *)dst, (const uint8_t *)src, new_shape, new_order);
+    break;
+  case 2:
+    permute_impl((uint16_t *)dst, (const uint16_t *)src, new_shape, new_order);
+    break;
+  case 4:
+    permute_impl((uint32_t *)dst, (const uint32_t *)src, new_shape, new_order);
+    break;
+  case 8:
+    permute_impl((uint64_t *)dst, (const uint64_t *)src, new_shape, new_order);
+    break;
+  default:
+    llvm_unreachable("unsupported word size");
+  }
+}
+
+} // namespace tpu_mlir
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "tpu_mlir/Support/TPUCompressUtil.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
 namespace tpu_mlir {
@@ -17,17 +18,9 @@ namespace tpu_mlir {
 
 typedef struct CompressCommandInfo CommandInfo;
 
-typedef struct
-{
-  uint8_t *stream; // stream buffer pointer
-  int bit_pos;     // current pointer (in bit)
-  int buf_size;    // in byte
-} StreamBuffer;
-
-static inline uint8_t get_bit_val(uint8_t *buf, int byte_idx, int bit_idx)
-{
-    return (buf[byte_idx] >> bit_idx) & 0x1;
-}
+#define HEADER_SIZE 16
+// blocks encoded by one thread into its own bitstream
+#define CHUNK_BLOCKS 1024
 
 static inline uint8_t sign_to_unsign(uint8_t val)
 {
@@ -128,44 +121,119 @@ void getCompressParameter(
 }
 
 // -- streaming operation handler --
-static inline void init_stream(StreamBuffer *bs, uint8_t *buf, int buf_size, bool read_only)
-{
-  bs->bit_pos = 0;
-  bs->stream = (uint8_t *)(buf);
-  bs->buf_size = buf_size;
-  if (!read_only)
-    memset((uint8_t *)buf, 0, sizeof(uint8_t) * buf_size);
-}
+// bits are packed from LSB to MSB, 64 bits at a time
+class BitWriter {
+public:
+  // append the low bit_len bits of val, bit_len <= 64
+  inline void put(uint64_t val, int bit_len) {
+    if (bit_len == 0) {
+      return;
+    }
+    if (bit_len < 64) {
+      val &= (1ull << bit_len) - 1;
+    }
+    acc |= val << nbits;
+    if (nbits + bit_len < 64) {
+      nbits += bit_len;
+      return;
+    }
+    words.push_back(acc);
+    acc = nbits ? val >> (64 - nbits) : 0;
+    nbits = nbits + bit_len - 64;
+  }
 
-static inline void write_stream(StreamBuffer *bs, uint8_t *src, int bit_len)
-{
-  for (int bit = 0; bit < bit_len; bit++)
-  {
-    int src_byte_i = bit / 8;
-    int src_bit_i = bit % 8;
-    int dest_byte_i = (bs->bit_pos + bit) / 8;
-    int dest_bit_i = (bs->bit_pos + bit) % 8;
-    bs->stream[dest_byte_i] |= (get_bit_val(src, src_byte_i, src_bit_i) << dest_bit_i);
+  inline void put_bytes(const uint8_t *src, int bit_len) {
+    for (int bit = 0; bit < bit_len; bit += 64) {
+      uint64_t val = 0;
+      int len = std::min(64, bit_len - bit);
+      memcpy(&val, src + (bit >> 3), (len + 7) >> 3);
+      put(val, len);
+    }
+  }
+
+  void append(const BitWriter &other) {
+    if (nbits == 0) {
+      words.insert(words.end(), other.words.begin(), other.words.end());
+    } else {
+      for (auto w : other.words) {
+        put(w, 64);
+      }
+    }
+    put(other.acc, other.nbits);
+  }
+
+  size_t bit_size() const { return words.size() * 64 + nbits; }
+
+  // copy to dst, which must hold (bit_size() + 7) / 8 bytes
+  void copy_to(uint8_t *dst) const {
+    size_t bytes = words.size() * sizeof(uint64_t);
+    memcpy(dst, words.data(), bytes);
+    memcpy(dst + bytes, &acc, (nbits + 7) >> 3);
+  }
+
+private:
+  std::vector<uint64_t> words;
+  uint64_t acc = 0;
+  int nbits = 0;
+};
+
+class BitReader {
+public:
+  BitReader(const uint8_t *stream, size_t size, size_t bit_pos = 0)
+      : stream(stream), size(size), bit_pos(bit_pos) {}
+
+  // peek up to 56 bits, bits beyond the stream read as 0
+  inline uint64_t peek(int bit_len) const {
+    size_t byte_idx = bit_pos >> 3;
+    uint64_t val = 0;
+    if (byte_idx + 8 <= size) {
+      memcpy(&val, stream + byte_idx, 8);
+    } else if (byte_idx < size) {
+      memcpy(&val, stream + byte_idx, size - byte_idx);
+    }
+    val >>= (bit_pos & 7);
+    return bit_len == 0 ? 0 : val & ((1ull << bit_len) - 1);
   }
-  bs->bit_pos += bit_len;
-}
 
-static inline void move_stream_ptr(StreamBuffer *bs, int bit_len)
+  inline uint64_t get(int bit_len) {
+    auto val = peek(bit_len);
+    bit_pos += bit_len;
+    return val;
+  }
+
+  inline void skip(int bit_len) { bit_pos += bit_len; }
+
+private:
+  const uint8_t *stream;
+  size_t size;
+  size_t bit_pos;
+};
+
+// -- header read/write operation handler --
+static inline void vlc_enc_header(uint8_t *header, CommandInfo *cmd_info, size_t blk_bs_size)
 {
-  bs->bit_pos += bit_len;
+  uint64_t bits = blk_bs_size & 0xFFFFFF;                       // bit[23:0] compressed block stream size
+                                                                // bit[27:24] reserved
+  bits |= (uint64_t)(cmd_info->signedness & 0x1) << 28;         // bit[28] signedness
+  bits |= (uint64_t)(cmd_info->is_bfloat16 & 0x1) << 29;        // bit[29] data type
+                                                                // bit[31:30] bit depth
+  bits |= (uint64_t)cmd_info->bias0 << 32;                      // bit[39:32] bias0 for symbol remapping
+  bits |= (uint64_t)(cmd_info->bias1 & 0x7F) << 40;             // bit[46:40] bias1 for symbol remapping
+  bits |= (uint64_t)(cmd_info->zero_guard_en & 0x1) << 47;      // bit[47] zero guard
+  memset(header, 0, HEADER_SIZE);
+  memcpy(header, &bits, 6);
 }
 
-// -- header read/write operation handler --
-static inline void vlc_enc_header(StreamBuffer *bs_header, CommandInfo *cmd_info, size_t blk_bs_size)
+static inline size_t vlc_dec_header(const uint8_t *header, CommandInfo *cmd_info)
 {
-  write_stream(bs_header, (uint8_t *)&blk_bs_size, 24);            // bit[23:0] compressed block stream size
-  move_stream_ptr(bs_header, 4);                                   // bit[27:24] reserved
-  write_stream(bs_header, (uint8_t *)&cmd_info->signedness, 1);    // bit[28] signedness
-  write_stream(bs_header, (uint8_t *)&cmd_info->is_bfloat16, 1);   // bit[29] data type
-  move_stream_ptr(bs_header, 2);                                   // bit[31:30] bit depth
-  write_stream(bs_header, (uint8_t *)&cmd_info->bias0, 8);         // bit[39:32] bias0 for symbol remapping
-  write_stream(bs_header, (uint8_t *)&cmd_info->bias1, 7);         // bit[46:40] bias1 for symbol remapping
-  write_stream(bs_header, (uint8_t *)&cmd_info->zero_guard_en, 1); // bit[47] zero guard
+  uint64_t bits = 0;
+  memcpy(&bits, header, 6);
+  cmd_info->signedness = (bits >> 28) & 0x1;
+  cmd_info->is_bfloat16 = (bits >> 29) & 0x1;
+  cmd_info->bias0 = (bits >> 32) & 0xFF;
+  cmd_info->bias1 = (bits >> 40) & 0x7F;
+  cmd_info->zero_guard_en = (bits >> 47) & 0x1;
+  return bits & 0xFFFFFF;
 }
 
 // -- symbol remmaping handler --
@@ -289,35 +357,25 @@ static inline int vlc_estimate_block_order(uint8_t *blk_in, bool bf16_zvc_en)
 }
 
 // -- vlc block parrelel GR encode/decode --
-static inline uint8_t vlc_gr_enc_block_data(uint8_t *blk_in, StreamBuffer *bs, int order_k, bool bf16_zvc_en)
+static inline uint8_t vlc_gr_enc_block_data(uint8_t *blk_in, BitWriter *bs, int order_k, bool bf16_zvc_en)
 {
   // uncompressed mode
   if (order_k == -1)
   {
-    write_stream(bs, blk_in, 128);
+    bs->put_bytes(blk_in, 128);
     return 128;
   }
 
-  // remain field
-  uint8_t remain_field[16] = {0};
-  uint8_t unary_field[8] = {0};
-  uint8_t sym_end_pos[16] = {0};
-  uint8_t unary_field_len = 0;
-  int sym_end_pos_accum = -1;
-
   // bit plane encode for remain field
   for (int k = 0; k < order_k; k++)
   {
-    uint8_t bit_plane0 = 0, bit_plane1 = 0;
-    for (int i = 0; i < 8; i++)
+    uint64_t bit_plane = 0;
+    for (int i = 0; i < 16; i++)
     {
-      bit_plane0 |= (get_bit_val(blk_in, i, k) << i);
-      bit_plane1 |= (get_bit_val(blk_in, i + 8, k) << i);
+      bit_plane |= (uint64_t)((blk_in[i] >> k) & 0x1) << i;
     }
-    remain_field[k << 1] = bit_plane0;
-    remain_field[(k << 1) + 1] = bit_plane1;
+    bs->put(bit_plane, 16);
   }
-  write_stream(bs, remain_field, order_k << 4);
 
   if (bf16_zvc_en && order_k > 0)
   {
@@ -328,66 +386,156 @@ static inline uint8_t vlc_gr_enc_block_data(uint8_t *blk_in, StreamBuffer *bs, i
         zero_num++;
     }
     assert(zero_num < 16);
-    write_stream(bs, (uint8_t *)&zero_num, 4);
+    bs->put(zero_num, 4);
   }
 
-  // unary encode for unary field
+  // unary encode for unary field, group_idx zeros ended by one
+  uint64_t unary_field = 0;
+  int unary_field_len = 0;
   for (int i = 0; i < 16; i++)
   {
     int group_idx = blk_in[i] >> order_k;
-    sym_end_pos_accum += (group_idx + 1);
-    sym_end_pos[i] = sym_end_pos_accum;
-    int byte_idx = sym_end_pos[i] / 8;
-    int bit_idx = sym_end_pos[i] % 8;
-    unary_field[byte_idx] |= (1 << (bit_idx));
-  }
-  unary_field_len = sym_end_pos[15] + 1;
-  assert(unary_field_len <= MAX_UNARY_FIELD_SIZE);
+    unary_field_len += group_idx;
+    assert(unary_field_len < MAX_UNARY_FIELD_SIZE);
+    unary_field |= 1ull << unary_field_len;
+    unary_field_len++;
+  }
   uint8_t ulen = (unary_field_len - 16) & 0x1F;
-  write_stream(bs, unary_field, unary_field_len);
+  bs->put(unary_field, unary_field_len);
 
   return ulen;
 }
 
+static inline void vlc_gr_dec_block_data(BitReader *bs, uint8_t *blk_out, uint8_t k_info, bool bf16_zvc_en)
+{
+  int order_k = k_info >> 5;
+  // uncompressed mode
+  if (order_k == 7)
+  {
+    for (int i = 0; i < 16; i++)
+    {
+      blk_out[i] = bs->get(8);
+    }
+    return;
+  }
+
+  uint8_t remain[16] = {0};
+  for (int k = 0; k < order_k; k++)
+  {
+    uint64_t bit_plane = bs->get(16);
+    for (int i = 0; i < 16; i++)
+    {
+      remain[i] |= ((bit_plane >> i) & 0x1) << k;
+    }
+  }
+
+  if (bf16_zvc_en && order_k > 0)
+  {
+    bs->skip(4);
+  }
+
+  int unary_field_len = (k_info & 0x1F) + 16;
+  uint64_t unary_field = bs->get(unary_field_len);
+  for (int i = 0; i < 16; i++)
+  {
+    int group_idx = llvm::countTrailingZeros(unary_field);
+    unary_field >>= (group_idx + 1);
+    blk_out[i] = (group_idx << order_k) | remain[i];
+  }
+}
+
+// size in bits of one encoded block, without reading it
+static inline size_t vlc_gr_block_bits(uint8_t k_info, bool bf16_zvc_en)
+{
+  int order_k = k_info >> 5;
+  if (order_k == 7)
+    return 128;
+  int znum_bit = (bf16_zvc_en && order_k > 0) ? 4 : 0;
+  return (order_k << 4) + znum_bit + (k_info & 0x1F) + 16;
+}
+
+// number of zero symbols in one encoded block, bs points to the block
+static inline int vlc_gr_block_zero_num(const BitReader &bs, uint8_t k_info)
+{
+  int order_k = k_info >> 5;
+  BitReader rd = bs;
+  if (order_k == 7)
+  {
+    int zero_num = 0;
+    for (int i = 0; i < 16; i++)
+    {
+      zero_num += (rd.get(8) == 0);
+    }
+    return zero_num;
+  }
+  if (order_k > 0)
+  {
+    // zero guard is on, so the number is in the stream
+    rd.skip(order_k << 4);
+    return rd.get(4);
+  }
+  // k = 0: a symbol is zero if its one follows the previous one directly
+  uint64_t unary_field = rd.get((k_info & 0x1F) + 16);
+  return llvm::countPopulation(unary_field & ((unary_field << 1) | 1));
+}
+
+// kmap byte of one block, 0xE0 for uncompressed
+static inline uint8_t vlc_k_info(int k, uint8_t ulen)
+{
+  return (k == -1) ? 0xE0 : (k << 5) + ulen;
+}
+
+// finish the stream: header + kmap + 16 byte aligned block stream
+static void vlc_finish_stream(CommandInfo *cmd_info, std::vector<BitWriter> &chunks,
+                              size_t kmap_size, uint8_t *obuf, int *osz)
+{
+  BitWriter bs_data;
+  for (auto &chunk : chunks)
+  {
+    bs_data.append(chunk);
+  }
+  size_t bs_bytes = (bs_data.bit_size() + 7) >> 3;
+  int blk_bs_size = llvm::divideCeil(bs_bytes, 16) << 4; // 16 byte align
+  *osz = HEADER_SIZE + kmap_size + blk_bs_size;
+
+  uint8_t *data = obuf + HEADER_SIZE + kmap_size;
+  bs_data.copy_to(data);
+  memset(data + bs_bytes, 0, blk_bs_size - bs_bytes);
+  vlc_enc_header(obuf, cmd_info, blk_bs_size);
+}
+
 // -- vlc encode int8 entry funtion --
 void compressInt8Data(
     const uint8_t *ibuf, int isz, uint8_t *obuf, int *osz,
     CompressCommandInfo *cmd_info)
 {
-  StreamBuffer bs_header, bs_kmap, bs_data;
   size_t blk_num = (isz + 15) >> 4;
-  size_t header_size = 16;
   size_t kmap_size = llvm::divideCeil(blk_num, 16) << 4;
-  size_t bs_buf_size = header_size + kmap_size + (blk_num << 4);
-  uint8_t *bsbuf = (uint8_t *)calloc(bs_buf_size, sizeof(uint8_t));
-
-  // block encode
-  init_stream(&bs_kmap, bsbuf + header_size, kmap_size, false);
-  init_stream(&bs_data, bsbuf + header_size + kmap_size, blk_num << 4, false);
-
-  for (size_t blk_idx = 0; blk_idx < blk_num; blk_idx++)
+  uint8_t *kmap = obuf + HEADER_SIZE;
+  memset(kmap, 0, kmap_size);
+
+  // blocks are independent, encode chunks of them in parallel
+  int chunk_num = llvm::divideCeil(blk_num, CHUNK_BLOCKS);
+  std::vector<BitWriter> chunks(chunk_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int c = 0; c < chunk_num; c++)
   {
-    uint8_t blk_data[16] = {0}, blk_sr_data[16] = {0};
-    size_t in_size = (blk_idx == (blk_num - 1)) ? isz - (blk_idx << 4) : 16;
-    memcpy(blk_data, &ibuf[blk_idx << 4], sizeof(uint8_t) * in_size);
+    size_t blk_end = std::min(blk_num, (size_t)(c + 1) * CHUNK_BLOCKS);
+    for (size_t blk_idx = (size_t)c * CHUNK_BLOCKS; blk_idx < blk_end; blk_idx++)
+    {
+      uint8_t blk_data[16] = {0}, blk_sr_data[16] = {0};
+      size_t in_size = (blk_idx == (blk_num - 1)) ? isz - (blk_idx << 4) : 16;
+      memcpy(blk_data, &ibuf[blk_idx << 4], sizeof(uint8_t) * in_size);
 
-    symbol_remapping(blk_data, blk_sr_data, cmd_info->bias0, cmd_info->bias1, cmd_info->signedness, false, false);
+      symbol_remapping(blk_data, blk_sr_data, cmd_info->bias0, cmd_info->bias1, cmd_info->signedness, false, false);
 
-    int k = vlc_estimate_block_order(blk_sr_data, false);
-    uint8_t ulen = vlc_gr_enc_block_data(blk_sr_data, &bs_data, k, false);
-    uint8_t k_info = (k == -1) ? 0xE0 : (k << 5) + ulen;
-    write_stream(&bs_kmap, &k_info, 8);
+      int k = vlc_estimate_block_order(blk_sr_data, false);
+      uint8_t ulen = vlc_gr_enc_block_data(blk_sr_data, &chunks[c], k, false);
+      kmap[blk_idx] = vlc_k_info(k, ulen);
+    }
   }
 
-  int blk_bs_size = llvm::divideCeil(((bs_data.bit_pos + 7) >> 3), 16) << 4; // 16 byte align
-  *osz = header_size + kmap_size + blk_bs_size;
-
-  // write header
-  init_stream(&bs_header, bsbuf, header_size, false);
-  vlc_enc_header(&bs_header, cmd_info, blk_bs_size);
-
-  memcpy(obuf, bsbuf, (*osz) * sizeof(uint8_t));
-  free(bsbuf);
+  vlc_finish_stream(cmd_info, chunks, kmap_size, obuf, osz);
 }
 
 // -- vlc encode bfloat16 entry function --
@@ -396,50 +544,129 @@ void compressBf16Data(
     CommandInfo *cmd_info)
 {
   const uint16_t *ibuf16 = (const uint16_t *)ibuf;
-  StreamBuffer bs_header, bs_kmap, bs_data;
   size_t blk_num = (isz + 31) >> 5; // 32 bytes per blok
-  size_t header_size = 16;
   size_t kmap_size = llvm::divideCeil(blk_num, 16) << 4;
-  size_t bs_buf_size = header_size + kmap_size + (blk_num << 5);
-  uint8_t *bsbuf = (uint8_t *)calloc(bs_buf_size, sizeof(uint8_t));
-
-  // block encode
-  init_stream(&bs_kmap, bsbuf + header_size, kmap_size, false);
-  init_stream(&bs_data, bsbuf + header_size + kmap_size, blk_num << 5, false);
+  uint8_t *kmap = obuf + HEADER_SIZE;
+  memset(kmap, 0, kmap_size);
 
-  for (size_t blk_idx = 0; blk_idx < blk_num; blk_idx++)
+  int chunk_num = llvm::divideCeil(blk_num, CHUNK_BLOCKS);
+  std::vector<BitWriter> chunks(chunk_num);
+#pragma omp parallel for schedule(dynamic)
+  for (int c = 0; c < chunk_num; c++)
   {
-    uint8_t blk_data[16] = {0}, blk_sr_data[16] = {0}, blk_data_frac[16] = {0};
-    size_t in_num = (blk_idx == (blk_num - 1)) ? ((isz >> 1) - (blk_idx << 4)) : 16;
-    dispatch_bf16_data(&ibuf16[blk_idx << 4], blk_data, blk_data_frac, in_num);
+    auto &bs_data = chunks[c];
+    size_t blk_end = std::min(blk_num, (size_t)(c + 1) * CHUNK_BLOCKS);
+    for (size_t blk_idx = (size_t)c * CHUNK_BLOCKS; blk_idx < blk_end; blk_idx++)
+    {
+      uint8_t blk_data[16] = {0}, blk_sr_data[16] = {0}, blk_data_frac[16] = {0};
+      size_t in_num = (blk_idx == (blk_num - 1)) ? ((isz >> 1) - (blk_idx << 4)) : 16;
+      dispatch_bf16_data(&ibuf16[blk_idx << 4], blk_data, blk_data_frac, in_num);
 
-    // exp: BGR encode
-    symbol_remapping(blk_data, blk_sr_data, cmd_info->bias0, cmd_info->bias1, false, true, cmd_info->zero_guard_en);
+      // exp: BGR encode
+      symbol_remapping(blk_data, blk_sr_data, cmd_info->bias0, cmd_info->bias1, false, true, cmd_info->zero_guard_en);
 
-    int k = vlc_estimate_block_order(blk_sr_data, cmd_info->zero_guard_en);
-    uint8_t ulen = vlc_gr_enc_block_data(blk_sr_data, &bs_data, k, cmd_info->zero_guard_en);
-    uint8_t k_info = (k == -1) ? 0xE0 : (k << 5) + ulen;
-    write_stream(&bs_kmap, &k_info, 8);
+      int k = vlc_estimate_block_order(blk_sr_data, cmd_info->zero_guard_en);
+      uint8_t ulen = vlc_gr_enc_block_data(blk_sr_data, &bs_data, k, cmd_info->zero_guard_en);
+      kmap[blk_idx] = vlc_k_info(k, ulen);
 
-    // frac: implicit zero compression
-    for (size_t i = 0; i < 16; i++)
-    {
-      if (!cmd_info->zero_guard_en || blk_data[i] != 0)
+      // frac: implicit zero compression
+      for (size_t i = 0; i < 16; i++)
       {
-        write_stream(&bs_data, &blk_data_frac[i], 8);
+        if (!cmd_info->zero_guard_en || blk_data[i] != 0)
+        {
+          bs_data.put(blk_data_frac[i], 8);
+        }
       }
     }
   }
 
-  int blk_bs_size = llvm::divideCeil(((bs_data.bit_pos + 7) >> 3), 16) << 4; // 16 byte align
-  *osz = header_size + kmap_size + blk_bs_size;
+  vlc_finish_stream(cmd_info, chunks, kmap_size, obuf, osz);
+}
+
+// -- vlc decode int8 entry function --
+void decompressInt8Data(
+    const uint8_t *ibuf, int isz, uint8_t *obuf, int osz,
+    CompressCommandInfo *cmd_info)
+{
+  size_t blk_bs_size = vlc_dec_header(ibuf, cmd_info);
+  assert(!cmd_info->is_bfloat16);
+  size_t blk_num = (osz + 15) >> 4;
+  size_t kmap_size = llvm::divideCeil(blk_num, 16) << 4;
+  assert(HEADER_SIZE + kmap_size + blk_bs_size <= (size_t)isz);
+  const uint8_t *kmap = ibuf + HEADER_SIZE;
+  const uint8_t *data = kmap + kmap_size;
+
+  // block offsets come from kmap alone
+  std::vector<size_t> offsets(blk_num + 1, 0);
+  for (size_t blk_idx = 0; blk_idx < blk_num; blk_idx++)
+  {
+    offsets[blk_idx + 1] = offsets[blk_idx] + vlc_gr_block_bits(kmap[blk_idx], false);
+  }
+  assert(offsets[blk_num] <= blk_bs_size * 8);
+
+#pragma omp parallel for schedule(static)
+  for (size_t blk_idx = 0; blk_idx < blk_num; blk_idx++)
+  {
+    uint8_t blk_sr_data[16], blk_data[16];
+    BitReader bs(data, blk_bs_size, offsets[blk_idx]);
+    vlc_gr_dec_block_data(&bs, blk_sr_data, kmap[blk_idx], false);
+    for (int i = 0; i < 16; i++)
+    {
+      blk_data[i] = cmd_info->signedness
+                        ? inv_two_side_circular_shift(unsign_to_sign(blk_sr_data[i]), cmd_info->bias0, cmd_info->bias1)
+                        : blk_sr_data[i];
+    }
+    size_t out_size = (blk_idx == (blk_num - 1)) ? osz - (blk_idx << 4) : 16;
+    memcpy(&obuf[blk_idx << 4], blk_data, out_size);
+  }
+}
+
+// -- vlc decode bfloat16 entry function --
+void decompressBf16Data(
+    const uint8_t *ibuf, int isz, uint8_t *obuf, int osz,
+    CompressCommandInfo *cmd_info)
+{
+  size_t blk_bs_size = vlc_dec_header(ibuf, cmd_info);
+  assert(cmd_info->is_bfloat16);
+  bool zero_guard = cmd_info->zero_guard_en;
+  size_t blk_num = (osz + 31) >> 5;
+  size_t kmap_size = llvm::divideCeil(blk_num, 16) << 4;
+  assert(HEADER_SIZE + kmap_size + blk_bs_size <= (size_t)isz);
+  const uint8_t *kmap = ibuf + HEADER_SIZE;
+  const uint8_t *data = kmap + kmap_size;
 
-  // write header
-  init_stream(&bs_header, bsbuf, header_size, false);
-  vlc_enc_header(&bs_header, cmd_info, blk_bs_size);
+  // frac bytes of zero exp are skipped, count them to locate blocks
+  std::vector<size_t> offsets(blk_num + 1, 0);
+  for (size_t blk_idx = 0; blk_idx < blk_num; blk_idx++)
+  {
+    size_t exp_bits = vlc_gr_block_bits(kmap[blk_idx], zero_guard);
+    int frac_num = 16;
+    if (zero_guard)
+    {
+      BitReader bs(data, blk_bs_size, offsets[blk_idx]);
+      frac_num -= vlc_gr_block_zero_num(bs, kmap[blk_idx]);
+    }
+    offsets[blk_idx + 1] = offsets[blk_idx] + exp_bits + frac_num * 8;
+  }
+  assert(offsets[blk_num] <= blk_bs_size * 8);
 
-  memcpy(obuf, bsbuf, (*osz) * sizeof(uint8_t));
-  free(bsbuf);
+  uint16_t *obuf16 = (uint16_t *)obuf;
+#pragma omp parallel for schedule(static)
+  for (size_t blk_idx = 0; blk_idx < blk_num; blk_idx++)
+  {
+    uint8_t blk_sr_data[16];
+    uint16_t blk_data[16];
+    BitReader bs(data, blk_bs_size, offsets[blk_idx]);
+    vlc_gr_dec_block_data(&bs, blk_sr_data, kmap[blk_idx], zero_guard);
+    for (int i = 0; i < 16; i++)
+    {
+      uint8_t exp = inv_center_shift(blk_sr_data[i], cmd_info->bias0, zero_guard);
+      uint8_t frac = (!zero_guard || exp != 0) ? bs.get(8) : 0;
+      blk_data[i] = ((frac >> 7) << 15) | (exp << 7) | (frac & 0x7F);
+    }
+    size_t out_num = (blk_idx == (blk_num - 1)) ? ((osz >> 1) - (blk_idx << 4)) : 16;
+    memcpy(&obuf16[blk_idx << 4], blk_data, out_num * sizeof(uint16_t));
+  }
 }
 
 // dataType: 0: 8bit, 1: 16bit
@@ -465,6 +692,10 @@ WeightCompresser::WeightCompresser(Operation* op, bool do_compress) {
     if (weight_op->hasOneUse() == false) {
     return;
     }
+    // storage shared with other weights can't be compressed for one user
+    if (helper::Module::isMergedWeight(w_cast_op)) {
+      return;
+    }
     auto data = w_cast_op.read_as_byte();
     old_data.resize(data->size());
     new_data.assign(data->size(), 0);
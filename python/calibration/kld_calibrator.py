@@ -10,8 +10,10 @@
 
 import os
 import gc
+import multiprocessing
 import time
 import copy
+import struct
 import numpy as np
 import pymlir
 from ctypes import *
@@ -52,10 +54,35 @@ class BaseKldCalibrator:
 
 
 class CalibrationTable:
-    def __init__(self, table):
-        self.headers, self.thresholds_map = self.parse(table)
+    # binary format, read by ImportCalibrationTablePass:
+    #   header, entries chained in hash buckets, buckets, strings, channel data
+    BIN_MAGIC = b'TPUCALI\x00'
+    BIN_VERSION = 1
+    HEADER_FMT = '<8sIIIIQQQQQ'
+    ENTRY_FMT = '<QIIdddQII'
+    END_IDX = 0xFFFFFFFF
+
+    def __init__(self, table=None):
+        self.headers = []
+        # op_name => [threshold, min, max]
+        self.thresholds_map = dict()
+        # op_name => (thresholds, mins, maxs), per channel, binary format only
+        self.channels_map = dict()
+        if table is not None:
+            self.headers, self.thresholds_map = self.parse(table)
+
+    @staticmethod
+    def hash(name):
+        # FNV-1a
+        h = 0xcbf29ce484222325
+        for c in name:
+            h = ((h ^ c) * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+        return h
 
     def parse(self, table):
+        with open(table, 'rb') as f:
+            if f.read(len(self.BIN_MAGIC)) == self.BIN_MAGIC:
+                return self.parse_binary(table)
         thresholds_map = dict()
         headers = []
         with open(table, 'r') as f:
@@ -75,13 +102,99 @@ class CalibrationTable:
                 thresholds_map[op_name] = [float(threshold), float(_min), float(_max)]
         return headers, thresholds_map
 
-    def dump(self, dest_table):
+    def parse_binary(self, table):
+        with open(table, 'rb') as f:
+            data = f.read()
+        if len(data) < struct.calcsize(self.HEADER_FMT):
+            raise RuntimeError("Calibration table {} is truncated".format(table))
+        (_, version, num, _, _, entries_offset, _, _, comment_offset,
+         comment_len) = struct.unpack_from(self.HEADER_FMT, data, 0)
+        if version != self.BIN_VERSION:
+            raise RuntimeError("Unsupported calibration table version {} in {}".format(
+                version, table))
+        entry_size = struct.calcsize(self.ENTRY_FMT)
+        if comment_offset + comment_len > len(data) or \
+                entries_offset + num * entry_size > len(data):
+            raise RuntimeError("Calibration table {} is truncated".format(table))
+        comment = data[comment_offset:comment_offset + comment_len].decode()
+        headers = comment.splitlines()
+        thresholds_map = dict()
+        for i in range(num):
+            (name_offset, name_len, channels, threshold, _min, _max, channel_offset, _,
+             _) = struct.unpack_from(self.ENTRY_FMT, data, entries_offset + i * entry_size)
+            if name_offset + name_len > len(data) or \
+                    channel_offset + 24 * channels > len(data):
+                raise RuntimeError("Calibration table {} entry {} is out of file".format(
+                    table, i))
+            op_name = data[name_offset:name_offset + name_len].decode()
+            thresholds_map[op_name] = [threshold, _min, _max]
+            if channels > 0:
+                arr = np.frombuffer(data, dtype='<f8', count=3 * channels,
+                                    offset=channel_offset).reshape(3, channels)
+                self.channels_map[op_name] = (arr[0].copy(), arr[1].copy(), arr[2].copy())
+        return headers, thresholds_map
+
+    def add(self, op_name, threshold, _min, _max, channels=None):
+        # channels: optional (thresholds, mins, maxs) arrays, kept in binary format only
+        self.thresholds_map[op_name] = [float(threshold), float(_min), float(_max)]
+        if channels is not None:
+            self.channels_map[op_name] = tuple(np.asarray(c, dtype=np.float64) for c in channels)
+
+    def dump(self, dest_table, binary=False):
+        if binary:
+            self.dump_binary(dest_table)
+            return
         with open(dest_table, "w") as f:
             for line in self.headers:
                 f.write(line + "\n")
             for k, v in self.thresholds_map.items():
                 f.write("{} {:.7f} {:.7f} {:.7f}\n".format(k, *v))
 
+    def dump_binary(self, dest_table):
+        names = [k.encode() for k in self.thresholds_map]
+        num = len(names)
+        bucket_num = 1
+        while bucket_num < num:
+            bucket_num *= 2
+        header_size = struct.calcsize(self.HEADER_FMT)
+        entry_size = struct.calcsize(self.ENTRY_FMT)
+        entries_offset = header_size
+        buckets_offset = entries_offset + num * entry_size
+        strings_offset = buckets_offset + bucket_num * 4
+        comment = "".join(line + "\n" for line in self.headers).encode()
+        strings = bytearray(comment)
+        name_offsets = []
+        for name in names:
+            name_offsets.append(strings_offset + len(strings))
+            strings += name
+        channel_offset = strings_offset + len(strings)
+        channel_offset += (-channel_offset) % 8
+        channel_data = bytearray()
+        buckets = [self.END_IDX] * bucket_num
+        entries = bytearray()
+        for i, (name, v) in enumerate(zip(names, self.thresholds_map.values())):
+            op_name = name.decode()
+            slot = self.hash(name) & (bucket_num - 1)
+            channels, offset = 0, 0
+            if op_name in self.channels_map:
+                arr = np.stack(self.channels_map[op_name]).astype('<f8')
+                channels = arr.shape[1]
+                offset = channel_offset + len(channel_data)
+                channel_data += arr.tobytes()
+            entries += struct.pack(self.ENTRY_FMT, name_offsets[i], len(name), channels, *v,
+                                   offset, buckets[slot], 0)
+            buckets[slot] = i
+        with open(dest_table, "wb") as f:
+            f.write(
+                struct.pack(self.HEADER_FMT, self.BIN_MAGIC, self.BIN_VERSION, num, bucket_num, 0,
+                            entries_offset, buckets_offset, strings_offset, strings_offset,
+                            len(comment)))
+            f.write(entries)
+            f.write(struct.pack('<{}I'.format(bucket_num), *buckets))
+            f.write(strings)
+            f.write(b'\x00' * (channel_offset - strings_offset - len(strings)))
+            f.write(channel_data)
+
     def update_to(self, dest_table, target_op, new_threshold):
         with open(dest_table, "w") as f:
             for line in self.headers:
@@ -137,6 +250,9 @@ class SimpleTuner:
         self.module_dq = pymlir.module()
         self.module_dq.load(args.mlir_file)
         self.module_dq.fake_quant_weight()
+        # fp32 references are cached in module_dq, and candidates are evaluated
+        # by re-executing only the ops affected by the threshold
+        self.use_fp32_ref = 'not_use_fp32_tensor_as_ref' not in self.debug_cmd
         self.load_net_input()
         self.dot = None
         #self.dot = gz.Digraph()
@@ -162,6 +278,10 @@ class SimpleTuner:
                 x = self.ppa_list[0].run(image)
             self.dq_activations[i] = {self.ppa_list[0].input_name:[x, count]}
             self.ref_activations[i] = {self.ppa_list[0].input_name:[x, count]}
+            if self.use_fp32_ref:
+                self.module.set_tensor(self.ppa_list[0].input_name, x, False)
+                self.module.invoke()
+                self.module_dq.add_reference(self.module)
 
     def get_input_tensor(self, i, op_name):
         if op_name in self.dq_activations[i]:
@@ -272,6 +392,11 @@ class SimpleTuner:
             node_label[0] += '\n{}'.format(tmp)
 
     def calc_distance(self, evaled_op, threshold):
+        if self.use_fp32_ref:
+            fake_quant = {input: threshold for input in self.module_parsered.get_pre_op_by_op_name(evaled_op)}
+            self.print_dbg('{}\'s inputs:{} import_quant_bias, th:{}'.format(evaled_op, list(fake_quant), threshold))
+            ret = self.module_dq.eval_fake_quant(fake_quant, evaled_op)
+            return ret['distance'], ret['cosine']
         distance = 0
         total_cosine_similarity = 0
         for idx in range(self.args.tune_num):
@@ -397,8 +522,9 @@ class SimpleTuner:
                 for pre_op in pre_ops:
                     self.dot.edge(pre_op, evaled_op, label=pre_op)
 
-            for idx in range(self.args.tune_num):
-                self.gen_ref_tensor(idx, evaled_op, node_label)
+            if not self.use_fp32_ref:
+                for idx in range(self.args.tune_num):
+                    self.gen_ref_tensor(idx, evaled_op, node_label)
 
             #若op的多个输入都已调节过，那任挑其中1个来调节，暂定第1个
             if self.isAllInputTuned(evaled_op):
@@ -408,8 +534,9 @@ class SimpleTuner:
                 self.tuned_op_list.append(pre_ops[0])
                 if self.dot is not None:
                     self.dot.node(evaled_op, node_label[0], shape='box')
-                for idx in range(self.args.tune_num):
-                    self.clear_ref_tensor(idx, evaled_op, node_label)
+                if not self.use_fp32_ref:
+                    for idx in range(self.args.tune_num):
+                        self.clear_ref_tensor(idx, evaled_op, node_label)
                 continue
             faild = False
             for tuned_op in pre_ops:
@@ -423,8 +550,9 @@ class SimpleTuner:
             if faild:
                 break
 
-            for idx in range(self.args.tune_num):
-                self.clear_ref_tensor(idx, evaled_op, node_label)
+            if not self.use_fp32_ref:
+                for idx in range(self.args.tune_num):
+                    self.clear_ref_tensor(idx, evaled_op, node_label)
 
             self.print_dbg('>>>>buffered_tensors info:')
             self.print_dbg('dq_activations keys:', list(self.dq_activations[0].keys()))
@@ -453,6 +581,77 @@ class SimpleTuner:
         return tuned_th_dict
 
 
+def calibration_inputs(data_list, batch_size, ppa_list, input_names, sample_data):
+    # input dicts for module.run_dataset, iterated in its worker thread ahead of
+    # the inference; data indexes of each sample are appended to sample_data
+    input_num = len(ppa_list)
+    idx = 0
+    batched_inputs = input_num*['']
+    for data_idx, data in enumerate(data_list):
+        if data.lower().endswith('.npz'):
+            x = np.load(data)
+            sample_data.append([data_idx])
+            yield {k: v for k, v in x.items()}
+        elif data.lower().endswith('.jpg') or data.lower().endswith('.jpeg'):
+            inputs = data.split(',')
+            inputs = [s.strip() for s in inputs]
+            assert(input_num == len(inputs))
+            idx += 1
+            for i in range(input_num):
+                batched_inputs[i] += '{},'.format(inputs[i])
+            if idx == batch_size:
+                x = {}
+                for i in range(input_num):
+                    x[ppa_list[i].input_name] = ppa_list[i].run(batched_inputs[i][:-1])
+                sample_data.append(list(range(data_idx - idx + 1, data_idx + 1)))
+                idx = 0
+                batched_inputs = input_num*['']
+                yield x
+        else:
+            inputs = data.split(',')
+            inputs = [s.strip() for s in inputs]
+            assert (input_num == len(inputs))
+            x = {}
+            for name, input in zip(input_names, inputs):
+                assert (input.lower().endswith('.npy'))
+                x[name] = np.load(input)
+            sample_data.append([data_idx])
+            yield x
+
+
+# state of a calibration worker process
+_worker = None
+
+
+def _init_calibration_worker(mlir_file):
+    global _worker
+    module = pymlir.module()
+    module.load(mlir_file)
+    parser = MlirParser(mlir_file)
+    ppa_list = []
+    for i in range(parser.get_input_num()):
+        tmp = preprocess()
+        tmp.load_config(parser.get_input_op_by_idx(i))
+        ppa_list.append(tmp)
+    _worker = (module, ppa_list, parser.get_batch_size())
+
+
+def _run_calibration_worker(data_list, abs_map=None, bin_num=0):
+    # statistics of one shard; histograms only if abs_map is given
+    module, ppa_list, batch_size = _worker
+    stats = pymlir.statistics()
+    if abs_map:
+        for name, abs_max in abs_map.items():
+            stats.init_histogram(name, abs_max, bin_num)
+
+    def collect(idx):
+        module.collect_statistics(stats)
+
+    module.run_dataset(calibration_inputs(data_list, batch_size, ppa_list, module.input_names, []),
+                       collect)
+    return stats
+
+
 class ActivationCalibrator(BaseKldCalibrator):
     def __init__(self, args, data_list: list):
         super().__init__()
@@ -490,55 +689,37 @@ class ActivationCalibrator(BaseKldCalibrator):
         return size * 4
 
     def _activations_generator_and_find_minmax(self):
-        idx = 0
         if os.path.exists('./tmpdata/'):
             os.system('rm -rf ./tmpdata/;mkdir -p ./tmpdata/')
         else:
             os.system('mkdir -p ./tmpdata/')
-        batched_inputs = self.input_num*['']
         show_mem_info('mem info before _activations_generator_and_find_minmax')
         pbar = tqdm(self.data_list, total=self.num_samples, position=0, leave=True)
-        for data_idx, data in enumerate(self.data_list):
-            pbar.set_description("inference and find Min Max *{}".format(data.split("/")[-1]))
-            pbar.update(1)
-            if data.lower().endswith('.npz'):
-                x = np.load(data)
-                for k, v in x.items():
-                    self.module.set_tensor(k, v, False)
-                self.module.invoke()
-            elif data.lower().endswith('.jpg') or data.lower().endswith('.jpeg'):
-                inputs = data.split(',')
-                inputs = [s.strip() for s in inputs]
-                assert(self.input_num == len(inputs))
-                idx += 1
-                for i in range(self.input_num):
-                    batched_inputs[i] += '{},'.format(inputs[i])
-                    if idx == self.batch_size:
-                        x = self.ppa_list[i].run(batched_inputs[i][:-1])
-                        self.module.set_tensor(self.ppa_list[i].input_name, x, False)
-                if idx == self.batch_size:
-                    self.module.invoke()
-                    idx = 0
-                    batched_inputs = self.input_num*['']
-            else:
-                inputs = data.split(',')
-                inputs = [s.strip() for s in inputs]
-                assert (self.input_num == len(inputs))
-                for name, input in zip(self.module.input_names, inputs):
-                    assert (input.lower().endswith('.npy'))
-                    x = np.load(input)
-                    self.module.set_tensor(name, x, False)
-                self.module.invoke()
+        # data indexes of each invoked sample
+        sample_data = []
+
+        def save_activations(sample_idx):
             activations = self.module.get_all_tensor()
             self.find_min_max_abs_per_input(activations)
             for name in activations:
                 activations[name] = activations[name].astype(np.float32)
-            np.savez('./tmpdata/{}_activations.npz'.format(data_idx), **activations)
+            # each image of the batch keeps a copy, as calc_thresholds loads them by index
+            for data_idx in sample_data[sample_idx]:
+                pbar.set_description("inference and find Min Max *{}".format(
+                    self.data_list[data_idx].split("/")[-1]))
+                pbar.update(1)
+                np.savez('./tmpdata/{}_activations.npz'.format(data_idx), **activations)
             del activations
             gc.collect()
+
+        self.module.run_dataset(
+            calibration_inputs(self.data_list, self.batch_size, self.ppa_list,
+                               self.module.input_names, sample_data), save_activations)
         pbar.close()
         show_mem_info('mem info after _activations_generator_and_find_minmax')
+        self._check_zero_statistics()
 
+    def _check_zero_statistics(self):
         # check max is zero
         for k, v in self.activations_statistics.items():
             _, _, _abs = v
@@ -586,7 +767,9 @@ class ActivationCalibrator(BaseKldCalibrator):
             gc.collect()
         pbar.close()
         show_mem_info('mem info after calc_thresholds')
+        return self._thresholds_from_histograms(histogram_data_map, histogram_width_map)
 
+    def _thresholds_from_histograms(self, histogram_data_map, histogram_width_map):
         thresholds_map = self.find_threshold(histogram_data_map, histogram_width_map)
         thresholds_map['abs_max'] = {}
         for k, v in self.activations_statistics.items():
@@ -598,6 +781,51 @@ class ActivationCalibrator(BaseKldCalibrator):
         show_mem_info('mem info after find_threshold')
         return thresholds_map
 
+    def calc_thresholds_parallel(self, workers):
+        # samples are sharded by whole batches, each worker process runs its own
+        # interpreter; merged statistics equal those of one interpreter.
+        # npz/npy entries are whole batches, images are batched by batch_size
+        is_image = any(d.lower().endswith(('.jpg', '.jpeg')) for d in self.data_list)
+        unit = self.batch_size if is_image else 1
+        unit_num = self.num_samples // unit
+        shards = []
+        for i in range(workers):
+            begin = unit_num * i // workers * unit
+            end = unit_num * (i + 1) // workers * unit
+            if end > begin:
+                shards.append(self.data_list[begin:end])
+        omp_threads = os.environ.get('OMP_NUM_THREADS')
+        os.environ['OMP_NUM_THREADS'] = str(max(1, os.cpu_count() // len(shards)))
+        try:
+            ctx = multiprocessing.get_context('spawn')
+            with ctx.Pool(len(shards), _init_calibration_worker, (self.args.mlir_file, )) as pool:
+                # step 1: min max
+                print("find min max with {} workers..".format(len(shards)))
+                stats = pymlir.statistics()
+                for s in pool.map(_run_calibration_worker, shards):
+                    stats.merge(s)
+                self.activations_statistics = stats.min_max()
+                self._check_zero_statistics()
+
+                # step 2: histograms in the merged range
+                print("calculate histogram with {} workers..".format(len(shards)))
+                abs_map = {k: v[2] for k, v in self.activations_statistics.items()}
+                stats = pymlir.statistics()
+                for s in pool.starmap(_run_calibration_worker,
+                                      [(shard, abs_map, self.histogram_bin_num) for shard in shards]):
+                    stats.merge(s)
+        finally:
+            if omp_threads is None:
+                del os.environ['OMP_NUM_THREADS']
+            else:
+                os.environ['OMP_NUM_THREADS'] = omp_threads
+        histogram_data_map = {}
+        histogram_width_map = {}
+        for k, (hist, width) in stats.histograms().items():
+            histogram_data_map[k] = hist.astype(np.int32)
+            histogram_width_map[k] = width
+        return self._thresholds_from_histograms(histogram_data_map, histogram_width_map)
+
     def find_threshold(self, histogram_data_map, histogram_width_map):
         thresholds = {}
         num = len(histogram_data_map)
@@ -626,28 +854,34 @@ class ActivationCalibrator(BaseKldCalibrator):
                 print('input_calibration_table error')
                 exit(1)
         else:
-            # step 1: find min max
-            self._activations_generator_and_find_minmax()
+            if self.args.workers > 1:
+                # step 1 and 2 in worker processes
+                thresholds_map = self.calc_thresholds_parallel(self.args.workers)
+            else:
+                # step 1: find min max
+                self._activations_generator_and_find_minmax()
 
-            # step 2: calculate threshold with histogram bins
-            thresholds_map = self.calc_thresholds()
+                # step 2: calculate threshold with histogram bins
+                thresholds_map = self.calc_thresholds()
             self._clean_resource()
 
             # step 3: dump threshold table of default histogram bins
             cali_table = self.args.calibration_table
             if self.args.tune_num > 0:
                 cali_table += ".1"
-            with open(cali_table, 'w') as f:
-                f.write("# genetated time: {}\n".format(datetime.datetime.now()))
-                f.write("# histogram number: {}\n".format(self.histogram_bin_num))
-                f.write("# sample number: {}\n###\n".format(self.num_samples))
-                f.write("# op_name    threshold    min    max\n")
-                for i, op_name in enumerate(op_layers):
-                    threshold = thresholds_map[op_name]
-                    thresholds_map_list.append(threshold)
-                    min_value, max_value, _ = self.activations_statistics[op_name]
-                    f.write("{} {:.7f} {:.7f} {:.7f}\n".format(op_name, threshold, min_value,
-                                                            max_value))
+            table = CalibrationTable()
+            table.headers = [
+                "# genetated time: {}".format(datetime.datetime.now()),
+                "# histogram number: {}".format(self.histogram_bin_num),
+                "# sample number: {}".format(self.num_samples), "###",
+                "# op_name    threshold    min    max"
+            ]
+            for i, op_name in enumerate(op_layers):
+                threshold = thresholds_map[op_name]
+                thresholds_map_list.append(threshold)
+                min_value, max_value, _ = self.activations_statistics[op_name]
+                table.add(op_name, threshold, min_value, max_value)
+            table.dump(cali_table, self.args.binary_table)
 
         if self.args.tune_num <= 0:
             return
@@ -658,23 +892,25 @@ class ActivationCalibrator(BaseKldCalibrator):
 
         # step 5: dump threshold table after tuning
         tuned_threshold_list = []
-        with open(self.args.calibration_table, 'w') as f:
-            f.write("# genetated time: {}\n".format(datetime.datetime.now()))
-            f.write("# histogram number: {}\n".format(self.histogram_bin_num))
-            f.write("# sample number: {}\n".format(self.num_samples))
-            f.write("# tune number: {}\n###\n".format(self.args.tune_num))
-            f.write("# op_name    threshold    min    max\n")
-            for i, op_name in enumerate(op_layers):
-                threshold = thresholds[op_name]
-                layer_name_list.append('{}_{}'.format(i, op_name))
-                tuned_threshold_list.append(threshold)
-                if 'input_calibration_table' in self.debug_cmd:
-                    min_value = threshold_table.thresholds_map[op_name][1]
-                    max_value = threshold_table.thresholds_map[op_name][2]
-                else:
-                    min_value, max_value, _ = self.activations_statistics[op_name]
-                f.write("{} {:.7f} {:.7f} {:.7f}\n".format(op_name, threshold,
-                                                           min_value, max_value))
+        table = CalibrationTable()
+        table.headers = [
+            "# genetated time: {}".format(datetime.datetime.now()),
+            "# histogram number: {}".format(self.histogram_bin_num),
+            "# sample number: {}".format(self.num_samples),
+            "# tune number: {}".format(self.args.tune_num), "###",
+            "# op_name    threshold    min    max"
+        ]
+        for i, op_name in enumerate(op_layers):
+            threshold = thresholds[op_name]
+            layer_name_list.append('{}_{}'.format(i, op_name))
+            tuned_threshold_list.append(threshold)
+            if 'input_calibration_table' in self.debug_cmd:
+                min_value = threshold_table.thresholds_map[op_name][1]
+                max_value = threshold_table.thresholds_map[op_name][2]
+            else:
+                min_value, max_value, _ = self.activations_statistics[op_name]
+            table.add(op_name, threshold, min_value, max_value)
+        table.dump(self.args.calibration_table, self.args.binary_table)
         os.remove(cali_table)
         if 'print_debug_info' in self.debug_cmd:
             th_before_tuned = np.array(thresholds_map_list)
@@ -39,17 +39,20 @@ class ONNX_IR_TESTER(object):
             "Concat": self.test_Concat,
             "Conv1d": self.test_Conv1d,
             "Conv2d": self.test_Conv2d,
+            "Conv2dAsymPad": self.test_Conv2dAsymPad,
             "Conv3d": self.test_Conv3d,
             "ConvTranspose2D": self.test_ConvTranspose,
             "Clip": self.test_Clip,
             "Div": self.test_Div,
             "Expand": self.test_Expand,
             "Gather": self.test_Gather,
+            "GatherRepeat": self.test_GatherRepeat,
             "GatherToSlice": self.test_GatherToSlice,
             "Gemm": self.test_Gemm,
             "LeakyRelu": self.test_LeakyRelu,
             "Log": self.test_Log,
             "LayerGroup2": self.test_LayerGroup2,
+            "MergeWeight": self.test_MergeWeight,
             #"LSTM": self.test_LSTM,
             "MaxPool1D": self.test_MaxPool1D,
             "MaxPool2D": self.test_MaxPool2D,
@@ -73,6 +76,7 @@ class ONNX_IR_TESTER(object):
             "Scale": self.test_Scale,
             "Tile": self.test_Tile,
             "Transpose": self.test_Transpose,
+            "Upsample": self.test_Upsample,
             "Max": self.test_Max,
             "Min": self.test_Min,
             #############################
@@ -402,6 +406,39 @@ class ONNX_IR_TESTER(object):
                       dilation=[1, 1],
                       groups=1)
 
+    def test_Conv2dAsymPad(self, case_name):
+        # relu makes conv input u8 in asymmetric int8, and the nonzero zero
+        # point is padded by hand with different pads on each side
+        oc = 16
+        input_shape = [2, 8, 35, 35]
+        filter_shape = [oc, 8, 3, 3]
+        output_shape = [2, oc, 18, 17]
+        input_data = np.random.randn(*input_shape).astype(np.float32)
+        weight_data = np.random.randn(*filter_shape).astype(np.float32)
+        bias_data = np.random.randn(oc).astype(np.float32)
+
+        input = helper.make_tensor_value_info('input', TensorProto.FLOAT, input_shape)
+        output = helper.make_tensor_value_info('output', TensorProto.FLOAT, output_shape)
+        weight = helper.make_tensor('weight', TensorProto.FLOAT, filter_shape, weight_data)
+        bias = helper.make_tensor('bias', TensorProto.FLOAT, list(bias_data.shape), bias_data)
+
+        relu_def = helper.make_node("Relu", inputs=['input'], outputs=['x1'])
+        conv_def = helper.make_node(
+            "Conv",
+            inputs=['x1', 'weight', 'bias'],
+            outputs=['output'],
+            kernel_shape=[3, 3],
+            pads=[0, 1, 2, 0],
+            strides=[2, 2],
+            dilations=[1, 1],
+            group=1,
+        )
+
+        graph_def = helper.make_graph([relu_def, conv_def],
+                                      case_name, [input], [output],
+                                      initializer=[weight, bias])
+        self.onnx_and_test({'input': input_data}, graph_def)
+
     # def test_Conv2d(self, case_name):
     #     input_shape = [4, 3, 10, 10]
     #     filter_shape = [8, 3, 3, 3]
@@ -643,6 +680,34 @@ class ONNX_IR_TESTER(object):
         input_data = np.random.randn(*input_shape).astype(np.float32)
         self.onnx_and_test({"input": input_data}, graph_def)
 
+    def test_Upsample(self, case_name):
+        # nearest resize with integer scales goes to upsample; scale_w 1 copies
+        # rows, 2 takes the simd way, 3 the scalar way, odd widths leave a tail
+        for i, (scale_h, scale_w) in enumerate([(2, 1), (1, 2), (2, 2), (3, 3)]):
+            n = int(np.random.randint(1, 3))
+            c = int(np.random.randint(1, 17))
+            h = int(np.random.randint(1, 20))
+            w = int(2 * np.random.randint(0, 20) + 1)
+            input_shape = [n, c, h, w]
+            output_shape = [n, c, h * scale_h, w * scale_w]
+            input = helper.make_tensor_value_info('input', TensorProto.FLOAT, input_shape)
+            output = helper.make_tensor_value_info('output', TensorProto.FLOAT, output_shape)
+            roi_data = np.array([], dtype=np.float32)
+            scales_data = np.array([1, 1, scale_h, scale_w], dtype=np.float32)
+            roi = helper.make_tensor('roi', TensorProto.FLOAT, [0], roi_data)
+            scales = helper.make_tensor('scales', TensorProto.FLOAT, [4], scales_data)
+            resize_def = helper.make_node('Resize',
+                                          inputs=['input', 'roi', 'scales'],
+                                          outputs=['output'],
+                                          mode='nearest',
+                                          nearest_mode='floor',
+                                          coordinate_transformation_mode='asymmetric')
+            graph_def = helper.make_graph([resize_def],
+                                          case_name, [input], [output],
+                                          initializer=[roi, scales])
+            input_data = np.random.randn(*input_shape).astype(np.float32)
+            self.onnx_and_test({"input": input_data}, graph_def, "{}_{}".format(case_name, i))
+
     def test_Softmax(self, case_name):
         input_shape = [1, 1000, 1, 1]
         axis = 1
@@ -1049,6 +1114,42 @@ class ONNX_IR_TESTER(object):
                                       [sigmoid, output])
         self.onnx_and_test(input_data, graph_def)
 
+    def test_MergeWeight(self, case_name):
+        # two convs with the same weight and zero bias in one function, merged
+        # by merge-weight before layer-group
+        ic = 16
+        input_shape = [1, ic, 32, 32]
+        filter_shape = [ic, ic, 3, 3]
+        input_data = np.random.randn(*input_shape).astype(np.float32)
+        weight_data = np.random.randn(*filter_shape).astype(np.float32)
+        bias_data = np.zeros(ic).astype(np.float32)
+        input = helper.make_tensor_value_info('input', TensorProto.FLOAT, input_shape)
+        output = helper.make_tensor_value_info('output', TensorProto.FLOAT, input_shape)
+        initializer = []
+        nodes = []
+        conv_input = 'input'
+        for i in range(2):
+            initializer.append(
+                helper.make_tensor('weight{}'.format(i), TensorProto.FLOAT, filter_shape,
+                                   weight_data))
+            initializer.append(
+                helper.make_tensor('bias{}'.format(i), TensorProto.FLOAT, [ic], bias_data))
+            conv_output = 'output' if i == 1 else 'conv{}'.format(i)
+            nodes.append(
+                helper.make_node("Conv",
+                                 inputs=[conv_input, 'weight{}'.format(i), 'bias{}'.format(i)],
+                                 outputs=[conv_output],
+                                 kernel_shape=[3, 3],
+                                 pads=[1, 1, 1, 1],
+                                 strides=[1, 1],
+                                 dilations=[1, 1],
+                                 group=1))
+            conv_input = conv_output
+        graph_def = helper.make_graph(nodes,
+                                      case_name, [input], [output],
+                                      initializer=initializer)
+        self.onnx_and_test({'input': input_data}, graph_def)
+
     def test_Gather(self, case_name):
         total_tokens = 60004
         token_shape = [total_tokens, 256]
@@ -1087,6 +1188,30 @@ class ONNX_IR_TESTER(object):
                                       initializer=[token_data])
         self.onnx_and_test(input_data, graph_def)
 
+    def test_GatherRepeat(self, case_name):
+        # random shape and axis, indices repeated and out of order
+        for i in range(3):
+            input_shape = [int(x) for x in np.random.randint(1, 12, np.random.randint(2, 5))]
+            axis = int(np.random.randint(0, len(input_shape)))
+            num_indices = int(np.random.randint(2, 2 * input_shape[axis] + 3))
+            indices_data = np.random.randint(0, input_shape[axis], num_indices)
+            indices_data[-1] = indices_data[0]
+            output_shape = input_shape[:axis] + [num_indices] + input_shape[axis + 1:]
+
+            input = helper.make_tensor_value_info('input', TensorProto.FLOAT, input_shape)
+            output = helper.make_tensor_value_info('output', TensorProto.FLOAT, output_shape)
+            indices = helper.make_tensor('indices', TensorProto.INT64, [num_indices],
+                                         indices_data.astype(np.int64))
+            gather_def = helper.make_node("Gather",
+                                          inputs=['input', 'indices'],
+                                          outputs=['output'],
+                                          axis=axis)
+            graph_def = helper.make_graph([gather_def],
+                                          case_name, [input], [output],
+                                          initializer=[indices])
+            input_data = np.random.randn(*input_shape).astype(np.float32)
+            self.onnx_and_test({"input": input_data}, graph_def, "{}_{}".format(case_name, i))
+
     def test_Tile(self, case_name):
         input_shape = [1, 4, 6, 8]
         output_shape = [1, 24, 24, 16]
@@ -8,11 +8,13 @@
 #
 # ==============================================================================
 
+import os
 import abc
 import numpy as np
 import argparse
 from utils.mlir_shell import *
 from utils.mlir_parser import *
+from utils.compile_cache import CompileCache
 from tools.model_runner import mlir_inference, model_inference
 import pymlir
 
@@ -58,6 +60,7 @@ class DeployTool:
             else:
                 self.prefix += "_sym"
         self._prepare_input_npz()
+        self._init_cache(args.cache_dir)
 
     def lowering(self):
         self.tpu_mlir = "{}_tpu.mlir".format(self.prefix)
@@ -67,6 +70,13 @@ class DeployTool:
         if self.do_validate:
             tool.validate_tpu_mlir()
 
+    def compile(self):
+        # no validation needs the tpu mlir, so build the model in one process
+        self.final_mlir = "{}_final.mlir".format(self.prefix)
+        mlir_compile(self.mlir_file, self.model, self.quantize, self.chip, self.cali_table,
+                     self.asymmetric, self.quant_input, self.quant_output,
+                     final_mlir=self.final_mlir)
+
     def _prepare_input_npz(self):
         num_inputs = len(self.test_input)
         self.do_validate = (0 < num_inputs)
@@ -84,12 +94,59 @@ class DeployTool:
                 data = np.load(infile)
                 self.inputs[op.name] = data
         np.savez(self.in_f32_npz, **self.inputs)
-        if len(self.ref_npz) == 0:
+        self.gen_ref = (len(self.ref_npz) == 0)
+        if self.gen_ref:
             self.ref_npz = self.module_name + "_top_outputs.npz"
-            show_fake_cmd(self.in_f32_npz, self.mlir_file, self.ref_npz)
-            top_outputs = mlir_inference(self.inputs, self.mlir_file)
-            np.savez(self.ref_npz, **top_outputs)
         self.tpu_npz = "{}_tpu_outputs.npz".format(self.prefix)
+        self.model_npz = "{}_model_outputs.npz".format(self.prefix)
+
+    def _init_cache(self, cache_dir):
+        self.cache = None
+        if not cache_dir:
+            return
+        self.cache = CompileCache(cache_dir, pymlir.module().version)
+        weight_file = eval(self.module.attrs['module.weight_file'])
+        files = [self.mlir_file, weight_file, self.cali_table, self.quantize_table]
+        files += self.test_input
+        if self.do_validate and not self.gen_ref:
+            files.append(self.ref_npz)
+        options = {
+            "chip": self.chip,
+            "quantize": self.quantize,
+            "asymmetric": self.asymmetric,
+            "quant_input": self.quant_input,
+            "quant_output": self.quant_output,
+        }
+        self.cache_key = self.cache.key(files, options)
+
+    def _cache_outputs(self):
+        outputs = {"model": self.model}
+        if self.do_validate:
+            outputs["tpu_outputs.npz"] = self.tpu_npz
+            outputs["model_outputs.npz"] = self.model_npz
+            if self.gen_ref:
+                outputs["top_outputs.npz"] = self.ref_npz
+        return outputs
+
+    def load_cache(self):
+        if self.cache is None or not self.cache.load(self.cache_key, self._cache_outputs()):
+            return False
+        if self.do_validate:
+            # tolerances are not part of the key, compare again
+            f32_blobs_compare(self.tpu_npz, self.ref_npz, self.tolerance, self.excepts)
+            self._compare_model_npz()
+        return True
+
+    def store_cache(self):
+        if self.cache is not None:
+            self.cache.store(self.cache_key, self._cache_outputs())
+
+    def gen_reference(self):
+        if not self.do_validate or not self.gen_ref:
+            return
+        show_fake_cmd(self.in_f32_npz, self.mlir_file, self.ref_npz)
+        top_outputs = mlir_inference(self.inputs, self.mlir_file)
+        np.savez(self.ref_npz, **top_outputs)
 
     def validate_tpu_mlir(self):
         show_fake_cmd(self.in_f32_npz, self.tpu_mlir, self.tpu_npz)
@@ -110,10 +167,12 @@ class DeployTool:
             tool.validate_model()
 
     def validate_model(self):
-        self.model_npz = "{}_model_outputs.npz".format(self.prefix)
         show_fake_cmd(self.in_f32_npz, self.model, self.model_npz)
         model_outputs = model_inference(self.inputs, self.model)
         np.savez(self.model_npz, **model_outputs)
+        self._compare_model_npz()
+
+    def _compare_model_npz(self):
         if self.state == "TOP_QUANTIZED":
             f32_blobs_compare(self.model_npz, self.ref_npz, self.correctness)
         else:
@@ -147,10 +206,18 @@ if __name__ == '__main__':
                         help="strip input type cast in bmodel, need outside type conversion")
     parser.add_argument("--quant_output", action="store_true",
                         help="strip output type cast in bmodel, need outside type conversion")
+    parser.add_argument("--cache_dir", default=os.environ.get("TPUC_CACHE_DIR", ""),
+                        help="reuse the outputs of an identical deployment from this directory")
     # yapf: enable
     args = parser.parse_args()
     tool = DeployTool(args)
-    # lowering to tpu
-    tool.lowering()
-    # generate model
-    tool.build_model()
+    if not tool.load_cache():
+        if tool.do_validate:
+            tool.gen_reference()
+            # lowering to tpu
+            tool.lowering()
+            # generate model
+            tool.build_model()
+        else:
+            tool.compile()
+        tool.store_cache()
@@ -40,13 +40,20 @@ def mlir_validate(val_loader, module, ppa_list, count=-1):
         prefix='Test: ')
 
     end = time.time()
-    for i, item in enumerate(val_loader):
-        (images,target), (path,_) = item
-
-        assert(input_num == 1)
-        x = ppa_list[0].run(path[0])
-        module.set_tensor(ppa_list[0].input_name, x, False)
-        module.invoke()
+    assert(input_num == 1)
+    # preprocess in the worker thread of run_dataset, overlapped with invoke
+    samples = []
+
+    def inputs_generator():
+        for item in val_loader:
+            (images,target), (path,_) = item
+            samples.append((images, target))
+            yield {ppa_list[0].input_name: ppa_list[0].run(path[0])}
+
+    def validate(i):
+        nonlocal end
+        images, target = samples[i]
+        samples[i] = None
         tensors = module.get_all_tensor()
         assert(len(module.output_names) == 1)
         output = torch.from_numpy(tensors[module.output_names[0]])
@@ -64,8 +71,9 @@ def mlir_validate(val_loader, module, ppa_list, count=-1):
         if i % 20 == 0:
             progress.display(i + 1)
 
-        if i == count:
-            break
+        return i != count
+
+    module.run_dataset(inputs_generator(), validate)
 
 
 class MyImageFolder(datasets.ImageFolder):
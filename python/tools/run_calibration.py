@@ -40,7 +40,11 @@ if __name__ == '__main__':
                         type=int,
                         default=2048,
                         help='Specify histogram bin numer for kld calculate')
+    parser.add_argument('--workers', type=int, default=1,
+                        help='num of processes to collect statistics, each runs its own interpreter')
     parser.add_argument('-o', '--calibration_table', type=str, help='output threshold table')
+    parser.add_argument('--binary_table', action='store_true',
+                        help='save threshold table in binary format, for large models')
     parser.add_argument('--debug_cmd', type=str, default='', help='debug cmd')
     args = parser.parse_args()
 
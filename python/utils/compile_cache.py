@@ -0,0 +1,104 @@
+# Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+#
+# TPU-MLIR is licensed under the 2-Clause BSD License except for the
+# third-party components.
+#
+# ==============================================================================
+
+import os
+import shutil
+import hashlib
+import tempfile
+
+
+# backend libraries dlopen'ed by the tools at runtime
+_BACKEND_LIBS = ["libbackend_1684.so", "libbackend_1684x.so", "libcvikernel.so"]
+
+
+def _find_library(name: str, tool_dirs: list):
+    # the first one dlopen would take: LD_LIBRARY_PATH, then lib of install
+    dirs = os.environ.get("LD_LIBRARY_PATH", "").split(":")
+    dirs += [os.path.join(d, os.pardir, "lib") for d in tool_dirs]
+    for d in dirs:
+        path = os.path.join(d, name) if d else None
+        if path and os.path.isfile(path):
+            return path
+    return None
+
+
+def _toolchain_fingerprint():
+    # rebuilt binaries or backends must not hit entries made by an older build
+    fp = []
+    tool_dirs = []
+    for tool in ["tpuc-opt", "tpuc-compile"]:
+        path = shutil.which(tool)
+        if path is None:
+            continue
+        tool_dirs.append(os.path.dirname(os.path.realpath(path)))
+        st = os.stat(path)
+        fp.append("{}:{}:{}".format(tool, st.st_size, st.st_mtime_ns))
+    for lib in _BACKEND_LIBS:
+        path = _find_library(lib, tool_dirs)
+        if path is None:
+            continue
+        st = os.stat(path)
+        fp.append("{}:{}:{}".format(lib, st.st_size, st.st_mtime_ns))
+    return ";".join(fp)
+
+
+class CompileCache:
+    """Content addressed cache of model_deploy outputs.
+
+    The key is the hash of all input files (mlir, weight npz, calibration table,
+    ...), the deploy options and the toolchain build. An entry holds the output
+    files of one deployment, stored under <cache_dir>/<key[:2]>/<key>.
+    """
+
+    def __init__(self, cache_dir: str, version: str = ""):
+        self.cache_dir = os.path.abspath(cache_dir)
+        self.version = version + ";" + _toolchain_fingerprint()
+        os.makedirs(self.cache_dir, exist_ok=True)
+
+    def key(self, files: list, options: dict):
+        h = hashlib.sha256()
+        h.update(self.version.encode())
+        for f in files:
+            if f is None:
+                h.update(b"<none>")
+                continue
+            h.update(b"<file>")
+            with open(f, "rb") as fd:
+                for chunk in iter(lambda: fd.read(1 << 20), b""):
+                    h.update(chunk)
+        for k in sorted(options):
+            h.update("{}={};".format(k, options[k]).encode())
+        return h.hexdigest()
+
+    def _entry(self, key: str):
+        return os.path.join(self.cache_dir, key[:2], key)
+
+    def load(self, key: str, outputs: dict):
+        """restore outputs {tag: path}, return False if not cached"""
+        entry = self._entry(key)
+        if not all(os.path.exists(os.path.join(entry, t)) for t in outputs):
+            return False
+        for tag, path in outputs.items():
+            shutil.copyfile(os.path.join(entry, tag), path)
+        print("[Cache]: hit {}".format(key))
+        return True
+
+    def store(self, key: str, outputs: dict):
+        entry = self._entry(key)
+        if os.path.exists(entry):
+            return
+        os.makedirs(os.path.dirname(entry), exist_ok=True)
+        # fill a temporary dir first, so readers never see a partial entry
+        tmp = tempfile.mkdtemp(dir=os.path.dirname(entry))
+        for tag, path in outputs.items():
+            shutil.copyfile(path, os.path.join(tmp, tag))
+        try:
+            os.rename(tmp, entry)
+        except OSError:
+            # stored by a concurrent deployment
+            shutil.rmtree(tmp, ignore_errors=True)
+        print("[Cache]: store {}".format(key))
@@ -22,6 +22,7 @@ def mlir_opt_for_top(mlirfile, opt_mlirfile):
     cmd = [
         "tpuc-opt",
         "--canonicalize",
+        "--fold-constant",
         "--mark-FLOPs",
         "--save-weight",
         "--mlir-print-debuginfo",
@@ -73,6 +74,7 @@ def mlir_to_model(tpu_mlir: str,
         strip_io_quant_param,
         "--weight-reorder",
         "--subnet-divide",
+        "--merge-weight",
         "--layer-group",
         "--address-assign",
         "--save-weight",
@@ -88,6 +90,42 @@ def mlir_to_model(tpu_mlir: str,
     except RuntimeError:
         pass
 
+def mlir_compile(top_mlir: str,
+                 model: str,
+                 mode: str,
+                 chip: str,
+                 cali_table=None,
+                 asymmetric: bool = False,
+                 quant_input: bool = False,
+                 quant_output: bool = False,
+                 tpu_mlir=None,
+                 final_mlir=None):
+    # lowering and codegen in one tpuc-compile process, weights stay in memory
+    cmd = [
+        "tpuc-compile",
+        top_mlir,
+        "--model={}".format(model),
+        "--chip={}".format(chip.lower()),
+        "--mode={}".format(mode.upper()),
+    ]
+    if cali_table != None:
+        cmd.append("--calibration-table={}".format(cali_table))
+    if asymmetric:
+        cmd.append("--asymmetric")
+    if quant_input:
+        cmd.append("--quant-input")
+    if quant_output:
+        cmd.append("--quant-output")
+    if tpu_mlir != None:
+        cmd.append("--dump-tpu={}".format(tpu_mlir))
+    if final_mlir != None:
+        cmd.append("--dump-final={}".format(final_mlir))
+    _os_system(cmd)
+    try:
+        _os_system(["mv compiler_profile_0.txt", model + ".compiler_profile_0.txt"])
+    except RuntimeError:
+        pass
+
 # tmp for cvitek, remove in the future
 def mlir_to_cvi_model(tpu_mlir: str,
                   model: str,
@@ -104,6 +142,7 @@ def mlir_to_cvi_model(tpu_mlir: str,
         strip_io_quant_param,
         "--weight-reorder",
         "--subnet-divide",
+        "--merge-weight",
         "--cv-address-assign",
         "--save-weight",
         codegen_param,
@@ -0,0 +1,103 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+//
+// f16/bf16 activations looked up in get_active_lut tables must give the same
+// bits as computing the function in f32 and rounding to f16/bf16.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/ActiveLut.h"
+#include "tpu_mlir/Support/Float16.h"
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace tpu_mlir;
+
+static int num_errors = 0;
+
+// the same functions as tpu Sigmoid, SiLU and Log
+static float active_sigmoid(float val) { return 1 / (1 + std::exp(-val)); }
+static float active_silu(float val) { return val / (1 + std::exp(-val)); }
+static float active_log(float val) { return std::log(val); }
+
+static uint32_t bits_of(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+static float float_of(uint32_t bits) {
+  float v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+static float round_to(float v, bool is_bf16) {
+  return is_bf16 ? bf16_to_f32(f32_to_bf16(v)) : f16_to_f32(f32_to_f16(v));
+}
+
+static void test_func(const char *name, active_f32_f func, bool is_bf16,
+                      const std::vector<float> &src) {
+  int64_t num = src.size();
+  std::vector<float> dst(num);
+  auto table = get_active_lut(func, is_bf16);
+  active_by_lut(src.data(), dst.data(), num, table, func, is_bf16);
+  for (int64_t i = 0; i < num; i++) {
+    float expect = round_to(func(src[i]), is_bf16);
+    if (std::isnan(expect) && std::isnan(dst[i])) {
+      continue;
+    }
+    if (bits_of(dst[i]) == bits_of(expect)) {
+      continue;
+    }
+    if (num_errors++ < 20) {
+      printf("%s %s mismatch at %" PRId64 ": src 0x%08x, got 0x%08x, "
+             "expect 0x%08x\n",
+             name, is_bf16 ? "bf16" : "f16", i, bits_of(src[i]),
+             bits_of(dst[i]), bits_of(expect));
+    }
+  }
+  if (get_active_lut(func, is_bf16) != table) {
+    num_errors++;
+    printf("%s %s table is built again\n", name, is_bf16 ? "bf16" : "f16");
+  }
+  printf("%s %s: %" PRId64 " values checked\n", name,
+         is_bf16 ? "bf16" : "f16", num);
+}
+
+int main() {
+  // every f16 and bf16 value goes by the table, random f32 bits mostly not
+  std::vector<float> src;
+  for (uint32_t i = 0; i < (1u << 16); i++) {
+    src.push_back(f16_to_f32((uint16_t)i));
+    src.push_back(bf16_to_f32((uint16_t)i));
+  }
+  std::mt19937 gen(20221019);
+  std::uniform_int_distribution<uint32_t> bits_dist;
+  std::normal_distribution<float> normal(0.0f, 8.0f);
+  for (int i = 0; i < (1 << 20); i++) {
+    src.push_back((i & 1) ? float_of(bits_dist(gen)) : normal(gen));
+  }
+  for (bool is_bf16 : {false, true}) {
+    test_func("sigmoid", active_sigmoid, is_bf16, src);
+    test_func("silu", active_silu, is_bf16, src);
+    test_func("log", active_log, is_bf16, src);
+  }
+  if (num_errors > 0) {
+    printf("FAILED: %d mismatches\n", num_errors);
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,93 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+//
+// Weights compressed by compressInt8Data/compressBf16Data must decompress to
+// the same bytes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/TPUCompressUtil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace tpu_mlir;
+
+static int num_errors = 0;
+
+static std::vector<uint8_t> random_weight(std::mt19937 &gen, int size,
+                                          bool is_bf16) {
+  std::vector<uint8_t> plain(size);
+  if (is_bf16) {
+    // weight like distribution, with some zeros
+    std::normal_distribution<float> dist(0.0f, 0.05f);
+    auto plain16 = (uint16_t *)plain.data();
+    for (int i = 0; i < size / 2; i++) {
+      float v = (i % 7 == 0) ? 0.0f : dist(gen);
+      uint32_t u;
+      memcpy(&u, &v, sizeof(u));
+      plain16[i] = u >> 16;
+    }
+  } else {
+    std::normal_distribution<float> dist(0.0f, 20.0f);
+    for (int i = 0; i < size; i++) {
+      plain[i] = (int8_t)std::max(-128.0f, std::min(127.0f, dist(gen)));
+    }
+  }
+  return plain;
+}
+
+static void test_round_trip(const std::vector<uint8_t> &plain, bool is_bf16) {
+  int size = plain.size();
+  CompressCommandInfo cmd_info;
+  memset(&cmd_info, 0, sizeof(cmd_info));
+  getCompressParameter(plain.data(), size, !is_bf16, is_bf16, &cmd_info);
+  int osz = getCompressedDataSize(size, is_bf16);
+  std::vector<uint8_t> compressed(osz);
+  std::vector<uint8_t> decompressed(size);
+  CompressCommandInfo dec_info;
+  if (is_bf16) {
+    compressBf16Data(plain.data(), size, compressed.data(), &osz, &cmd_info);
+    decompressBf16Data(compressed.data(), osz, decompressed.data(), size,
+                       &dec_info);
+  } else {
+    compressInt8Data(plain.data(), size, compressed.data(), &osz, &cmd_info);
+    decompressInt8Data(compressed.data(), osz, decompressed.data(), size,
+                       &dec_info);
+  }
+  const char *name = is_bf16 ? "bf16" : "int8";
+  if (decompressed != plain) {
+    num_errors++;
+    printf("%s size %d: round trip mismatch\n", name, size);
+    return;
+  }
+  printf("%s size %d => %d\n", name, size, osz);
+}
+
+int main() {
+  std::mt19937 gen(0);
+  // one block, a partial block, and more chunks than threads with a tail
+  const int sizes[] = {16, 100, 4096, 65536 + 48, (1 << 20) + 64};
+  for (int size : sizes) {
+    for (bool is_bf16 : {false, true}) {
+      test_round_trip(random_weight(gen, size, is_bf16), is_bf16);
+      // all zeros, as in padded weights
+      test_round_trip(std::vector<uint8_t>(size, 0), is_bf16);
+    }
+  }
+  if (num_errors > 0) {
+    printf("FAILED: %d mismatches\n", num_errors);
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
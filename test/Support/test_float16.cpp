@@ -0,0 +1,181 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+//
+// Batch f16/bf16 conversions (SIMD when the CPU has it) must give the same
+// bits as the scalar conversions.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/Support/Float16.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace tpu_mlir;
+
+static int num_errors = 0;
+
+static uint32_t bits_of(float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, sizeof(bits));
+  return bits;
+}
+
+static float float_of(uint32_t bits) {
+  float v;
+  memcpy(&v, &bits, sizeof(v));
+  return v;
+}
+
+static void check(const char *name, int64_t idx, uint32_t src, uint32_t got,
+                  uint32_t expect) {
+  if (got == expect) {
+    return;
+  }
+  if (num_errors++ < 20) {
+    printf("%s mismatch at %" PRId64 ": src 0x%08x, got 0x%08x, expect 0x%08x\n",
+           name, idx, src, got, expect);
+  }
+}
+
+// all f16/bf16 => f32
+static void test_all_16bit() {
+  const int64_t num = 1 << 16;
+  std::vector<uint16_t> src(num);
+  for (int64_t i = 0; i < num; i++) {
+    src[i] = i;
+  }
+  std::vector<float> dst(num);
+  f16_to_f32(src.data(), dst.data(), num);
+  for (int64_t i = 0; i < num; i++) {
+    check("f16_to_f32", i, src[i], bits_of(dst[i]),
+          bits_of(f16_to_f32(src[i])));
+  }
+  bf16_to_f32(src.data(), dst.data(), num);
+  for (int64_t i = 0; i < num; i++) {
+    check("bf16_to_f32", i, src[i], bits_of(dst[i]),
+          bits_of(bf16_to_f32(src[i])));
+  }
+}
+
+// f32 => f16/bf16, in u16 and rounded f32
+static void test_f32(const char *title, std::vector<float> &src) {
+  int64_t num = src.size();
+  std::vector<uint16_t> dst_u16(num);
+  std::vector<float> dst(num);
+  f32_to_f16(src.data(), dst_u16.data(), num);
+  for (int64_t i = 0; i < num; i++) {
+    check("f32_to_f16 u16", i, bits_of(src[i]), dst_u16[i],
+          f32_to_f16(src[i]));
+  }
+  f32_to_bf16(src.data(), dst_u16.data(), num);
+  for (int64_t i = 0; i < num; i++) {
+    check("f32_to_bf16 u16", i, bits_of(src[i]), dst_u16[i],
+          f32_to_bf16(src[i]));
+  }
+  f32_to_f16(src.data(), dst.data(), num);
+  for (int64_t i = 0; i < num; i++) {
+    check("f32_to_f16", i, bits_of(src[i]), bits_of(dst[i]),
+          bits_of(f16_to_f32(f32_to_f16(src[i]))));
+  }
+  f32_to_bf16(src.data(), dst.data(), num);
+  for (int64_t i = 0; i < num; i++) {
+    check("f32_to_bf16", i, bits_of(src[i]), bits_of(dst[i]),
+          bits_of(bf16_to_f32(f32_to_bf16(src[i]))));
+  }
+  for (bool is_tpu : {true, false}) {
+    cvi_f32_to_bf16(src.data(), dst.data(), num, is_tpu);
+    for (int64_t i = 0; i < num; i++) {
+      check(is_tpu ? "cvi_f32_to_bf16" : "cvi_f32_to_bf16 cpu", i,
+            bits_of(src[i]), bits_of(dst[i]),
+            bits_of(cvi_f32_to_bf16(src[i], is_tpu)));
+    }
+  }
+  printf("%s: %" PRId64 " values checked\n", title, num);
+}
+
+static std::vector<float> special_values() {
+  std::vector<float> values = {
+      0.0f, -0.0f, 1.0f, -1.0f,
+      std::numeric_limits<float>::infinity(),
+      -std::numeric_limits<float>::infinity(),
+      std::numeric_limits<float>::quiet_NaN(),
+      -std::numeric_limits<float>::quiet_NaN(),
+      float_of(0x7f800001), // signaling nan
+      float_of(0xff800001),
+      std::numeric_limits<float>::max(),
+      std::numeric_limits<float>::lowest(),
+      std::numeric_limits<float>::min(),        // smallest normal
+      std::numeric_limits<float>::denorm_min(), // f32 denormal
+      float_of(0x007fffff), float_of(0x807fffff),
+      65504.0f, 65519.0f, 65520.0f, -65520.0f, // f16 max and overflow
+      6.1035156e-05f,                          // f16 smallest normal
+      5.9604645e-08f, 2.9802322e-08f,          // f16 denormal, tie to zero
+      8.9406967e-08f,                          // f16 denormal tie
+  };
+  // round half to even ties, with even and odd kept bit
+  for (uint32_t hi : {0x3f80u, 0x3f81u, 0xbf80u, 0xbf81u, 0x0080u, 0x7f7fu}) {
+    values.push_back(float_of((hi << 16) | 0x8000)); // bf16 tie
+    values.push_back(float_of((hi << 16) | 0x8001));
+    values.push_back(float_of((hi << 16) | 0x7fff));
+  }
+  for (uint32_t hi : {0x3f800000u, 0x3f802000u, 0xc0000000u, 0xc0002000u}) {
+    values.push_back(float_of(hi | 0x1000)); // f16 tie
+    values.push_back(float_of(hi | 0x1001));
+    values.push_back(float_of(hi | 0x0fff));
+  }
+  // f16 denormal range ties
+  for (uint32_t exp = 103; exp < 113; exp++) {
+    uint32_t tie = 1u << (125 - exp);
+    values.push_back(float_of((exp << 23) | tie));
+    values.push_back(float_of((exp << 23) | (3 * tie)));
+  }
+  // all f16/bf16 values, exactly representable
+  for (uint32_t i = 0; i < (1u << 16); i++) {
+    values.push_back(f16_to_f32((uint16_t)i));
+    values.push_back(bf16_to_f32((uint16_t)i));
+  }
+  // spread specials over vector lanes and the tail
+  std::vector<float> src;
+  for (int rep = 0; rep < 17; rep++) {
+    src.insert(src.end(), values.begin() + rep % 7, values.end());
+  }
+  return src;
+}
+
+static std::vector<float> random_values(int64_t num) {
+  std::mt19937 gen(20221019);
+  std::uniform_int_distribution<uint32_t> bits_dist;
+  std::normal_distribution<float> normal(0.0f, 8.0f);
+  std::vector<float> src(num);
+  for (int64_t i = 0; i < num; i++) {
+    // half random bits for nan/inf/denormal, half usual activations
+    src[i] = (i & 1) ? float_of(bits_dist(gen)) : normal(gen);
+  }
+  return src;
+}
+
+int main() {
+  test_all_16bit();
+  auto specials = special_values();
+  test_f32("special", specials);
+  // odd size, so that the tail goes the scalar way
+  auto randoms = random_values((1 << 22) + 13);
+  test_f32("random", randoms);
+  if (num_errors > 0) {
+    printf("FAILED: %d mismatches\n", num_errors);
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -15,6 +15,7 @@
 #include<stdint.h>
 #include<stdexcept>
 #include <regex>
+#include <unistd.h>
 
 #define ZIP64_LIMIT  ((((size_t)1) << 31) - 1)
 
@@ -575,49 +576,268 @@ template void npz_add_array<uint16_t>(npz_t &, std::string,
 template void npz_add_array<int32_t>(npz_t &, std::string,
         const std::vector<int32_t> &);
 
-void npz_save_all(std::string zipname, npz_t &map) {
+static char check_array_type(const std::string &name, const NpyArray &arr) {
+    bool valid = false;
+    if (arr.type == 'f') {
+        // support float only for now
+        valid = arr.word_size == sizeof(float);
+    } else if (arr.type == 'i' || arr.type == 'u') {
+        // support int8/int16/int32 and uint8/uint16/uint32
+        valid = arr.word_size == 1 || arr.word_size == 2 || arr.word_size == 4;
+    }
+    if (!valid) {
+        std::cout << "libcnpy error: invalid array type "
+                  << arr.type << arr.word_size << ", for " << name << "\n";
+        assert(0);
+    }
+    return arr.type;
+}
+
+static void pwrite_all(int fd, const void *data, size_t size, size_t offset) {
+    auto ptr = (const char *)data;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, ptr, size, offset);
+        if (n <= 0)
+            throw std::runtime_error("npz_save_all: failed pwrite");
+        ptr += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+static void pread_all(int fd, void *data, size_t size, size_t offset) {
+    auto ptr = (char *)data;
+    while (size > 0) {
+        ssize_t n = pread(fd, ptr, size, offset);
+        if (n <= 0)
+            throw std::runtime_error("npz_load: failed pread");
+        ptr += n;
+        size -= n;
+        offset += n;
+    }
+}
+
+// raw deflate of npy header + data, as zip method 8
+static std::vector<char> deflate_member(const std::vector<char> &npy_header,
+        const NpyArray &arr, int level) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    int err = deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                           Z_DEFAULT_STRATEGY);
+    if (err != Z_OK)
+        throw std::runtime_error("npz_save_all: deflateInit2 failed");
+    size_t total = npy_header.size() + arr.num_bytes();
+    std::vector<char> out(deflateBound(&stream, total));
+    stream.next_out = (Bytef *)out.data();
+    stream.avail_out = out.size();
+    const char *inputs[2] = {npy_header.data(), arr.data<char>()};
+    size_t sizes[2] = {npy_header.size(), arr.num_bytes()};
+    for (int i = 0; i < 2; i++) {
+        stream.next_in = (Bytef *)inputs[i];
+        stream.avail_in = sizes[i];
+        err = deflate(&stream, i == 1 ? Z_FINISH : Z_NO_FLUSH);
+        if (err == Z_STREAM_ERROR)
+            throw std::runtime_error("npz_save_all: deflate failed");
+    }
+    assert(err == Z_STREAM_END);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+typedef struct {
+    std::string fname;
+    const NpyArray *arr;
+    std::vector<char> npy_header;
+    std::vector<char> compressed; // empty if stored
+    uint32_t crc;
+    size_t compr_bytes;
+    size_t uncompr_bytes;
+    std::vector<char> local_header;
+    size_t offset;
+} zip_member_t;
+
+void npz_save_all(std::string zipname, npz_t &map, int compress_level) {
+    std::vector<zip_member_t> members;
+    members.reserve(map.size());
     for (auto it = map.begin(); it != map.end(); it++) {
-        std::string mode = (it == map.begin()) ? "w" : "a";
-        NpyArray &arr = it->second;
-        if (arr.type == 'f') {
-            // support float only for now
-            assert(arr.word_size = sizeof(float));
-            npz_save<float>(zipname, it->first, it->second, mode);
-        } else if (arr.type == 'i') {
-            // support int8/int16/int32 only
-            if (arr.word_size == sizeof(int8_t)) {
-                npz_save<int8_t>(zipname, it->first, it->second, mode);
-            } else if (arr.word_size == sizeof(int16_t)) {
-                npz_save<int16_t>(zipname, it->first, it->second, mode);
-            } else if (arr.word_size == sizeof(int32_t)) {
-                npz_save<int32_t>(zipname, it->first, it->second, mode);
-            } else {
-                assert(0);
+        check_array_type(it->first, it->second);
+        if (it->second.shape.size() == 0) {
+            std::cerr << "[Warning] zip name: " << it->first
+                      << " npz shape size is 0, skip it\n";
+            continue;
+        }
+        zip_member_t m;
+        m.fname = it->first + ".npy";
+        m.arr = &it->second;
+        members.push_back(std::move(m));
+    }
+
+    // crc and compression of each member
+    // exceptions must not leave the parallel region, keep them per member
+    int num = members.size();
+    std::vector<std::string> errors(num);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < num; i++) {
+        auto &m = members[i];
+        auto &arr = *m.arr;
+        m.npy_header = create_npy_header(arr.shape, arr.word_size, arr.type);
+        m.uncompr_bytes = m.npy_header.size() + arr.num_bytes();
+        m.crc = crc32(0L, (uint8_t *)m.npy_header.data(), m.npy_header.size());
+        // crc32 takes uInt length
+        for (size_t pos = 0; pos < arr.num_bytes(); pos += (1u << 30)) {
+            size_t len = std::min(arr.num_bytes() - pos, (size_t)(1u << 30));
+            m.crc = crc32(m.crc, (const uint8_t *)arr.data<char>() + pos, len);
+        }
+        if (compress_level > 0) {
+            try {
+                m.compressed = deflate_member(m.npy_header, arr, compress_level);
+            } catch (std::exception &e) {
+                errors[i] = e.what();
             }
-        } else if (arr.type == 'u') {
-            // support uint8/uint16/uint32
-            if (arr.word_size == sizeof(uint8_t)) {
-                npz_save<uint8_t>(zipname, it->first, it->second, mode);
-            } else if (arr.word_size == sizeof(uint16_t)) {
-                npz_save<uint16_t>(zipname, it->first, it->second, mode);
-            } else if (arr.word_size == sizeof(uint32_t)) {
-                npz_save<uint32_t>(zipname, it->first, it->second, mode);
+            m.compr_bytes = m.compressed.size();
+        } else {
+            m.compr_bytes = m.uncompr_bytes;
+        }
+    }
+    for (int i = 0; i < num; i++) {
+        if (!errors[i].empty())
+            throw std::runtime_error(errors[i]);
+    }
+
+    // local headers and offsets
+    size_t offset = 0;
+    for (auto &m : members) {
+        bool zip64 = m.uncompr_bytes >= ZIP64_LIMIT || m.compr_bytes >= ZIP64_LIMIT;
+        auto &lh = m.local_header;
+        lh += "PK"; //first part of sig
+        lh += (uint16_t) 0x0403; //second part of sig
+        lh += (uint16_t) (zip64 ? 45 : 20); //min version to extract
+        lh += (uint16_t) 0; //general purpose bit flag
+        lh += (uint16_t) (compress_level > 0 ? 8 : 0); //compression method
+        lh += (uint16_t) 0; //file last mod time
+        lh += (uint16_t) 0;     //file last mod date
+        lh += (uint32_t) m.crc; //crc
+        lh += (uint32_t) (zip64 ? 0xFFFFFFFF : m.compr_bytes); //compressed size
+        lh += (uint32_t) (zip64 ? 0xFFFFFFFF : m.uncompr_bytes); //uncompressed size
+        lh += (uint16_t) m.fname.size(); //fname length
+        lh += (uint16_t) (zip64 ? 20 : 0); //extra field length
+        lh += m.fname;
+        if (zip64) {
+            lh += (uint16_t) 0x01;
+            lh += (uint16_t) 16;
+            lh += (uint64_t) m.uncompr_bytes;
+            lh += (uint64_t) m.compr_bytes;
+        }
+        m.offset = offset;
+        offset += lh.size() + m.compr_bytes;
+    }
+    size_t global_header_offset = offset;
+
+    FILE* fp = fopen(zipname.c_str(),"wb");
+    if (!fp)
+        throw std::runtime_error("npz_save_all: Unable to open file "+zipname);
+    int fd = fileno(fp);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < num; i++) {
+        auto &m = members[i];
+        size_t pos = m.offset;
+        try {
+            pwrite_all(fd, m.local_header.data(), m.local_header.size(), pos);
+            pos += m.local_header.size();
+            if (!m.compressed.empty()) {
+                pwrite_all(fd, m.compressed.data(), m.compressed.size(), pos);
             } else {
-                assert(0);
+                pwrite_all(fd, m.npy_header.data(), m.npy_header.size(), pos);
+                pos += m.npy_header.size();
+                pwrite_all(fd, m.arr->data<char>(), m.arr->num_bytes(), pos);
             }
-        } else if (arr.type == 'b') {
-            // not support yet
-            assert(0);
-        } else if (arr.type == 'c') {
-            // not support yet
-            assert(0);
-        } else {
-            // invalid type
-            std::cout << "libcnpy error: invalid array type "
-                      << arr.type << ", for " << it->first << "\n";
-            assert(0);
+        } catch (std::exception &e) {
+            errors[i] = e.what();
+        }
+    }
+    for (int i = 0; i < num; i++) {
+        if (!errors[i].empty()) {
+            fclose(fp);
+            throw std::runtime_error(errors[i]);
+        }
+    }
+
+    //build global header
+    std::vector<char> global_header;
+    for (auto &m : members) {
+        std::vector<char> extra;
+        if (m.uncompr_bytes >= ZIP64_LIMIT)
+            extra += (uint64_t) m.uncompr_bytes;
+        if (m.compr_bytes >= ZIP64_LIMIT)
+            extra += (uint64_t) m.compr_bytes;
+        if (m.offset >= ZIP64_LIMIT)
+            extra += (uint64_t) m.offset;
+        bool zip64 = !extra.empty();
+        global_header += "PK"; //first part of sig
+        global_header += (uint16_t) 0x0201; //second part of sig
+        global_header += (uint16_t) (zip64 ? 45 : 20); //version made by
+        global_header += (uint16_t) (zip64 ? 45 : 20); //min version to extract
+        global_header.insert(global_header.end(), m.local_header.begin() + 6,
+                             m.local_header.begin() + 18);
+        global_header += (uint32_t) (m.compr_bytes >= ZIP64_LIMIT ? 0xFFFFFFFF : m.compr_bytes);
+        global_header += (uint32_t) (m.uncompr_bytes >= ZIP64_LIMIT ? 0xFFFFFFFF : m.uncompr_bytes);
+        global_header += (uint16_t) m.fname.size(); //fname length
+        global_header += (uint16_t) (zip64 ? extra.size() + 4 : 0); //extra data length
+        global_header += (uint16_t) 0; //file comment length
+        global_header += (uint16_t) 0; //disk number where file starts
+        global_header += (uint16_t) 0; //internal file attributes
+        global_header += (uint32_t) 0; //external file attributes
+        //relative offset of local file header
+        global_header += (uint32_t) (m.offset >= ZIP64_LIMIT ? 0xFFFFFFFF : m.offset);
+        global_header += m.fname;
+        if (zip64) {
+            global_header += (uint16_t) 0x01;
+            global_header += (uint16_t) extra.size();
+            global_header.insert(global_header.end(), extra.begin(), extra.end());
         }
     }
+
+    std::vector<char> footer;
+    bool zip64_end = global_header_offset >= ZIP64_LIMIT || num >= 0xFFFF;
+    if (zip64_end) {
+      std::vector<char> zip64endrec_header;
+      zip64endrec_header += "PK";
+      zip64endrec_header += (uint16_t) 0x0606;
+      zip64endrec_header += (uint64_t) 0x44;
+      zip64endrec_header += (uint16_t) 0x45;
+      zip64endrec_header += (uint16_t) 0x45;
+      zip64endrec_header += (uint32_t) 0x0;
+      zip64endrec_header += (uint32_t) 0x0;
+      zip64endrec_header += (uint64_t) num; //centDirCount
+      zip64endrec_header += (uint64_t) num; //centDirCount
+      zip64endrec_header += (uint64_t) global_header.size(); //centDirSize
+      zip64endrec_header += (uint64_t) global_header_offset; //centDirOffset
+      footer.insert(footer.end(), zip64endrec_header.begin(), zip64endrec_header.end());
+
+      std::vector<char> zip64locrec_header;
+      zip64locrec_header += "PK";
+      zip64locrec_header += (uint16_t) 0x0706;
+      zip64locrec_header += (uint32_t) 0x0;
+      zip64locrec_header += (uint64_t) global_header_offset + global_header.size(); // zip64endrec_header offset
+      zip64locrec_header += (uint32_t) 0x1;
+      footer.insert(footer.end(), zip64locrec_header.begin(), zip64locrec_header.end());
+    }
+    //build footer
+    footer += "PK"; //first part of sig
+    footer += (uint16_t) 0x0605; //second part of sig
+    footer += (uint16_t) 0; //number of this disk
+    footer += (uint16_t) 0; //disk where footer starts
+    footer += (uint16_t) (zip64_end ? 0xFFFF : num); //number of records on this disk
+    footer += (uint16_t) (zip64_end ? 0xFFFF : num); //total number of records
+    footer += (uint32_t) global_header.size(); //nbytes of global headers
+    //offset of start of global headers
+    footer += zip64_end ? (uint32_t) 0xFFFFFFFF : (uint32_t) global_header_offset;
+    footer += (uint16_t) 0; //zip file comment length
+
+    pwrite_all(fd, global_header.data(), global_header.size(), global_header_offset);
+    pwrite_all(fd, footer.data(), footer.size(), global_header_offset + global_header.size());
+    fclose(fp);
 }
 
 static NpyArray load_the_npy_file(FILE* fp) {
@@ -651,7 +871,7 @@ static NpyArray load_the_npz_array(FILE* fp, uint32_t compr_bytes,
     d_stream.avail_in = 0;
     d_stream.next_in = Z_NULL;
     err = inflateInit2(&d_stream, -MAX_WBITS);
-    assert(err = 0);
+    assert(err == Z_OK);
 
     d_stream.avail_in = compr_bytes;
     d_stream.next_in = &buffer_compr[0];
@@ -659,9 +879,9 @@ static NpyArray load_the_npz_array(FILE* fp, uint32_t compr_bytes,
     d_stream.next_out = &buffer_uncompr[0];
 
     err = inflate(&d_stream, Z_FINISH);
-    assert(err = 0);
+    assert(err == Z_STREAM_END);
     err = inflateEnd(&d_stream);
-    assert(err = 0);
+    assert(err == Z_OK);
 
     std::vector<size_t> shape;
     size_t word_size;
@@ -677,16 +897,159 @@ static NpyArray load_the_npz_array(FILE* fp, uint32_t compr_bytes,
     return array;
 }
 
-npz_t npz_load(std::string fname) {
-    npz_t arrays;
-    arrays.clear();
+typedef struct {
+    std::string varname;
+    uint16_t compr_method;
+    size_t compr_bytes;
+    size_t uncompr_bytes;
+    size_t offset; // local header offset
+} zip_entry_t;
+
+// read entries from zip central directory, return false if not a valid zip
+static bool parse_central_dir(FILE* fp, std::vector<zip_entry_t> &entries) {
+    if (fseek(fp, 0, SEEK_END) != 0)
+        return false;
+    size_t file_size = ftell(fp);
+    if (file_size < 22)
+        return false;
+    int fd = fileno(fp);
+    std::vector<char> footer(22);
+    pread_all(fd, footer.data(), 22, file_size - 22);
+    if (footer[0] != 'P' || footer[1] != 'K' || footer[2] != 0x05 || footer[3] != 0x06)
+        return false; // zip comment not supported
+    uint64_t nrecs = *(uint16_t*) &footer[10];
+    uint64_t global_header_size = *(uint32_t*) &footer[12];
+    uint64_t global_header_offset = *(uint32_t*) &footer[16];
+    if (nrecs == 0xFFFF || global_header_offset == 0xFFFFFFFF) {
+        if (file_size < 22 + 20 + 56)
+            return false;
+        std::vector<char> locator(20);
+        pread_all(fd, locator.data(), 20, file_size - 22 - 20);
+        if (locator[2] != 0x06 || locator[3] != 0x07)
+            return false;
+        uint64_t endrec_offset = *(uint64_t*) &locator[8];
+        std::vector<char> endrec(56);
+        pread_all(fd, endrec.data(), 56, endrec_offset);
+        if (endrec[2] != 0x06 || endrec[3] != 0x06)
+            return false;
+        nrecs = *(uint64_t*) &endrec[32];
+        global_header_size = *(uint64_t*) &endrec[40];
+        global_header_offset = *(uint64_t*) &endrec[48];
+    }
+    if (global_header_offset + global_header_size > file_size)
+        return false;
+    std::vector<char> global_header(global_header_size);
+    pread_all(fd, global_header.data(), global_header_size, global_header_offset);
+    size_t pos = 0;
+    for (uint64_t i = 0; i < nrecs; i++) {
+        if (pos + 46 > global_header_size)
+            return false;
+        const char *rec = &global_header[pos];
+        if (rec[0] != 'P' || rec[1] != 'K' || rec[2] != 0x01 || rec[3] != 0x02)
+            return false;
+        zip_entry_t e;
+        e.compr_method = *(uint16_t*) &rec[10];
+        e.compr_bytes = *(uint32_t*) &rec[20];
+        e.uncompr_bytes = *(uint32_t*) &rec[24];
+        uint16_t name_len = *(uint16_t*) &rec[28];
+        uint16_t extra_len = *(uint16_t*) &rec[30];
+        uint16_t comment_len = *(uint16_t*) &rec[32];
+        e.offset = *(uint32_t*) &rec[42];
+        if (pos + 46 + name_len + extra_len > global_header_size)
+            return false;
+        e.varname.assign(rec + 46, name_len);
+        //zip64 extra holds the fields set to 0xFFFFFFFF, in this order
+        const char *extra = rec + 46 + name_len;
+        for (size_t x = 0; x + 4 <= extra_len;) {
+            uint16_t id = *(uint16_t*) &extra[x];
+            uint16_t len = *(uint16_t*) &extra[x + 2];
+            if (id == 0x01) {
+                const char *field = extra + x + 4;
+                if (e.uncompr_bytes == 0xFFFFFFFF) {
+                    e.uncompr_bytes = *(uint64_t*) field;
+                    field += 8;
+                }
+                if (e.compr_bytes == 0xFFFFFFFF) {
+                    e.compr_bytes = *(uint64_t*) field;
+                    field += 8;
+                }
+                if (e.offset == 0xFFFFFFFF) {
+                    e.offset = *(uint64_t*) field;
+                }
+            }
+            x += 4 + len;
+        }
+        if (e.varname.size() < 4)
+            return false;
+        //erase the lagging .npy
+        e.varname.erase(e.varname.end()-4,e.varname.end());
+        entries.push_back(e);
+        pos += 46 + name_len + extra_len + comment_len;
+    }
+    return true;
+}
 
-    FILE* fp = fopen(fname.c_str(),"rb");
-    if(!fp) {
-        //throw std::runtime_error("npz_load: Error! Unable to open file "+fname+"!");
-        return arrays;
+static NpyArray load_zip_entry(int fd, const zip_entry_t &e) {
+    char local_header[30];
+    pread_all(fd, local_header, 30, e.offset);
+    if (local_header[2] != 0x03 || local_header[3] != 0x04)
+        throw std::runtime_error("npz_load: bad local header of "+e.varname);
+    uint16_t name_len = *(uint16_t*) &local_header[26];
+    uint16_t extra_len = *(uint16_t*) &local_header[28];
+    size_t data_offset = e.offset + 30 + name_len + extra_len;
+
+    if (e.compr_method != 0) {
+        std::vector<unsigned char> buffer_compr(e.compr_bytes);
+        pread_all(fd, buffer_compr.data(), e.compr_bytes, data_offset);
+        std::vector<unsigned char> buffer_uncompr(e.uncompr_bytes);
+        z_stream d_stream;
+        memset(&d_stream, 0, sizeof(d_stream));
+        int err = inflateInit2(&d_stream, -MAX_WBITS);
+        if (err != Z_OK)
+            throw std::runtime_error("npz_load: inflateInit2 failed");
+        d_stream.avail_in = e.compr_bytes;
+        d_stream.next_in = buffer_compr.data();
+        d_stream.avail_out = e.uncompr_bytes;
+        d_stream.next_out = buffer_uncompr.data();
+        err = inflate(&d_stream, Z_FINISH);
+        inflateEnd(&d_stream);
+        if (err != Z_STREAM_END)
+            throw std::runtime_error("npz_load: inflate failed for "+e.varname);
+
+        std::vector<size_t> shape;
+        size_t word_size;
+        char type;
+        bool fortran_order;
+        parse_npy_header(buffer_uncompr.data(),word_size,type,shape,fortran_order);
+        NpyArray array(shape, word_size, type, fortran_order);
+        size_t offset = e.uncompr_bytes - array.num_bytes();
+        memcpy(array.data<unsigned char>(),&buffer_uncompr[0]+offset,array.num_bytes());
+        return array;
     }
 
+    // stored: parse npy header, then read data in place
+    unsigned char preamble[10];
+    pread_all(fd, preamble, 10, data_offset);
+    uint16_t header_len = *reinterpret_cast<uint16_t*>(preamble+8);
+    std::vector<unsigned char> npy_header(10 + header_len);
+    pread_all(fd, npy_header.data(), npy_header.size(), data_offset);
+    std::vector<size_t> shape;
+    size_t word_size;
+    char type;
+    bool fortran_order;
+    parse_npy_header(npy_header.data(),word_size,type,shape,fortran_order);
+    NpyArray array(shape, word_size, type, fortran_order);
+    if (npy_header.size() + array.num_bytes() != e.uncompr_bytes)
+        throw std::runtime_error("npz_load: size mismatch of "+e.varname);
+    pread_all(fd, array.data<char>(), array.num_bytes(),
+              data_offset + npy_header.size());
+    return array;
+}
+
+// read local headers one by one, for zip without a valid central directory
+static npz_t npz_load_sequential(FILE* fp) {
+    npz_t arrays;
+    fseek(fp, 0, SEEK_SET);
     while(1) {
         std::vector<char> local_header(30);
         size_t headerres = fread(&local_header[0],sizeof(char),30,fp);
@@ -723,7 +1086,45 @@ npz_t npz_load(std::string fname) {
         else {arrays[varname] = load_the_npz_array(fp,compr_bytes,uncompr_bytes);}
     }
 
+    return arrays;
+}
+
+npz_t npz_load(std::string fname) {
+    npz_t arrays;
+    arrays.clear();
+
+    FILE* fp = fopen(fname.c_str(),"rb");
+    if(!fp) {
+        //throw std::runtime_error("npz_load: Error! Unable to open file "+fname+"!");
+        return arrays;
+    }
+
+    std::vector<zip_entry_t> entries;
+    if (!parse_central_dir(fp, entries)) {
+        arrays = npz_load_sequential(fp);
+        fclose(fp);
+        return arrays;
+    }
+
+    // members are independent, read and inflate them in parallel
+    int fd = fileno(fp);
+    int num = entries.size();
+    std::vector<NpyArray> loaded(num);
+    std::vector<std::string> errors(num);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < num; i++) {
+        try {
+            loaded[i] = load_zip_entry(fd, entries[i]);
+        } catch (std::exception &e) {
+            errors[i] = e.what();
+        }
+    }
     fclose(fp);
+    for (int i = 0; i < num; i++) {
+        if (!errors[i].empty())
+            throw std::runtime_error(errors[i]);
+        arrays[entries[i].varname] = std::move(loaded[i]);
+    }
     return arrays;
 }
 
@@ -110,7 +110,9 @@ template<typename T>
 void npz_add_array(npz_t &map, std::string fname,
         const std::vector<T> &data);
 
-void npz_save_all(std::string zipname, npz_t &map);
+// save all arrays, members are prepared and written in parallel
+// compress_level: 0 for store only (fastest), 1~9 for zlib deflate level
+void npz_save_all(std::string zipname, npz_t &map, int compress_level = 0);
 
 } // namespace cnpy
 
@@ -0,0 +1,207 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+//
+// BM1684X command layouts used by model_tool --profile. Only the fields the
+// cost model needs are kept; the tables are generated from
+// python/utils/bmodel_dis/opdef_1684x.py and regdef_1684x.py, keep them in
+// sync when the register definitions change.
+//
+//===----------------------------------------------------------------------===//
+#ifndef CMD_DEF_1684X_H_
+#define CMD_DEF_1684X_H_
+
+#include <stdint.h>
+
+namespace bm1684x {
+
+// bits [begin, end) of one field, {0, 0} if the command has no such field
+typedef struct {
+  uint16_t begin;
+  uint16_t end;
+} CmdField;
+
+enum BdcField {
+  B_RES0_N,
+  B_RES0_C,
+  B_RES0_H,
+  B_RES0_W,
+  B_OPD0_C,
+  B_OPD0_W,
+  B_OPD1_H,
+  B_OPD1_W,
+  B_RES0_PREC,
+  B_OPD0_PREC,
+  B_FIELD_NUM
+};
+
+enum GdmaField {
+  G_SRC_N,
+  G_SRC_C,
+  G_SRC_H,
+  G_SRC_W,
+  G_SRC_FORMAT,
+  G_MOVE_LEN,
+  G_DST_C,
+  G_DST_H,
+  G_DST_W,
+  G_FIELD_NUM
+};
+
+typedef struct {
+  const char *name;
+  int8_t short_cmd; // -1: both long and short
+  uint8_t opcode;
+  uint32_t eu_mask; // bit i set if eu_type i is valid, BDC only
+  uint16_t len;     // command length in bits
+  CmdField field[B_FIELD_NUM];
+} CmdDef;
+
+// BDC: short flag at bit 0, opcode at [41, 45), eu_type at [45, 50)
+// GDMA: short flag at bit 3, opcode at [32, 36)
+const int BDC_SHORT_BIT = 0;
+const int BDC_OPCODE_BEGIN = 41;
+const int BDC_EU_BEGIN = 45;
+const int GDMA_SHORT_BIT = 3;
+const int GDMA_OPCODE_BEGIN = 32;
+
+// DType: i8, f16, f32, i16, i32, b16
+static const int prec_bytes[] = {1, 2, 4, 2, 4, 2, 8, 1};
+
+static const CmdDef bdc_defs[] = {
+    {"conv", 0, 0, 0x7u, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"sconv", 1, 0, 0x7u, 512,
+     {{160, 176}, {176, 192}, {192, 208}, {208, 224}, {224, 240},
+      {256, 272}, {272, 288}, {288, 304}, {65, 68}, {68, 71}}},
+    {"pord", 0, 1, 0xf7u, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"spord", 1, 1, 0xf7u, 512,
+     {{128, 144}, {144, 160}, {160, 176}, {176, 192}, {0, 0},
+      {208, 224}, {224, 240}, {240, 256}, {66, 69}, {69, 72}}},
+    {"mm2", 0, 2, 0x70u, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"mm", 0, 2, 0xeu, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"smm2", 1, 2, 0x70u, 256,
+     {{0, 0}, {64, 80}, {0, 0}, {80, 96}, {0, 0},
+      {0, 0}, {0, 0}, {112, 128}, {52, 55}, {128, 131}}},
+    {"smm", 1, 2, 0xeu, 384,
+     {{0, 0}, {112, 128}, {0, 0}, {128, 144}, {160, 176},
+      {176, 192}, {0, 0}, {208, 224}, {67, 70}, {70, 73}}},
+    {"ar", 0, 3, 0x7cfdffffu, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"sar", 1, 3, 0x7cfdffffu, 512,
+     {{96, 112}, {112, 128}, {128, 144}, {144, 160}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {64, 67}, {67, 70}}},
+    {"rqdq", 0, 4, 0x3fu, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"srqdq", 1, 4, 0x3fu, 256,
+     {{128, 144}, {144, 160}, {160, 176}, {176, 192}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {52, 55}, {64, 67}}},
+    {"stransbc", 1, 5, 0x3fu, 256,
+     {{64, 80}, {80, 96}, {96, 112}, {112, 128}, {128, 144},
+      {144, 160}, {0, 0}, {0, 0}, {50, 53}, {0, 0}}},
+    {"transbc", 0, 5, 0x3fu, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"sg", 0, 6, 0x1e7ffu, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"sgl", 0, 6, 0x60000u, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"ssg", 1, 6, 0x1e7ffu, 384,
+     {{64, 80}, {80, 96}, {96, 112}, {112, 128}, {0, 0},
+      {144, 160}, {0, 0}, {176, 192}, {192, 195}, {224, 227}}},
+    {"ssgl", 1, 6, 0x60000u, 384,
+     {{80, 96}, {96, 112}, {112, 128}, {128, 144}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {64, 67}, {0, 0}}},
+    {"lar", -1, 7, 0x7fffffffu, 128,
+     {{0, 0}, {23, 31}, {0, 0}, {31, 39}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {3, 6}, {6, 9}}},
+    {"sfu", 0, 9, 0x2b000u, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"ssfu", 1, 9, 0x2b000u, 256,
+     {{80, 96}, {96, 112}, {112, 128}, {128, 144}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {64, 67}, {67, 70}}},
+    {"lin", 0, 10, 0x300002u, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"slin", 1, 10, 0x300002u, 256,
+     {{64, 80}, {80, 96}, {96, 112}, {112, 128}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {52, 55}, {0, 0}}},
+    {"cmp", 0, 13, 0x7c00000u, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"scmp", 1, 13, 0x7c00000u, 384,
+     {{128, 144}, {144, 160}, {160, 176}, {176, 192}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {0, 0}, {64, 67}}},
+    {"svc", 1, 14, 0x91bfbdu, 384,
+     {{0, 0}, {176, 192}, {0, 0}, {192, 208}, {208, 224},
+      {224, 240}, {0, 0}, {240, 256}, {64, 67}, {67, 70}}},
+    {"vc", 0, 14, 0x91bfbdu, 1024,
+     {{256, 272}, {272, 288}, {288, 304}, {304, 320}, {336, 352},
+      {368, 384}, {416, 432}, {432, 448}, {72, 75}, {75, 78}}},
+    {"sysid", -1, 15, 0xc000003fu, 128,
+     {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0},
+      {0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+};
+
+static const CmdDef gdma_defs[] = {
+    {"dma_tensor", 0, 0, 0x0u, 768,
+     {{384, 400}, {400, 416}, {416, 432}, {432, 448}, {40, 43},
+      {0, 0}, {464, 480}, {480, 496}, {496, 512}}},
+    {"dma_matrix", 0, 1, 0x0u, 768,
+     {{384, 400}, {400, 416}, {416, 432}, {432, 448}, {40, 43},
+      {0, 0}, {464, 480}, {480, 496}, {496, 512}}},
+    {"sdma_matrix", 1, 1, 0x0u, 512,
+     {{224, 240}, {240, 256}, {192, 208}, {208, 224}, {40, 43},
+      {0, 0}, {240, 256}, {192, 208}, {208, 224}}},
+    {"dma_masked_select", 0, 2, 0x0u, 768,
+     {{384, 400}, {400, 416}, {416, 432}, {432, 448}, {40, 43},
+      {0, 0}, {464, 480}, {480, 496}, {496, 512}}},
+    {"sdma_masked_select", 1, 2, 0x0u, 512,
+     {{96, 112}, {112, 128}, {128, 144}, {144, 160}, {40, 43},
+      {0, 0}, {176, 192}, {192, 208}, {208, 224}}},
+    {"dma_general", 0, 3, 0x0u, 768,
+     {{384, 400}, {400, 416}, {416, 432}, {432, 448}, {40, 43},
+      {160, 192}, {464, 480}, {480, 496}, {496, 512}}},
+    {"sdma_general", 1, 3, 0x0u, 384,
+     {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {40, 43},
+      {128, 160}, {160, 176}, {0, 0}, {0, 0}}},
+    {"dma_cw_transpose", 0, 4, 0x0u, 768,
+     {{384, 400}, {400, 416}, {416, 432}, {432, 448}, {40, 43},
+      {0, 0}, {464, 480}, {480, 496}, {496, 512}}},
+    {"dma_nonzero", 0, 5, 0x0u, 768,
+     {{384, 400}, {400, 416}, {416, 432}, {432, 448}, {40, 43},
+      {0, 0}, {464, 480}, {480, 496}, {496, 512}}},
+    {"sdma_nonzero", 1, 5, 0x0u, 384,
+     {{128, 144}, {144, 160}, {160, 176}, {176, 192}, {40, 43},
+      {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+    {"sdma_sys", 1, 6, 0x0u, 128,
+     {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {40, 43},
+      {0, 0}, {0, 0}, {0, 0}, {0, 0}}},
+    {"dma_gather", 0, 7, 0x0u, 768,
+     {{0, 0}, {336, 352}, {352, 384}, {384, 400}, {40, 43},
+      {0, 0}, {400, 416}, {416, 448}, {448, 464}}},
+    {"dma_scatter", 0, 8, 0x0u, 768,
+     {{0, 0}, {336, 352}, {352, 384}, {384, 400}, {40, 43},
+      {0, 0}, {400, 416}, {416, 448}, {448, 464}}},
+};
+
+} // namespace bm1684x
+
+#endif // CMD_DEF_1684X_H_
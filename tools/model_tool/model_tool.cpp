@@ -15,7 +15,9 @@
 #include <fstream>
 #include <unistd.h>
 #include <iostream>
+#include <map>
 #include <set>
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <sys/stat.h>
@@ -23,6 +25,7 @@
 #include "flatbuffers/idl.h"
 #include "flatbuffers/util.h"
 #include "tpu_mlir/Builder/BM168x/bmodel_fbs.h"
+#include "cmd_def_1684x.h"
 
 using namespace bmodel;
 using namespace flatbuffers;
@@ -34,6 +37,9 @@ using namespace std;
     exit(-1);                                                               \
   } while (0)
 
+#define WARNING(fmt, ...) \
+  printf("[%s:%d] Warning : " fmt "\n", __func__, __LINE__, ##__VA_ARGS__)
+
 // show usage of tool
 static void usage(void)
 {
@@ -45,6 +51,7 @@ static void usage(void)
        << "    --combine file1 .. fileN -o new_file: combine bmodels to one bmodel by filepath" << endl
        << "    --combine_dir dir1 .. dirN -o new_dir: combine bmodels to one bmodel by directory path" << endl
        << "    --dump model_file start_offset byte_size out_file: dump binary data to file from bmodel" << endl
+       << "    --profile model_file : estimate performance of each cmd group by static analysis" << endl
        << endl;
 }
 
@@ -188,6 +195,324 @@ static void show(const string &filename)
   }
 }
 
+// ================== static performance estimation ==================
+// Commands of each CmdGroup are decoded and costed by a simple model of
+// BM1684X: BDC throughput by precision, GDMA by DDR bandwidth, and a fixed
+// issue latency per command. It's meant to compare models or layer groups,
+// not to replace profiling on device.
+static const double TPU_FREQ_MHZ = 1000.0;
+static const int NPU_NUM = 64;
+static const int EU_BYTES = 64;
+static const double DDR_BYTES_PER_CYCLE = 64.0;
+static const uint64_t BDC_CMD_LATENCY = 32;
+static const uint64_t GDMA_CMD_LATENCY = 128;
+
+typedef struct {
+  uint64_t cmd_num;
+  uint64_t cycles;
+} CMD_COST_T;
+
+typedef struct {
+  uint64_t bdc_num;
+  uint64_t gdma_num;
+  uint64_t bdc_cycles;
+  uint64_t gdma_cycles;
+  uint64_t ops;       // 2 * macs + other element ops
+  uint64_t ddr_bytes;
+  uint64_t unknown_num; // commands can't be decoded, not in the estimation
+  map<string, CMD_COST_T> op_cost;
+} PROFILE_T;
+
+static uint64_t get_bits(const uint8_t *cmd, int begin, int end)
+{
+  uint64_t value = 0;
+  for (int i = end - 1; i >= begin; i--) {
+    value = (value << 1) | ((cmd[i >> 3] >> (i & 7)) & 1);
+  }
+  return value;
+}
+
+static uint64_t get_field(const uint8_t *cmd, const bm1684x::CmdField &f,
+                          uint64_t default_value = 1)
+{
+  if (f.end == 0) {
+    return default_value;
+  }
+  return get_bits(cmd, f.begin, f.end);
+}
+
+static const bm1684x::CmdDef *match_cmd(const uint8_t *cmd, uint64_t bits_left,
+                                        const bm1684x::CmdDef *defs, int def_num,
+                                        int short_bit, int opcode_begin, int eu_begin)
+{
+  int is_short = get_bits(cmd, short_bit, short_bit + 1);
+  uint32_t opcode = get_bits(cmd, opcode_begin, opcode_begin + 4);
+  for (int i = 0; i < def_num; i++) {
+    auto &def = defs[i];
+    if (def.len > bits_left || def.opcode != opcode) {
+      continue;
+    }
+    if (def.short_cmd >= 0 && def.short_cmd != is_short) {
+      continue;
+    }
+    if (eu_begin >= 0) {
+      uint32_t eu = get_bits(cmd, eu_begin, eu_begin + 5);
+      if (((def.eu_mask >> eu) & 1) == 0) {
+        continue;
+      }
+    }
+    return &def;
+  }
+  return NULL;
+}
+
+// macs per cycle of one npu lane
+static uint64_t mac_per_cycle(int bytes)
+{
+  return bytes == 1 ? 256 : (bytes == 2 ? 128 : 16);
+}
+
+static void bdc_cost(const uint8_t *cmd, const bm1684x::CmdDef *def, PROFILE_T &prof)
+{
+  using namespace bm1684x;
+  auto f = def->field;
+  uint64_t n = get_field(cmd, f[B_RES0_N]);
+  uint64_t c = get_field(cmd, f[B_RES0_C]);
+  uint64_t h = get_field(cmd, f[B_RES0_H]);
+  uint64_t w = get_field(cmd, f[B_RES0_W]);
+  // precision of the input decides the throughput
+  uint64_t prec = f[B_OPD0_PREC].end ? get_field(cmd, f[B_OPD0_PREC])
+                                     : get_field(cmd, f[B_RES0_PREC], 0);
+  int bytes = prec_bytes[prec & 0x7];
+  uint64_t c_per_npu = (c + NPU_NUM - 1) / NPU_NUM;
+  uint64_t elements = n * c * h * w;
+  uint64_t lane_elements = n * c_per_npu * h * w;
+  uint64_t cycles = 0;
+  if (def->opcode == 0) {
+    // conv: each output element reduces over ic * kh * kw
+    uint64_t kernel = get_field(cmd, f[B_OPD0_C]) * get_field(cmd, f[B_OPD1_H]) *
+                      get_field(cmd, f[B_OPD1_W]);
+    prof.ops += 2 * elements * kernel;
+    cycles = lane_elements * kernel / mac_per_cycle(bytes);
+  } else if (def->opcode == 2) {
+    // matmul: res0 is (c, w), reduce over the width of opd0
+    uint64_t k = get_field(cmd, f[B_OPD0_W]);
+    prof.ops += 2 * elements * k;
+    cycles = lane_elements * k / mac_per_cycle(bytes);
+  } else if (def->opcode == 1) {
+    // pooling and depthwise: kh * kw per output element
+    uint64_t kernel = get_field(cmd, f[B_OPD1_H]) * get_field(cmd, f[B_OPD1_W]);
+    prof.ops += elements * kernel;
+    cycles = lane_elements * kernel * bytes / EU_BYTES;
+  } else {
+    prof.ops += elements;
+    cycles = lane_elements * bytes / EU_BYTES;
+  }
+  cycles += BDC_CMD_LATENCY;
+  prof.bdc_cycles += cycles;
+  auto &cost = prof.op_cost[def->name];
+  cost.cmd_num++;
+  cost.cycles += cycles;
+}
+
+static void gdma_cost(const uint8_t *cmd, const bm1684x::CmdDef *def, PROFILE_T &prof)
+{
+  using namespace bm1684x;
+  auto f = def->field;
+  uint64_t elements;
+  if (f[G_MOVE_LEN].end) {
+    elements = get_field(cmd, f[G_MOVE_LEN]);
+  } else if (f[G_SRC_N].end) {
+    elements = get_field(cmd, f[G_SRC_N]) * get_field(cmd, f[G_SRC_C]) *
+               get_field(cmd, f[G_SRC_H]) * get_field(cmd, f[G_SRC_W]);
+  } else if (f[G_DST_C].end) {
+    elements = get_field(cmd, f[G_DST_C]) * get_field(cmd, f[G_DST_H]) *
+               get_field(cmd, f[G_DST_W]);
+  } else {
+    elements = 0;
+  }
+  uint64_t bytes = elements * prec_bytes[get_field(cmd, f[G_SRC_FORMAT], 0) & 0x7];
+  uint64_t cycles = bytes / DDR_BYTES_PER_CYCLE + GDMA_CMD_LATENCY;
+  prof.ddr_bytes += bytes;
+  prof.gdma_cycles += cycles;
+  auto &cost = prof.op_cost[def->name];
+  cost.cmd_num++;
+  cost.cycles += cycles;
+}
+
+static void profile_cmd_group(const CmdGroup *group, ModelCtx &model_ctx, PROFILE_T &prof)
+{
+  using namespace bm1684x;
+  prof.bdc_num += group->bdc_num();
+  prof.gdma_num += group->gdma_num();
+  const int bdc_def_num = sizeof(bdc_defs) / sizeof(bdc_defs[0]);
+  const int gdma_def_num = sizeof(gdma_defs) / sizeof(gdma_defs[0]);
+  if (group->binary_bdc() != NULL) {
+    auto data = model_ctx.binary_data(group->binary_bdc());
+    uint64_t bits_left = group->binary_bdc()->size() * 8;
+    for (uint32_t i = 0; i < group->bdc_num(); i++) {
+      auto def = match_cmd(data, bits_left, bdc_defs, bdc_def_num, BDC_SHORT_BIT,
+                           BDC_OPCODE_BEGIN, BDC_EU_BEGIN);
+      if (def == NULL) {
+        // length of unknown command is unknown too, skip the rest of group
+        WARNING("unknown bdc command at %u, skip %u commands", i,
+                group->bdc_num() - i);
+        prof.unknown_num += group->bdc_num() - i;
+        break;
+      }
+      bdc_cost(data, def, prof);
+      data += def->len / 8;
+      bits_left -= def->len;
+    }
+  }
+  if (group->binary_gdma() != NULL) {
+    auto data = model_ctx.binary_data(group->binary_gdma());
+    uint64_t bits_left = group->binary_gdma()->size() * 8;
+    for (uint32_t i = 0; i < group->gdma_num(); i++) {
+      auto def = match_cmd(data, bits_left, gdma_defs, gdma_def_num, GDMA_SHORT_BIT,
+                           GDMA_OPCODE_BEGIN, -1);
+      if (def == NULL) {
+        // length of unknown command is unknown too, skip the rest of group
+        WARNING("unknown gdma command at %u, skip %u commands", i,
+                group->gdma_num() - i);
+        prof.unknown_num += group->gdma_num() - i;
+        break;
+      }
+      gdma_cost(data, def, prof);
+      data += def->len / 8;
+      bits_left -= def->len;
+    }
+  }
+}
+
+static double cycle_to_us(uint64_t cycles)
+{
+  return cycles / TPU_FREQ_MHZ;
+}
+
+static void show_profile(const string &title, const PROFILE_T &prof)
+{
+  // bdc and gdma run in parallel, time is between max and sum of them
+  uint64_t overlap = max(prof.bdc_cycles, prof.gdma_cycles);
+  uint64_t serial = prof.bdc_cycles + prof.gdma_cycles;
+  double intensity = prof.ddr_bytes ? (double)prof.ops / prof.ddr_bytes : 0;
+  printf("%-16s bdc:%6lu %10.2fus  gdma:%6lu %10.2fus  time:%10.2f~%.2fus  "
+         "ddr:%10.2fMB  ops/byte:%8.2f  %s bound\n",
+         title.c_str(), prof.bdc_num, cycle_to_us(prof.bdc_cycles), prof.gdma_num,
+         cycle_to_us(prof.gdma_cycles), cycle_to_us(overlap), cycle_to_us(serial),
+         prof.ddr_bytes / 1048576.0, intensity,
+         prof.bdc_cycles >= prof.gdma_cycles ? "compute" : "memory");
+  if (prof.unknown_num) {
+    printf("%-16s unknown cmds:%6lu not estimated\n", "", prof.unknown_num);
+  }
+}
+
+static void show_op_cost(const PROFILE_T &prof)
+{
+  vector<pair<string, CMD_COST_T>> costs(prof.op_cost.begin(), prof.op_cost.end());
+  sort(costs.begin(), costs.end(), [](const pair<string, CMD_COST_T> &a,
+                                      const pair<string, CMD_COST_T> &b) {
+    return a.second.cycles > b.second.cycles;
+  });
+  for (auto &cost : costs) {
+    printf("  %-18s cmds:%8lu %12.2fus\n", cost.first.c_str(), cost.second.cmd_num,
+           cycle_to_us(cost.second.cycles));
+  }
+}
+
+static void merge_profile(PROFILE_T &dst, const PROFILE_T &src)
+{
+  dst.bdc_num += src.bdc_num;
+  dst.gdma_num += src.gdma_num;
+  dst.bdc_cycles += src.bdc_cycles;
+  dst.gdma_cycles += src.gdma_cycles;
+  dst.ops += src.ops;
+  dst.ddr_bytes += src.ddr_bytes;
+  dst.unknown_num += src.unknown_num;
+  for (auto &iter : src.op_cost) {
+    dst.op_cost[iter.first].cmd_num += iter.second.cmd_num;
+    dst.op_cost[iter.first].cycles += iter.second.cycles;
+  }
+}
+
+static PROFILE_T profile_cmd_groups(const Vector<Offset<CmdGroup>> *groups,
+                                    ModelCtx &model_ctx, const string &prefix)
+{
+  PROFILE_T total = {};
+  for (uint32_t i = 0; groups != NULL && i < groups->size(); i++) {
+    PROFILE_T prof = {};
+    profile_cmd_group(groups->Get(i), model_ctx, prof);
+    show_profile(prefix + "group " + to_string(i), prof);
+    merge_profile(total, prof);
+  }
+  return total;
+}
+
+// estimate performance of each cmd group (layer group), subnet and stage
+static void profile(const string &filename)
+{
+  ModelCtx model_ctx(filename);
+  if (!model_ctx) {
+    FATAL("file[%s] is not correct", filename.c_str());
+  }
+  auto model = model_ctx.model();
+  string chip = model->chip()->str();
+  bool decode = (chip == "BM1684X");
+  if (!decode) {
+    cout << "chip " << chip << " commands can't be decoded, only count them" << endl;
+  }
+  printf("machine balance (ops/byte): int8 %.1f, f16/bf16 %.1f, f32 %.1f\n",
+         2.0 * NPU_NUM * mac_per_cycle(1) / DDR_BYTES_PER_CYCLE,
+         2.0 * NPU_NUM * mac_per_cycle(2) / DDR_BYTES_PER_CYCLE,
+         2.0 * NPU_NUM * mac_per_cycle(4) / DDR_BYTES_PER_CYCLE);
+  for (uint32_t idx = 0; idx < model->net()->size(); idx++) {
+    auto net = model->net()->Get(idx);
+    auto parameter = net->parameter();
+    if (parameter == NULL) {
+      continue;
+    }
+    for (uint32_t i = 0; i < parameter->size(); i++) {
+      auto param = parameter->Get(i);
+      cout << "==========================================" << endl;
+      cout << "net " << idx << ": [" << net->name()->c_str() << "]  stage " << i << endl;
+      if (param->is_dynamic()) {
+        cout << "dynamic net, skip" << endl;
+        continue;
+      }
+      if (!decode) {
+        uint64_t bdc_num = 0, gdma_num = 0;
+        auto groups = param->cmd_group();
+        for (uint32_t j = 0; groups != NULL && j < groups->size(); j++) {
+          bdc_num += groups->Get(j)->bdc_num();
+          gdma_num += groups->Get(j)->gdma_num();
+        }
+        cout << "bdc: " << bdc_num << ", gdma: " << gdma_num << endl;
+        continue;
+      }
+      PROFILE_T total = {};
+      auto subnets = param->sub_net();
+      if (subnets == NULL || subnets->size() == 0) {
+        total = profile_cmd_groups(param->cmd_group(), model_ctx, "");
+      } else {
+        for (uint32_t j = 0; j < subnets->size(); j++) {
+          auto subnet = subnets->Get(j);
+          if (subnet->subnet_mode() != 0) {
+            cout << "subnet " << j << ": cpu" << endl;
+            continue;
+          }
+          auto prof = profile_cmd_groups(subnet->cmd_group(), model_ctx,
+                                         "subnet " + to_string(j) + " ");
+          show_profile("subnet " + to_string(j), prof);
+          merge_profile(total, prof);
+        }
+      }
+      cout << "------------" << endl;
+      show_profile("total", total);
+      show_op_cost(total);
+    }
+  }
+}
+
 // update binary data when copy one net to new flatbuffers
 // it's a little complicated, using reflection of flatbuffers
 static void update_table(Table *table, const StructDef *struct_def, ModelGen &model_gen,
@@ -203,11 +528,9 @@ static void update_table(Table *table, const StructDef *struct_def, ModelGen &mo
         if (next_def->fixed) {
           if (next_def->name == "Binary") {
             auto binary = table->GetStruct<Binary *>(fd->value.offset);
-            uint8_t *data = new uint8_t[binary->size()];
-            model_ctx.read_binary(binary, data);
-            auto new_binary = model_gen.WriteBinary(binary->size(), data);
+            auto new_binary =
+                model_gen.ReserveBinary(binary->size(), model_ctx.binary_data(binary));
             binary->mutate_start(new_binary.start());
-            delete[] data;
           }
         } else {
           auto next_pointer = table->GetPointer<void *>(fd->value.offset);
@@ -229,9 +552,8 @@ static void update_table(Table *table, const StructDef *struct_def, ModelGen &mo
             for (uint32_t next_id = 0; next_id < vector_pointer->size(); next_id++) {
               auto next_pointer = vector_pointer->GetMutableObject(next_id);
               auto binary = reinterpret_cast<Binary *>(next_pointer);
-              uint8_t *data = new uint8_t[binary->size()];
-              model_ctx.read_binary(binary, data);
-              auto new_binary = model_gen.WriteBinary(binary->size(), data);
+              auto new_binary =
+                  model_gen.ReserveBinary(binary->size(), model_ctx.binary_data(binary));
               binary->mutate_start(new_binary.start());
             }
           }
@@ -251,11 +573,22 @@ static void update_table(Table *table, const StructDef *struct_def, ModelGen &mo
   }
 }
 
+// bmodel schema, parsed once
+static Parser &schema_parser()
+{
+  static Parser parser;
+  static bool parsed = parser.Parse(schema_text);
+  if (!parsed) {
+    FATAL("parse bmodel schema failed");
+  }
+  return parser;
+}
+
 // update whole model binary data
+// binary data is referenced from model_ctx, and copied when model_gen saves
 static void update_model(ModelGen &model_gen, ModelCtx &model_ctx)
 {
-  Parser parser;
-  parser.Parse(schema_text);
+  auto &parser = schema_parser();
   auto buffer = model_gen.GetBufferPointer();
   auto root = GetMutableRoot<Table>(buffer);
   auto root_def = parser.root_struct_def_;
@@ -266,8 +599,7 @@ static void update_model(ModelGen &model_gen, ModelCtx &model_ctx)
 static void update_net(ModelGen &model_gen, ModelCtx &model_ctx, uint32_t net_idx = 0,
                        uint32_t sub_idx = 0)
 {
-  Parser parser;
-  parser.Parse(schema_text);
+  auto &parser = schema_parser();
   auto buffer = model_gen.GetBufferPointer();
   auto root_table = GetMutableRoot<Table>(buffer);
   auto root_def = parser.root_struct_def_;
@@ -300,7 +632,7 @@ static void extract(const string &filename)
       continue;
     }
     for (uint32_t idx = 0; idx < net->parameter()->size(); idx++) {
-      ModelGen model_gen(model_ctx.header().binary_size);
+      ModelGen model_gen(0);
       auto &builder = model_gen.Builder();
       auto parameter = net->parameter()->Get(idx);
       auto netT = parameter->UnPack();
@@ -587,6 +919,8 @@ int main(int argc, char **argv)
     combine_bmodels(argc, argv, true);
   } else if (cmd == "--dump") {
     dump_binary(argc, argv);
+  } else if (cmd == "--profile") {
+    profile(argv[2]);
   } else {
     usage();
     exit(-1);
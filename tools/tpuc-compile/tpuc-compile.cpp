@@ -0,0 +1,181 @@
+//===- tpuc-compile.cpp - TPU MLIR Compiler Driver ------------------------===//
+//
+// Copyright (C) 2022 Sophgo Technologies Inc.  All rights reserved.
+//
+// TPU-MLIR is licensed under the 2-Clause BSD License except for the
+// third-party components.
+//
+//===----------------------------------------------------------------------===//
+//
+// Compile a top mlir file to bmodel/cvimodel in one process. All stages share
+// one MLIRContext, so the module and the weights (kept in TopDialect::wFile)
+// are handed over in memory; mlir/npz files are only written on request.
+//
+//===----------------------------------------------------------------------===//
+
+#include "tpu_mlir/InitAll.h"
+#include "tpu_mlir/Support/Helper/Module.h"
+
+#include "mlir/IR/AsmState.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Pass/PassRegistry.h"
+#include "mlir/Support/FileUtilities.h"
+#include "mlir/Support/Timing.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+using namespace mlir;
+using namespace tpu_mlir::helper;
+
+static llvm::cl::opt<std::string> inputFilename(llvm::cl::Positional,
+                                                llvm::cl::desc("<top mlir>"),
+                                                llvm::cl::Required);
+
+static llvm::cl::opt<std::string>
+    modelFile("model", llvm::cl::desc("output bmodel/cvimodel file"),
+              llvm::cl::Required);
+
+static llvm::cl::opt<std::string>
+    chip("chip", llvm::cl::desc("chip: cv183x/cv182x/bm1684/bm1684x"),
+         llvm::cl::Required);
+
+static llvm::cl::opt<std::string>
+    mode("mode", llvm::cl::desc("quantization mode: INT8/BF16/F16/F32"),
+         llvm::cl::init("F32"));
+
+static llvm::cl::opt<std::string>
+    caliTable("calibration-table",
+              llvm::cl::desc("calibration table for int8 quantization"),
+              llvm::cl::init(""));
+
+static llvm::cl::opt<bool>
+    asymmetric("asymmetric", llvm::cl::desc("asymmetric int8 quantization"),
+               llvm::cl::init(false));
+
+static llvm::cl::opt<bool>
+    quantInput("quant-input", llvm::cl::desc("strip input type cast"),
+               llvm::cl::init(false));
+
+static llvm::cl::opt<bool>
+    quantOutput("quant-output", llvm::cl::desc("strip output type cast"),
+                llvm::cl::init(false));
+
+static llvm::cl::opt<std::string>
+    dumpTop("dump-top", llvm::cl::desc("save optimized top mlir (and npz)"),
+            llvm::cl::init(""));
+
+static llvm::cl::opt<std::string>
+    dumpTpu("dump-tpu", llvm::cl::desc("save lowered tpu mlir (and npz)"),
+            llvm::cl::init(""));
+
+static llvm::cl::opt<std::string>
+    dumpFinal("dump-final", llvm::cl::desc("save final mlir (and npz)"),
+              llvm::cl::init(""));
+
+static std::string boolStr(bool v) { return v ? "true" : "false"; }
+
+static LogicalResult dumpModule(ModuleOp module, StringRef file) {
+  std::string errorMessage;
+  auto output = openOutputFile(file, &errorMessage);
+  if (!output) {
+    llvm::errs() << errorMessage << "\n";
+    return failure();
+  }
+  OpPrintingFlags flags;
+  flags.enableDebugInfo();
+  module->print(output->os(), flags);
+  output->keep();
+  return success();
+}
+
+// Run one stage of the pipeline. Weights are only flushed to npz (by
+// save-weight) when the stage result is dumped.
+static LogicalResult runStage(ModuleOp module, TimingScope &timing,
+                              StringRef name, std::string pipeline,
+                              StringRef dump) {
+  auto stageTiming = timing.nest(name);
+  PassManager pm(module.getContext(), OpPassManager::Nesting::Implicit);
+  applyPassManagerCLOptions(pm);
+  pm.enableTiming(stageTiming);
+  if (!dump.empty()) {
+    pipeline += ",save-weight";
+  }
+  if (failed(parsePassPipeline(pipeline, pm))) {
+    return failure();
+  }
+  if (failed(pm.run(module))) {
+    llvm::errs() << "stage [" << name << "] failed\n";
+    return failure();
+  }
+  if (!dump.empty()) {
+    return dumpModule(module, dump);
+  }
+  return success();
+}
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM y(argc, argv);
+  tpu_mlir::registerAllPasses();
+  registerAsmPrinterCLOptions();
+  registerMLIRContextCLOptions();
+  registerPassManagerCLOptions();
+  registerDefaultTimingManagerCLOptions();
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    "TPU MLIR single process compiler\n");
+
+  DefaultTimingManager tm;
+  applyDefaultTimingManagerCLOptions(tm);
+  TimingScope timing = tm.getRootScope();
+
+  DialectRegistry registry;
+  tpu_mlir::registerAllDialects(registry);
+  MLIRContext context(registry);
+  context.loadAllAvailableDialects();
+
+  auto parseTiming = timing.nest("parse");
+  OwningOpRef<ModuleOp> module =
+      parseSourceFile<ModuleOp>(inputFilename, &context);
+  parseTiming.stop();
+  if (!module) {
+    llvm::errs() << "failed to parse " << inputFilename << "\n";
+    return 1;
+  }
+
+  std::string top_pipeline = "canonicalize,mark-FLOPs";
+  if (failed(runStage(*module, timing, "top", top_pipeline, dumpTop))) {
+    return 1;
+  }
+
+  std::string lower_pipeline;
+  if (!caliTable.empty()) {
+    lower_pipeline += "import-calibration-table{file=" + caliTable +
+                      " asymmetric=" + boolStr(asymmetric) + "},";
+  }
+  lower_pipeline += "convert-top-to-tpu{mode=" + StringRef(mode).upper() +
+                    " asymmetric=" + boolStr(asymmetric) +
+                    " chip=" + StringRef(chip).lower() + "},canonicalize";
+  if (failed(runStage(*module, timing, "lowering", lower_pipeline, dumpTpu))) {
+    return 1;
+  }
+
+  std::string model_pipeline = "strip-io-quant{quant_input=" +
+                               boolStr(quantInput) +
+                               " quant_output=" + boolStr(quantOutput) +
+                               "},weight-reorder,subnet-divide,merge-weight,";
+  if (Module::isCV18xx(StringRef(chip).upper())) {
+    model_pipeline += "cv-address-assign,cv-codegen{model_file=" +
+                      modelFile + "}";
+  } else {
+    model_pipeline += "layer-group,address-assign,codegen{model_file=" +
+                      modelFile + "}";
+  }
+  if (failed(runStage(*module, timing, "codegen", model_pipeline,
+                      dumpFinal))) {
+    return 1;
+  }
+  return 0;
+}